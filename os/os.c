@@ -9,6 +9,8 @@
 /*============================================================================
   IMPORTED INCLUDE REFERENCES
   ============================================================================*/
+#include <errno.h>       /* ISO C99 Standard: 7.5 Errors: errno. */
+#include <time.h>        /* Time types: clock_gettime(). */
 #include <pthread.h>     /* POSIX thread. */
 
 /*============================================================================
@@ -193,6 +195,47 @@ void os_sem_wait(sem_t *sem)
 	OS_TRAP_IF(ret != 0);
 }
 
+/**
+ * os_sem_timedwait() - suspend the current thread for a limited time.
+ *
+ * @sem:  address of the semaphore.
+ * @ms:   max. waiting time in milliseconds.
+ *
+ * Return:	0, if the semaphore has been released, or -1 after the timeout.
+ **/
+int os_sem_timedwait(sem_t *sem, int ms)
+{
+	struct timespec t;
+	int ret;
+	
+	/* Entry condition. */
+	OS_TRAP_IF(sem == NULL || ms < 0);
+
+	/* Calculate the absolute end of the waiting time. */
+	ret = clock_gettime(CLOCK_REALTIME, &t);
+	OS_TRAP_IF(ret != 0);
+
+	t.tv_sec  += ms / 1000;
+	t.tv_nsec += (long) (ms % 1000) * 1000000;
+	if (t.tv_nsec >= 1000000000) {
+		t.tv_sec++;
+		t.tv_nsec -= 1000000000;
+	}
+
+	/* Restart the waiting after an interruption by a signal handler. */
+	do {
+		ret = sem_timedwait(sem, &t);
+	} while (ret != 0 && errno == EINTR);
+
+	/* Test the expiry of the waiting time. */
+	if (ret != 0) {
+		OS_TRAP_IF(errno != ETIMEDOUT);
+		return -1;
+	}
+
+	return 0;
+}
+
 /**
  * os_sem_release() - release the current thread.
  *
@@ -381,6 +424,7 @@ void os_trace_button(int n)
  * @mask:  bits, to indicate what sorts of events are of interest:
  *     OS_CREATE encoded as: (1<<1) and means: create the cable infrastructure.
  *     OS_TEST   encoded as: (1<<2) and means: calculate the coverage of the OS.
+ *     OS_DIAG   poison and quarantine the released os_malloc buffers.
  *
  * Return:	None.
  **/
@@ -397,11 +441,23 @@ void os_init(int mask)
 	os_conf.trace_stat = 1;
 	
 	/* Initialize the os_malloc list. */
-	os_mem_init();
+	os_mem_init(mask & OS_DIAG);
 	
 	/* Initialize the thread table. */
 	os_thread_init(&os_conf);
 
+	/* Initialize the state of the thread pools. */
+	os_pool_init();
+
+	/* Initialize the timer wheel. */
+	os_wheel_init();
+
+	/* Initialize the state of the fibers. */
+	os_fiber_init();
+
+	/* Initialize the state of the arenas. */
+	os_arena_init();
+
 	/* Install a signal handler to generate a core dump, if the test
          * programm has been terminated with Ctrl-C. */
         os_trap_init(&os_conf);
@@ -437,9 +493,13 @@ void os_exit(void)
 	is_init = atomic_load(&p->is_init);
 	OS_TRAP_IF(! is_init);
 
+	os_wheel_exit();
+	os_fiber_exit();
+	os_arena_exit();
 	os_inet_exit();
 	os_cab_exit();
 	os_thread_exit();
+	os_pool_exit();
 	os_mem_exit();
 	os_clock_exit_();
 	os_buf_exit();
@@ -25,6 +25,7 @@
   ============================================================================*/
 // #define USE_PTHREAD_SPIN  /* Replace mutex with spin interfaces. */
 // #define USE_OS_RT         /* Hard realtime priority. */
+// #define OS_RELEASE        /* Release build, see tools/build RELEASE=YES. */
 
 /* Name of the current funtion. */
 #define F  __FUNCTION__
@@ -33,6 +34,10 @@
  * interest: */
 #define OS_CREATE  (1<<0)  /* Create the cable infrastructure. */
 #define OS_TEST    (1<<1)  /* Calculate the coverage of the van OS. */
+#define OS_DIAG    (1<<2)  /* Poison and quarantine the os_free buffers. */
+
+/* Fill byte of a released os_malloc buffer in the diagnostic mode. */
+#define OS_MEM_POISON  0x6b
 
 /* Only allow MTU for the standard string operations: 
  * see https://en.wikipedia.org/wiki/Path_MTU_Discovery */
@@ -44,17 +49,24 @@
 /* Maximum length of a thread name string. */
 #define OS_THREAD_NAME_LEN  16
 
-/* Number of the supported threads. */
+/* Number of the CPUs of the os_thread CPU set like CPU_SETSIZE. */
+#define OS_THREAD_CPU_N  1024
+
+/* Number of the latency buckets of the os_thread telemetry. */
+#define OS_THREAD_HIST_LEN  32
+
+/* Number of the lifetime buckets of the os_malloc profile. */
+#define OS_MEM_HIST_LEN  40
+
+/* Number of the thread table entries per chunk; the table grows by chunks. */
 #define OS_THREAD_LIMIT  16
 
-/* Limit of the thread input queue. */
+/* Number of the pooled message buffers of a thread input queue; larger
+ * queues take the additional buffers from the heap. */
 #define OS_QUEUE_LIMIT  1024
 
-/* Limit of the os_malloc calls without correspondig ms_free calls. */
-#define OS_MALLOC_LIMIT     512
-
-/* Limit of the van files with os_malloc calls. */
-#define OS_MALLOC_FILE_LIMIT  5
+/* Number of the priority lanes of a thread input queue. */
+#define OS_QUEUE_LANES  3
 
 /* Size of the shared memory UL/DL transfer buffers. */
 #define OS_BUF_SIZE  2048
@@ -75,6 +87,12 @@
 /* Print the last timer trace. */
 #define OS_CT_LAST    3
 
+/* Modes of an os_mq I/O queue, see os_mq_init_ext(): */
+#define OS_MQ_FRAMED  (1<<0)  /* Length prefixed binary records. */
+#define OS_MQ_SPSC    (1<<1)  /* Lock-free single producer and consumer. */
+#define OS_MQ_MIRROR  (1<<2)  /* Ring buffer mapped twice back-to-back. */
+#define OS_MQ_EVENT   (1<<3)  /* Pollable event descriptor, see os_mq_fd(). */
+
 /* Port number of the van controller. */
 #define OS_CTRL_PORT  62058
 
@@ -91,20 +109,42 @@
 
 #define OS_TRAP_IF(cond_) \
     do { \
-        if (cond_) { \
+        if (__builtin_expect(!! (cond_), 0)) { \
             OS_TRAP(); \
         } \
     } while (0)
 
+#if defined(OS_RELEASE)
+/* Thin allocator calls of the release build without os_malloc tracking. */
+#define OS_MALLOC(size_)  os_malloc_thin(size_)
+#define OS_FREE(ptr_)     do { os_free_thin((void **) &(ptr_)); } while(0);
+#else
 /* Wrapper for os_mallo() and os_free. */
 #define OS_MALLOC(size_)  os_malloc((size_), __FILE__, __LINE__)
-#define OS_FREE(ptr_)     do { os_free((void **) &(ptr_)); } while(0);
+#define OS_FREE(ptr_)     do { \
+	os_free_ext((void **) &(ptr_), __FILE__, __LINE__); \
+} while(0);
+#endif
 
 /* Wrapper to send a message to any thread. */
 #define OS_SEND(thread_, msg_, size_) do { \
         os_queue_send((thread_), (os_queue_elem_t *) (msg_), (size_)); \
 } while(0)
 
+/* Wrapper to send a message to a priority lane of any thread. */
+#define OS_SEND_LANE(thread_, lane_, msg_, size_) do { \
+        os_queue_send_lane((thread_), (lane_), (os_queue_elem_t *) (msg_), \
+			   (size_)); \
+} while(0)
+
+/* Add a CPU to the CPU set of the os_thread attributes. */
+#define OS_CPU_SET(cpu_, set_) \
+	((set_)[(cpu_) / 64] |= 1ULL << ((cpu_) % 64))
+
+/* Test a CPU of the CPU set of the os_thread attributes. */
+#define OS_CPU_ISSET(cpu_, set_) \
+	((int) (((set_)[(cpu_) / 64] >> ((cpu_) % 64)) & 1))
+
 /*============================================================================
   TYPE DEFINITIONS
   ============================================================================*/
@@ -167,12 +207,101 @@ typedef enum {
 	OS_THREAD_PRIO_DEFAULT = 5
 } os_thread_prio_t;
 
+/**
+ * os_thread_policy_t - supported scheduling policies.
+ *
+ * @OS_THREAD_POLICY_INHERIT:  take over the policy of the creator.
+ * @OS_THREAD_POLICY_OTHER:    standard round-robin time-sharing policy.
+ * @OS_THREAD_POLICY_FIFO:     realtime first-in, first-out policy.
+ * @OS_THREAD_POLICY_RR:       realtime round-robin policy.
+ **/
+typedef enum {
+	OS_THREAD_POLICY_INHERIT,
+	OS_THREAD_POLICY_OTHER,
+	OS_THREAD_POLICY_FIFO,
+	OS_THREAD_POLICY_RR
+} os_thread_policy_t;
+
+/**
+ * os_queue_lane_t - priority lanes of the os_thread input queue: the thread
+ * processes the messages of a higher lane first.
+ *
+ * @OS_QUEUE_LANE_HIGH:  urgent control messages.
+ * @OS_QUEUE_LANE_NORM:  default lane of os_queue_send().
+ * @OS_QUEUE_LANE_BULK:  background traffic like telemetry.
+ **/
+typedef enum {
+	OS_QUEUE_LANE_HIGH,
+	OS_QUEUE_LANE_NORM,
+	OS_QUEUE_LANE_BULK
+} os_queue_lane_t;
+
+/* Start function of a fiber. */
+typedef void os_fiber_cb_t(void *arg);
+
+/**
+ * os_fiber_sem_t - semaphore, which suspends the waiting fiber instead of its
+ * os_thread.
+ *
+ * @protect:  protect the access to the semaphore.
+ * @count:    semaphore counter.
+ * @head:     first waiting fiber.
+ * @tail:     last waiting fiber.
+ **/
+typedef struct {
+	spinlock_t          protect;
+	int                 count;
+	struct os_fiber_s  *head;
+	struct os_fiber_s  *tail;
+} os_fiber_sem_t;
+
+/**
+ * os_thread_attr_t - scheduling attributes of an os_thread.
+ *
+ * @cpu_set:     bit mask of the allowed CPUs, see OS_CPU_SET; an empty set
+ *               allows all CPUs.
+ * @policy:      scheduling policy.
+ * @prio:        static priority of the policy.
+ * @stack_size:  size of the thread stack, 0 for the default size.
+ * @latency:     if 1, the input queue stamps the messages and records their
+ *               enqueue-to-dispatch latencies, 0 to save the clock reads.
+ **/
+typedef struct {
+	unsigned long long  cpu_set[OS_THREAD_CPU_N / 64];
+	os_thread_policy_t  policy;
+	int                 prio;
+	size_t              stack_size;
+	int                 latency;
+} os_thread_attr_t;
+
 /* Forward declaration of the generic message. */
 typedef struct os_queue_elem_s os_queue_elem_t;
 
 /* Callback for the received message. */
 typedef void os_queue_cb_t(os_queue_elem_t *msg);
 
+/**
+ * os_thread_stats_t - telemetry of the os_thread input queue.
+ *
+ * @processed:  number of the processed messages.
+ * @depth:      current number of the queued messages.
+ * @max_depth:  high-water mark of the queued messages.
+ * @lat_sum:    sum of the enqueue-to-dispatch latencies in nanoseconds.
+ * @lat_max:    max. enqueue-to-dispatch latency in nanoseconds.
+ * @hist:       latency histogram: bucket i counts the latencies from 2^(i-1)
+ *              to 2^i - 1 nanoseconds, the last bucket all larger ones.
+ *
+ * The latencies remain 0, if the latency attribute of the thread is not set.
+ **/
+typedef struct {
+	unsigned long long  processed;
+	int                 depth;
+	int                 max_depth;
+	unsigned long long  lat_sum;
+	unsigned long long  lat_max;
+	unsigned long long  hist[OS_THREAD_HIST_LEN];
+} os_thread_stats_t;
+
 /**
  * OS_QUEUE_MSG_HEAD - generic message header.
  *
@@ -181,7 +310,7 @@ typedef void os_queue_cb_t(os_queue_elem_t *msg);
  * @cb:     callback for the message processing.
  **/
 #define OS_QUEUE_MSG_HEAD \
-    struct os_queue_elem_s  *next; \
+    struct os_queue_elem_s  *_Atomic next; \
     void           *param; \
     os_queue_cb_t  *cb;
 
@@ -208,6 +337,73 @@ typedef struct {
 	int thread_c;
 } os_statistics_t;
 
+/**
+ * os_mem_usage_t - capacity and memory overhead of the os_malloc tracker.
+ *
+ * @live:         number of the outstanding os_malloc calls.
+ * @slots:        number of the tracking elements of all threads.
+ * @table_bytes:  memory of the tracking elements and their shards.
+ * @per_alloc:    overhead of an allocation: header and tracking element.
+ **/
+typedef struct {
+	size_t  live;
+	size_t  slots;
+	size_t  table_bytes;
+	size_t  per_alloc;
+} os_mem_usage_t;
+
+/**
+ * os_mem_site_stats_t - allocation profile of an os_malloc call site.
+ *
+ * @live:     outstanding bytes.
+ * @peak:     high-water mark of the outstanding bytes.
+ * @alloc_c:  number of the os_malloc calls.
+ * @free_c:   number of the os_free calls.
+ * @hist:     lifetime histogram: bucket i counts the lifetimes from 2^(i-1)
+ *            to 2^i - 1 nanoseconds, the last bucket all larger ones.
+ **/
+typedef struct {
+	long long           live;
+	long long           peak;
+	unsigned long long  alloc_c;
+	unsigned long long  free_c;
+	unsigned long long  hist[OS_MEM_HIST_LEN];
+} os_mem_site_stats_t;
+
+/* Number of the size classes of an arena: 16, 32, ... 2048 bytes. */
+#define OS_ARENA_CLASS_N    8
+#define OS_ARENA_CLASS_MAX  (16 << (OS_ARENA_CLASS_N - 1))
+
+/**
+ * os_arena_stats_t - leak and usage information of an arena.
+ *
+ * @live:         number of the outstanding buffers.
+ * @peak:         max. number of the outstanding buffers.
+ * @alloc_c:      number of the os_arena_alloc() calls.
+ * @reset_c:      number of the os_arena_reset() calls.
+ * @chunk_c:      number of the allocated chunks.
+ * @chunk_bytes:  memory of the allocated chunks.
+ **/
+typedef struct {
+	size_t  live;
+	size_t  peak;
+	size_t  alloc_c;
+	size_t  reset_c;
+	size_t  chunk_c;
+	size_t  chunk_bytes;
+} os_arena_stats_t;
+
+/**
+ * os_mq_iov_t - message of a batched os_mq operation.
+ *
+ * @buf:   start of the message.
+ * @size:  size of the message.
+ **/
+typedef struct {
+	char  *buf;
+	int    size;
+} os_mq_iov_t;
+
 /*============================================================================
   GLOBAL DATA
   ============================================================================*/
@@ -230,7 +426,21 @@ void os_trap(char *file, const char *function, unsigned long line);
 /* Dynamic memory. */
 void *os_malloc(size_t size, char *file, unsigned long line);
 void os_free(void **ptr);
-
+void os_free_ext(void **ptr, char *file, unsigned long line);
+int os_mem_leak_dump(void);
+void os_mem_usage(os_mem_usage_t *usage);
+int os_mem_profile(char *file, unsigned long line, os_mem_site_stats_t *stats);
+void os_mem_profile_dump(void);
+
+/* Size class arenas of a thread. */
+void *os_arena_create(char *name, size_t chunk_size);
+void *os_arena_alloc(void *g_arena, size_t size);
+void os_arena_free(void *g_arena, void *ptr, size_t size);
+void os_arena_reset(void *g_arena);
+void os_arena_stats(void *g_arena, os_arena_stats_t *stats);
+void os_arena_destroy(void *g_arena);
+
+#if ! defined(OS_RELEASE)
 /* Memory and string. */
 void *os_memset(void *s, int c, size_t n);
 void *os_memcpy(void *dest, size_t dest_n, const void *src, size_t src_n);
@@ -245,6 +455,7 @@ char *os_strncat(char *dest, const char *src, size_t n);
 char *os_strstr(const char *haystack, int haystack_len, const char *needle);
 char *os_strchr(const char *s, int s_len, int c);
 long int os_strtol_b10(const char *nptr, int n_len);
+#endif
 
 /* Critical section. */
 void os_cs_init(pthread_mutex_t *mutex);
@@ -255,6 +466,7 @@ void os_cs_destroy(pthread_mutex_t *mutex);
 /* Semaphores. */
 void os_sem_init(sem_t *sem, unsigned int init_value);
 void os_sem_wait(sem_t *sem);
+int os_sem_timedwait(sem_t *sem, int ms);
 void os_sem_release(sem_t *sem);
 void os_sem_delete(sem_t *sem);
 
@@ -266,11 +478,53 @@ void os_spin_destroy(spinlock_t *spinlock);
 
 /* Threads. */
 void *os_thread_create(const char *name, os_thread_prio_t prio, int queue_size);
+void *os_thread_create_ext(const char *name, os_thread_attr_t *attr, int q_size);
+void os_thread_attr_get(void *g_thread, os_thread_attr_t *attr);
+void os_thread_stats(void *g_thread, os_thread_stats_t *stats);
+void os_thread_lane_stats(void *g_thread, os_queue_lane_t lane,
+			  os_thread_stats_t *stats);
+void os_thread_stats_dump(void);
 char *os_thread_name(void *thread);
 void os_thread_destroy(void *thread);
 
+/* Cooperative fibers of an os_thread. */
+void os_fiber_create(void *g_thread, os_fiber_cb_t *cb, void *arg,
+		     size_t stack_size);
+void os_fiber_yield(void);
+void os_fiber_sem_init(os_fiber_sem_t *sem, int init_value);
+void os_fiber_sem_wait(os_fiber_sem_t *sem);
+void os_fiber_sem_post(os_fiber_sem_t *sem);
+void os_fiber_sem_delete(os_fiber_sem_t *sem);
+
+/* Work-stealing thread pool. */
+void *os_pool_create(const char *name, int count);
+void os_pool_submit(void *g_pool, os_queue_elem_t *msg, int size);
+void os_pool_destroy(void *g_pool);
+
 /* Message queue. */
 void os_queue_send(void *g_thread, os_queue_elem_t *msg, int size);
+int os_queue_try_send(void *g_thread, os_queue_elem_t *msg, int size);
+int os_queue_send_timed(void *g_thread, os_queue_elem_t *msg, int size, int ms);
+void os_queue_send_lane(void *g_thread, os_queue_lane_t lane,
+			os_queue_elem_t *msg, int size);
+int os_queue_try_send_lane(void *g_thread, os_queue_lane_t lane,
+			   os_queue_elem_t *msg, int size);
+void os_queue_lane_limit(void *g_thread, os_queue_lane_t lane, int limit);
+os_queue_elem_t *os_queue_alloc(void *g_thread, int size);
+void os_queue_post(void *g_thread, os_queue_elem_t *elem);
+void os_queue_free(void *g_thread, os_queue_elem_t *elem);
+
+/* Synchronous calls. */
+int os_call(void *g_thread, os_queue_elem_t *msg, int size, void *reply,
+	    int reply_size);
+void os_reply(os_queue_elem_t *msg, void *buf, int size);
+
+/* Delayed and periodic messages. */
+int os_queue_send_after(void *g_thread, os_queue_elem_t *msg, int size,
+			int delay);
+int os_queue_send_every(void *g_thread, os_queue_elem_t *msg, int size,
+			int period);
+int os_queue_cancel(int id);
 
 /* Endpoint of a shared memory cable. */
 int os_c_open(const char *device_name, int mode);
@@ -324,8 +578,15 @@ void os_mq_remove(void *mq, int size);
 char *os_mq_get(void *mq, int *size);
 int os_mq_write(void *mq, char *buf, int count);
 int os_mq_read(void *mq, char *buf, int count);
+int os_mq_write_batch(void *mq, os_mq_iov_t *iov, int n);
+int os_mq_read_batch(void *mq, os_mq_iov_t *iov, int n);
+void os_mq_remove_batch(void *mq, os_mq_iov_t *iov, int n);
+int os_mq_wait_readable(void *mq, int ms);
+int os_mq_wait_writable(void *mq, int size, int ms);
+int os_mq_fd(void *mq);
 void os_mq_delete(void *mq);
 void *os_mq_init(int size);
+void *os_mq_init_ext(int size, int flags);
 
 /* Internet interfaces. */
 int os_inet_open(const char *my_addr, int my_p, const char *his_addr, int his_p);
@@ -340,4 +601,9 @@ int os_inet_sync(int cid);
 /* C sharp test. */
 void os_mcs_hello(void);
 
+#if defined(OS_RELEASE)
+/* Inline memory and string wrappers without argument checks. */
+#include "os_release.h"
+#endif
+
 #endif /* __os_h__ */
@@ -0,0 +1,371 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Size class arenas for short-lived buffers of an os_thread.
+ *
+ * Copyright (C) 2022 Gerald Schueller <gerald.schueller@web.de>
+ */
+
+/*============================================================================
+  IMPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include "os.h"          /* Operating system: os_sem_create() */
+
+/*============================================================================
+  EXPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include "os_private.h"  /* Local interfaces of the OS: os_arena_init() */
+
+/*============================================================================
+  LOCAL NAME CONSTANTS DEFINITIONS
+  ============================================================================*/
+/* Size and alignment of the smallest size class. */
+#define OS_ARENA_ALIGN  16
+
+/* Default size of an arena chunk. */
+#define OS_ARENA_CHUNK_SIZE  (64 * 1024)
+
+/*============================================================================
+  MACROS
+  ============================================================================*/
+/*============================================================================
+  LOCAL TYPE DEFINITIONS
+  ============================================================================*/
+/**
+ * os_arena_chunk_t - memory block of the bump allocator.
+ *
+ * @next:  successor in the chunk list.
+ * @size:  usable size of the chunk.
+ * @data:  start of the usable memory.
+ **/
+typedef struct os_arena_chunk_s {
+	struct os_arena_chunk_s  *next;
+	size_t                    size;
+	char                      data[] __attribute__((aligned(OS_ARENA_ALIGN)));
+} os_arena_chunk_t;
+
+/**
+ * os_arena_free_t - released buffer in the list of its size class.
+ *
+ * @next:  successor in the free list.
+ **/
+typedef struct os_arena_free_s {
+	struct os_arena_free_s  *next;
+} os_arena_free_t;
+
+/**
+ * os_arena_t - arena of a single thread.
+ *
+ * @name:        name of the arena.
+ * @chunk_size:  usable size of a chunk.
+ * @head:        first chunk, the list is kept after the reset.
+ * @cur:         chunk of the bump allocator.
+ * @pos:         next free byte of the current chunk.
+ * @end:         end of the current chunk.
+ * @free:        lists of the released buffers per size class.
+ * @stats:       leak and usage information of the arena.
+ **/
+typedef struct {
+	char              *name;
+	size_t             chunk_size;
+	os_arena_chunk_t  *head;
+	os_arena_chunk_t  *cur;
+	char              *pos;
+	char              *end;
+	os_arena_free_t   *free[OS_ARENA_CLASS_N];
+	os_arena_stats_t   stats;
+} os_arena_t;
+
+/*============================================================================
+  LOCAL DATA
+  ============================================================================*/
+/**
+ * os_arena_list - state of all arenas.
+ *
+ * @count:  number of the installed arenas.
+ **/
+static struct os_arena_list_s {
+	atomic_int  count;
+} os_arena_list;
+
+/*============================================================================
+  LOCAL FUNCTION PROTOTYPES
+  ============================================================================*/
+/*============================================================================
+  LOCAL FUNCTIONS
+  ============================================================================*/
+/**
+ * os_arena_class() - calculate the size class of a buffer.
+ *
+ * @size:  requested size of the buffer.
+ *
+ * Return:	the index of the size class.
+ **/
+static int os_arena_class(size_t size)
+{
+	unsigned int n;
+
+	/* Round up to the smallest class. */
+	if (size <= OS_ARENA_ALIGN)
+		return 0;
+
+	/* Class k contains the buffers up to OS_ARENA_ALIGN << k bytes. */
+	n = (size - 1) / OS_ARENA_ALIGN;
+
+	return 32 - __builtin_clz(n);
+}
+
+/**
+ * os_arena_bump() - cut a buffer from the current or the next chunk.
+ *
+ * @arena:  pointer to the arena.
+ * @size:   size of the size class.
+ *
+ * Return:	the start address of the buffer.
+ **/
+static void *os_arena_bump(os_arena_t *arena, size_t size)
+{
+	os_arena_chunk_t *chunk;
+	void *ptr;
+
+	/* Test the rest of the current chunk. */
+	if (arena->pos == NULL || arena->pos + size > arena->end) {
+		/* Reuse the next chunk after a reset. */
+		chunk = arena->cur != NULL ? arena->cur->next : arena->head;
+		if (chunk == NULL) {
+			/* Allocate and append a new chunk. */
+			chunk = OS_MALLOC(sizeof(os_arena_chunk_t) +
+					  arena->chunk_size);
+			chunk->next = NULL;
+			chunk->size = arena->chunk_size;
+			if (arena->cur != NULL)
+				arena->cur->next = chunk;
+			else
+				arena->head = chunk;
+
+			arena->stats.chunk_c++;
+			arena->stats.chunk_bytes += arena->chunk_size;
+		}
+
+		/* Switch to the chunk. */
+		arena->cur = chunk;
+		arena->pos = chunk->data;
+		arena->end = chunk->data + chunk->size;
+	}
+
+	/* Bump the position. */
+	ptr = arena->pos;
+	arena->pos += size;
+
+	return ptr;
+}
+
+/*============================================================================
+  EXPORTED FUNCTIONS
+  ============================================================================*/
+/**
+ * os_arena_create() - create an arena for the buffers of the calling thread.
+ * The arena is not thread-safe: only one thread may use it.
+ *
+ * @name:        name of the arena.
+ * @chunk_size:  size of the memory blocks, 0 for the default size.
+ *
+ * Return:	the generic address of the arena.
+ **/
+void *os_arena_create(char *name, size_t chunk_size)
+{
+	os_arena_t *arena;
+
+	/* Entry condition. */
+	OS_TRAP_IF(name == NULL ||
+		   (chunk_size > 0 && chunk_size < OS_ARENA_CLASS_MAX));
+
+	/* Define the chunk size. */
+	if (chunk_size == 0)
+		chunk_size = OS_ARENA_CHUNK_SIZE;
+
+	/* Allocate and initialize the arena. */
+	arena = OS_MALLOC(sizeof(os_arena_t));
+	os_memset(arena, 0, sizeof(os_arena_t));
+	arena->name       = name;
+	arena->chunk_size = (chunk_size + OS_ARENA_ALIGN - 1) &
+		~((size_t) OS_ARENA_ALIGN - 1);
+
+	/* Update the number of the arenas. */
+	atomic_fetch_add(&os_arena_list.count, 1);
+
+	return arena;
+}
+
+/**
+ * os_arena_alloc() - allocate a buffer from the list of its size class or
+ * from the current chunk.
+ *
+ * @g_arena:  generic address of the arena.
+ * @size:     size of the buffer up to OS_ARENA_CLASS_MAX.
+ *
+ * Return:	the start address of the buffer, aligned to 16 bytes.
+ **/
+void *os_arena_alloc(void *g_arena, size_t size)
+{
+	os_arena_free_t *elem;
+	os_arena_t *arena;
+	int c;
+
+	/* Entry condition. */
+	arena = g_arena;
+	OS_TRAP_IF(arena == NULL || size < 1 || size > OS_ARENA_CLASS_MAX);
+
+	/* Update the leak information. */
+	arena->stats.alloc_c++;
+	arena->stats.live++;
+	if (arena->stats.live > arena->stats.peak)
+		arena->stats.peak = arena->stats.live;
+
+	/* Remove the first released buffer of the size class. */
+	c = os_arena_class(size);
+	elem = arena->free[c];
+	if (elem != NULL) {
+		arena->free[c] = elem->next;
+		return elem;
+	}
+
+	/* Cut the buffer from the chunk. */
+	return os_arena_bump(arena, (size_t) OS_ARENA_ALIGN << c);
+}
+
+/**
+ * os_arena_free() - return the buffer to the list of its size class.
+ *
+ * @g_arena:  generic address of the arena.
+ * @ptr:      start address of the buffer.
+ * @size:     size of the os_arena_alloc() call.
+ *
+ * Return:	None.
+ **/
+void os_arena_free(void *g_arena, void *ptr, size_t size)
+{
+	os_arena_free_t *elem;
+	os_arena_t *arena;
+	int c;
+
+	/* Entry condition. */
+	arena = g_arena;
+	OS_TRAP_IF(arena == NULL || ptr == NULL || size < 1 ||
+		   size > OS_ARENA_CLASS_MAX || arena->stats.live < 1);
+
+	/* Insert the buffer in the list of its size class. */
+	c = os_arena_class(size);
+	elem = ptr;
+	elem->next = arena->free[c];
+	arena->free[c] = elem;
+
+	/* Update the leak information. */
+	arena->stats.live--;
+}
+
+/**
+ * os_arena_reset() - release all buffers of the arena at once. The chunks
+ * are kept for the next cycle.
+ *
+ * @g_arena:  generic address of the arena.
+ *
+ * Return:	None.
+ **/
+void os_arena_reset(void *g_arena)
+{
+	os_arena_t *arena;
+
+	/* Entry condition. */
+	arena = g_arena;
+	OS_TRAP_IF(arena == NULL);
+
+	/* Reset the size classes and the bump allocator. */
+	os_memset(arena->free, 0, sizeof(arena->free));
+	arena->cur = NULL;
+	arena->pos = NULL;
+	arena->end = NULL;
+
+	/* Update the leak information. */
+	arena->stats.live = 0;
+	arena->stats.reset_c++;
+}
+
+/**
+ * os_arena_stats() - provide the usage information of the arena.
+ *
+ * @g_arena:  generic address of the arena.
+ * @stats:    address of the usage information.
+ *
+ * Return:	None.
+ **/
+void os_arena_stats(void *g_arena, os_arena_stats_t *stats)
+{
+	os_arena_t *arena;
+
+	/* Entry condition. */
+	arena = g_arena;
+	OS_TRAP_IF(arena == NULL || stats == NULL);
+
+	/* Copy the usage information. */
+	*stats = arena->stats;
+}
+
+/**
+ * os_arena_destroy() - release the chunks of the arena. All buffers shall be
+ * released or reset.
+ *
+ * @g_arena:  generic address of the arena.
+ *
+ * Return:	None.
+ **/
+void os_arena_destroy(void *g_arena)
+{
+	os_arena_chunk_t *chunk, *next;
+	os_arena_t *arena;
+
+	/* Entry condition. */
+	arena = g_arena;
+	OS_TRAP_IF(arena == NULL);
+
+	/* Test the leak information. */
+	if (arena->stats.live != 0) {
+		printf("%s arena leak: [a=%s,live=%zu]\n", OS, arena->name,
+		       arena->stats.live);
+		OS_TRAP();
+	}
+
+	/* Release the chunks. */
+	for (chunk = arena->head; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		OS_FREE(chunk);
+	}
+
+	/* Release the arena. */
+	OS_FREE(arena);
+
+	/* Update the number of the arenas. */
+	atomic_fetch_sub(&os_arena_list.count, 1);
+}
+
+/**
+ * os_arena_init() - initialize the state of the arenas.
+ *
+ * Return:	None.
+ **/
+void os_arena_init(void)
+{
+	/* Reset the number of the arenas. */
+	atomic_init(&os_arena_list.count, 0);
+}
+
+/**
+ * os_arena_exit() - test the release of all arenas.
+ *
+ * Return:	None.
+ **/
+void os_arena_exit(void)
+{
+	/* Test the number of the arenas. */
+	OS_TRAP_IF(atomic_load(&os_arena_list.count) != 0);
+}
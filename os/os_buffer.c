@@ -157,6 +157,10 @@ static int buf_write_cb(int c_id, char *buf, int count)
 	/* Copy the next queue element. */
 	size = os_mq_read(b->out, buf, count);
 
+	/* Replace the saved EOS and substract it from the message size. */
+	if (size > 0)
+		buf[--size] = '\0';
+
 	/* Test the output state. */
 	if (size < 1) {
 		/* The drive waits for the write trigger. */
@@ -266,6 +270,8 @@ int os_bwritable(int u_id)
  * the buffer to write all of the requested bytes.
  * If no errors are detected, or error detection is not performed, 0 will be
  * returned without causing any other effect.
+ * The output queue is a SPSC queue: only one thread may call os_bwrite() for
+ * an end point; the debug build traps a second writer thread.
  *
  * @u_id:   id of the entry point.
  * @buf:    pointer to the source buffer.
@@ -315,6 +321,8 @@ int os_bwrite(int u_id, char *buf, int count)
  * On success, the number of bytes read is returned. It is not an error if this
  * number is smaller than the number of bytes requested.
  * On error, -1 is returned.
+ * The input queue is a SPSC queue: only one thread may call os_bread() for an
+ * end point; the debug build traps a second reader thread.
  *
  * @u_id:   id of the enty point.
  * @buf:    pointer to the destination buffer.
@@ -344,6 +352,10 @@ int os_bread(int u_id, char *buf, int count)
 	/* Copy the next queue element. */
 	size = os_mq_read(b->in, buf, count);
 
+	/* Replace the saved EOS and substract it from the message size. */
+	if (size > 0)
+		buf[--size] = '\0';
+
 	/* Test the state of the input buffer. */
 	trigger = atomic_exchange(&b->in_trigger, 0);
 	if (trigger) {
@@ -449,10 +461,10 @@ int os_bopen(const char *ep_name, int mode)
 	b->name = ep_name;
 
 	/* Create the input queue. */
-	b->in = os_mq_init(BUF_Q_SIZE);
+	b->in = os_mq_init_ext(BUF_Q_SIZE, OS_MQ_FRAMED | OS_MQ_SPSC);
 	
 	/* Create the output queue. */
-	b->out = os_mq_init(BUF_Q_SIZE);
+	b->out = os_mq_init_ext(BUF_Q_SIZE, OS_MQ_FRAMED | OS_MQ_SPSC);
 
 	/* Initialize the driver trigger for reading. */
 	atomic_store(&b->in_trigger, 1);
@@ -0,0 +1,408 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Cooperative fibers of the os_threads.
+ *
+ * Copyright (C) 2022 Gerald Schueller <gerald.schueller@web.de>
+ */
+
+/*============================================================================
+  IMPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include <ucontext.h>    /* User context switch: swapcontext(). */
+#include "os.h"          /* Operating system: os_sem_create() */
+
+/*============================================================================
+  EXPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include "os_private.h"  /* Local interfaces of the OS: os_fiber_init() */
+
+/*============================================================================
+  LOCAL NAME CONSTANTS DEFINITIONS
+  ============================================================================*/
+/* Default stack size of a fiber. */
+#define OS_FIBER_STACK_SIZE  (64 * 1024)
+
+/* Min. stack size of a fiber. */
+#define OS_FIBER_STACK_MIN  (16 * 1024)
+
+/*============================================================================
+  MACROS
+  ============================================================================*/
+/*============================================================================
+  LOCAL TYPE DEFINITIONS
+  ============================================================================*/
+/**
+ * os_fiber_state_t - states of a fiber.
+ *
+ * @OS_FIBER_READY:    the fiber is running or its resume message is queued.
+ * @OS_FIBER_WAITING:  the fiber waits for os_fiber_sem_post().
+ * @OS_FIBER_DONE:     the fiber callback has returned.
+ **/
+typedef enum {
+	OS_FIBER_READY,
+	OS_FIBER_WAITING,
+	OS_FIBER_DONE
+} os_fiber_state_t;
+
+/**
+ * os_fiber_t - coroutine, which runs in the message callback of its os_thread.
+ *
+ * @next:    successor in the waiting list of a fiber semaphore.
+ * @thread:  os_thread of the fiber.
+ * @cb:      start function of the fiber.
+ * @arg:     argument of the start function.
+ * @state:   fiber state.
+ * @ctx:     saved context of the fiber.
+ * @stack:   stack of the fiber.
+ **/
+typedef struct os_fiber_s {
+	struct os_fiber_s  *next;
+	void               *thread;
+	os_fiber_cb_t      *cb;
+	void               *arg;
+	os_fiber_state_t    state;
+	ucontext_t          ctx;
+	char               *stack;
+} os_fiber_t;
+
+/**
+ * os_fiber_msg_t - resume message of a fiber.
+ *
+ * @OS_QUEUE_MSG_HEAD:  generic message header, param refers to the fiber.
+ **/
+typedef struct {
+	OS_QUEUE_MSG_HEAD;
+} os_fiber_msg_t;
+
+/*============================================================================
+  LOCAL DATA
+  ============================================================================*/
+/**
+ * os_fiber_list - state of all fibers.
+ *
+ * @count:  number of the installed fibers.
+ **/
+static struct os_fiber_list_s {
+	atomic_int  count;
+} os_fiber_list;
+
+/* Running fiber of the current thread or NULL. */
+static __thread os_fiber_t *os_fiber_current;
+
+/* Context of the message callback, which resumes the fibers of the thread. */
+static __thread ucontext_t os_fiber_main;
+
+/*============================================================================
+  LOCAL FUNCTION PROTOTYPES
+  ============================================================================*/
+static void os_fiber_exec(os_queue_elem_t *m);
+
+/*============================================================================
+  LOCAL FUNCTIONS
+  ============================================================================*/
+/**
+ * os_fiber_schedule() - send the resume message of the fiber to its os_thread.
+ *
+ * @fiber:  pointer to the fiber.
+ *
+ * Return:	None.
+ **/
+static void os_fiber_schedule(os_fiber_t *fiber)
+{
+	os_fiber_msg_t msg;
+
+	/* Define the resume message. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = fiber;
+	msg.cb    = os_fiber_exec;
+
+	/* Insert the fiber behind the pending messages of the thread. */
+	OS_SEND(fiber->thread, &msg, sizeof(msg));
+}
+
+/**
+ * os_fiber_start() - entry point of the fiber context.
+ *
+ * Return:	None.
+ **/
+static void os_fiber_start(void)
+{
+	os_fiber_t *fiber;
+
+	/* Get the reference to the new fiber. */
+	fiber = os_fiber_current;
+
+	/* Execute the fiber. */
+	fiber->cb(fiber->arg);
+
+	/* Return to the message callback, which releases the fiber. */
+	fiber->state = OS_FIBER_DONE;
+	swapcontext(&fiber->ctx, &os_fiber_main);
+
+	/* A terminated fiber is never resumed. */
+	OS_TRAP();
+}
+
+/**
+ * os_fiber_exec() - resume the fiber in the os_thread context.
+ *
+ * @m:  pointer to the resume message.
+ *
+ * Return:	None.
+ **/
+static void os_fiber_exec(os_queue_elem_t *m)
+{
+	os_fiber_t *fiber;
+	int ret;
+
+	/* Decode the reference to the fiber. */
+	fiber = m->param;
+	OS_TRAP_IF(fiber == NULL || fiber->state != OS_FIBER_READY);
+
+	/* Switch to the fiber until it yields, waits or terminates. */
+	os_fiber_current = fiber;
+	ret = swapcontext(&os_fiber_main, &fiber->ctx);
+	OS_TRAP_IF(ret != 0);
+	os_fiber_current = NULL;
+
+	/* Test the fiber state. */
+	if (fiber->state != OS_FIBER_DONE)
+		return;
+
+	/* Release the terminated fiber outside of its stack. */
+	OS_FREE(fiber->stack);
+	OS_FREE(fiber);
+
+	/* Update the number of the fibers. */
+	atomic_fetch_sub(&os_fiber_list.count, 1);
+}
+
+/**
+ * os_fiber_suspend() - save the fiber context and return to the message
+ * callback of the os_thread.
+ *
+ * Return:	None.
+ **/
+static void os_fiber_suspend(void)
+{
+	os_fiber_t *fiber;
+	int ret;
+
+	/* Entry condition: only a fiber may suspend itself. */
+	fiber = os_fiber_current;
+	OS_TRAP_IF(fiber == NULL);
+
+	/* Switch to the message callback. */
+	ret = swapcontext(&fiber->ctx, &os_fiber_main);
+	OS_TRAP_IF(ret != 0);
+}
+
+/*============================================================================
+  EXPORTED FUNCTIONS
+  ============================================================================*/
+/**
+ * os_fiber_create() - create a fiber, which runs in the message callbacks of
+ * the os_thread. The fiber is released, when its start function returns.
+ *
+ * @g_thread:    generic address of the os_thread.
+ * @cb:          start function of the fiber.
+ * @arg:         argument of the start function.
+ * @stack_size:  stack size of the fiber, 0 for the default size.
+ *
+ * Return:	None.
+ **/
+void os_fiber_create(void *g_thread, os_fiber_cb_t *cb, void *arg,
+		     size_t stack_size)
+{
+	os_fiber_t *fiber;
+	int ret;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || cb == NULL ||
+		   (stack_size > 0 && stack_size < OS_FIBER_STACK_MIN));
+
+	/* Define the stack size. */
+	if (stack_size == 0)
+		stack_size = OS_FIBER_STACK_SIZE;
+
+	/* Allocate the fiber and its stack. */
+	fiber = OS_MALLOC(sizeof(os_fiber_t));
+	os_memset(fiber, 0, sizeof(os_fiber_t));
+	fiber->stack  = OS_MALLOC(stack_size);
+	fiber->thread = g_thread;
+	fiber->cb     = cb;
+	fiber->arg    = arg;
+	fiber->state  = OS_FIBER_READY;
+
+	/* Prepare the fiber context. */
+	ret = getcontext(&fiber->ctx);
+	OS_TRAP_IF(ret != 0);
+	fiber->ctx.uc_stack.ss_sp   = fiber->stack;
+	fiber->ctx.uc_stack.ss_size = stack_size;
+	fiber->ctx.uc_link          = NULL;
+	makecontext(&fiber->ctx, os_fiber_start, 0);
+
+	/* Update the number of the fibers. */
+	atomic_fetch_add(&os_fiber_list.count, 1);
+
+	/* Start the fiber in the os_thread. */
+	os_fiber_schedule(fiber);
+}
+
+/**
+ * os_fiber_yield() - continue the current fiber after the pending messages of
+ * its os_thread.
+ *
+ * Return:	None.
+ **/
+void os_fiber_yield(void)
+{
+	/* Entry condition. */
+	OS_TRAP_IF(os_fiber_current == NULL);
+
+	/* Queue the resume message and suspend the fiber. */
+	os_fiber_schedule(os_fiber_current);
+	os_fiber_suspend();
+}
+
+/**
+ * os_fiber_sem_init() - initialize the fiber semaphore.
+ *
+ * @sem:         pointer to the fiber semaphore.
+ * @init_value:  initial value of the semaphore counter.
+ *
+ * Return:	None.
+ **/
+void os_fiber_sem_init(os_fiber_sem_t *sem, int init_value)
+{
+	/* Entry condition. */
+	OS_TRAP_IF(sem == NULL || init_value < 0);
+
+	/* Reset the semaphore. */
+	os_spin_init(&sem->protect);
+	sem->count = init_value;
+	sem->head  = NULL;
+	sem->tail  = NULL;
+}
+
+/**
+ * os_fiber_sem_wait() - decrement the semaphore or suspend the current fiber,
+ * while the os_thread continues with other messages and fibers.
+ *
+ * @sem:  pointer to the fiber semaphore.
+ *
+ * Return:	None.
+ **/
+void os_fiber_sem_wait(os_fiber_sem_t *sem)
+{
+	os_fiber_t *fiber;
+
+	/* Entry condition. */
+	fiber = os_fiber_current;
+	OS_TRAP_IF(sem == NULL || fiber == NULL);
+
+	/* Enter the critical section. */
+	os_spin_lock(&sem->protect);
+
+	/* Test the semaphore counter. */
+	if (sem->count > 0) {
+		sem->count--;
+		os_spin_unlock(&sem->protect);
+		return;
+	}
+
+	/* Append the fiber to the waiting list. */
+	fiber->state = OS_FIBER_WAITING;
+	fiber->next  = NULL;
+	if (sem->tail != NULL)
+		sem->tail->next = fiber;
+	else
+		sem->head = fiber;
+
+	sem->tail = fiber;
+
+	/* Leave the critical section; a resume message is processed only
+	 * after the suspension. */
+	os_spin_unlock(&sem->protect);
+
+	/* Suspend the fiber until os_fiber_sem_post. */
+	os_fiber_suspend();
+}
+
+/**
+ * os_fiber_sem_post() - resume the first waiting fiber or increment the
+ * semaphore. Any thread may call this function.
+ *
+ * @sem:  pointer to the fiber semaphore.
+ *
+ * Return:	None.
+ **/
+void os_fiber_sem_post(os_fiber_sem_t *sem)
+{
+	os_fiber_t *fiber;
+
+	/* Entry condition. */
+	OS_TRAP_IF(sem == NULL);
+
+	/* Enter the critical section. */
+	os_spin_lock(&sem->protect);
+
+	/* Remove the first waiting fiber. */
+	fiber = sem->head;
+	if (fiber != NULL) {
+		sem->head = fiber->next;
+		if (sem->head == NULL)
+			sem->tail = NULL;
+
+		fiber->state = OS_FIBER_READY;
+	}
+	else {
+		sem->count++;
+	}
+
+	/* Leave the critical section. */
+	os_spin_unlock(&sem->protect);
+
+	/* Resume the fiber in its os_thread. */
+	if (fiber != NULL)
+		os_fiber_schedule(fiber);
+}
+
+/**
+ * os_fiber_sem_delete() - release the fiber semaphore.
+ *
+ * @sem:  pointer to the fiber semaphore.
+ *
+ * Return:	None.
+ **/
+void os_fiber_sem_delete(os_fiber_sem_t *sem)
+{
+	/* Entry condition: no fiber may wait for the semaphore. */
+	OS_TRAP_IF(sem == NULL || sem->head != NULL);
+
+	/* Release the lock. */
+	os_spin_destroy(&sem->protect);
+}
+
+/**
+ * os_fiber_init() - initialize the state of the fibers.
+ *
+ * Return:	None.
+ **/
+void os_fiber_init(void)
+{
+	/* Reset the number of the fibers. */
+	atomic_init(&os_fiber_list.count, 0);
+}
+
+/**
+ * os_fiber_exit() - test the termination of all fibers.
+ *
+ * Return:	None.
+ **/
+void os_fiber_exit(void)
+{
+	/* Test the number of the fibers. */
+	OS_TRAP_IF(atomic_load(&os_fiber_list.count) != 0);
+}
@@ -28,6 +28,7 @@
 #define INET_THR_QSIZE     1  /* Input queue size of the inet threads. */
 #define INET_MQ_SIZE    8192  /* SIze of the I/O queues. */
 #define INET_MTU_SIZE    512  /* Max. size of a message. */
+#define INET_BURST_N      16  /* Max. number of the messages of a burst. */
 #define INET_CE_SIZE     512  /* Buffer size for the connection establishment. */
 
 /* Accept message for the connection establishment. */
@@ -131,12 +132,13 @@ static struct is_s {
  **/
 static void inet_snd_exec(os_queue_elem_t *g_msg)
 {
+	os_mq_iov_t iov[INET_BURST_N];
 	struct sockaddr *addr;
 	inet_thr_t  *thr;
 	socklen_t  addr_len;
 	inet_t *ip;
 	char *buf;
-	int down, size, rv, err;
+	int down, size, rv, err, burst, i;
 #if 0
 	int snd_count, n;
 #endif
@@ -164,33 +166,41 @@ static void inet_snd_exec(os_queue_elem_t *g_msg)
 
 		/* Send all pending messages. */
 		for(;;) {
-			/* Get the pointer to the message. */
-			buf = os_mq_get(ip->out, &size);
-			if (buf == NULL)
+			/* Get the pointers to the next burst of messages. */
+			burst = os_mq_read_batch(ip->out, iov, INET_BURST_N);
+			if (burst < 1)
 				break;
+
+			/* Loop thru the messages of the burst. */
+			for (i = 0; i < burst; i++) {
+				buf  = iov[i].buf;
+				size = iov[i].size;
 #if 0
-			/* Substract EOS, convert and test the send counter. */
-			n = os_strtol_b10(buf, size - 1);
-			OS_TRAP_IF(snd_count != n);
-			snd_count++;
+				/* Substract EOS, convert and test the send
+				 * counter. */
+				n = os_strtol_b10(buf, size - 1);
+				OS_TRAP_IF(snd_count != n);
+				snd_count++;
 #endif
 
-			/* Blocking transmission of a message to another
-			 * socket. */
-			rv = sendto(ip->sid, buf, size, 0, addr, addr_len);
-
-			/* Test the return value. */
-			if (rv != size) {
-				/* Copy and print the error code. */
-				err = errno;
-				printf("%s: rv=%d, size=%d, errno=%d\n",
-				       F, rv, size, err);
-			}
+				/* Blocking transmission of a message to
+				 * another socket. */
+				rv = sendto(ip->sid, buf, size, 0, addr,
+					    addr_len);
+
+				/* Test the return value. */
+				if (rv != size) {
+					/* Copy and print the error code. */
+					err = errno;
+					printf("%s: rv=%d, size=%d, errno=%d\n",
+					       F, rv, size, err);
+				}
 			
-			OS_TRAP_IF(rv == -1);
+				OS_TRAP_IF(rv == -1);
+			}
 
-			/* Remove the message from the output queue. */
-			os_mq_remove(ip->out, size);
+			/* Remove the burst from the output queue. */
+			os_mq_remove_batch(ip->out, iov, burst);
 		}
 
 		/* Start the suspend actions. */
@@ -287,9 +297,6 @@ static void inet_rcv_exec(os_queue_elem_t *g_msg)
 				calling = 0;
 			}
 
-			/* Replace end of string with the message delimiter. */
-			buf[size - 1] = '#';
-	
 			/* Complete the receive operation. */
 			os_mq_add(ip->in, size);
 		}
@@ -587,6 +594,8 @@ int os_inet_writable(int cid)
  * the buffer to write all of the requested bytes.
  * If no errors are detected, or error detection is not performed, 0 will be
  * returned without causing any other effect.
+ * The output queue is a SPSC queue: only one thread may call os_inet_write()
+ * for a socket; the debug build traps a second writer thread.
  *
  * @cid:    socket communication id.
  * @buf:    pointer to the source buffer.
@@ -633,6 +642,8 @@ int os_inet_write(int cid, char *buf, int count)
  * os_inet_read() - read from an internet socket. os_inet_read() attempts to
  * read up to count bytes from the internet socket into the buffer starting
  * at buf.
+ * The input queue is a SPSC queue: only one thread may call os_inet_read()
+ * for a socket; the debug build traps a second reader thread.
  *
  * @cid     internet communication id.
  * @buf:    pointer to the destination buffer.
@@ -662,6 +673,10 @@ int os_inet_read(int cid, char *buf, int count)
 	/* Copy the next queue element. */
 	size = os_mq_read(ip->in, buf, count);
 
+	/* Replace the saved EOS and substract it from the message size. */
+	if (size > 0)
+		buf[--size] = '\0';
+
 	/* Get the state of the receiving thread. */
 	suspended = atomic_load(&ip->recv_thr.suspended);
 	
@@ -888,9 +903,10 @@ int os_inet_open(const char *my_addr, int my_p, const char *his_addr, int his_p)
 	/* Save the connection id. */
 	ip->cid = i;
 
-	/* Create the I/O queues. */
-	ip->in  = os_mq_init(INET_MQ_SIZE);
-	ip->out = os_mq_init(INET_MQ_SIZE);
+	/* Create the I/O queues, each with one producer and one consumer
+	 * thread. */
+	ip->in  = os_mq_init_ext(INET_MQ_SIZE, OS_MQ_FRAMED | OS_MQ_SPSC);
+	ip->out = os_mq_init_ext(INET_MQ_SIZE, OS_MQ_FRAMED | OS_MQ_SPSC);
 
 	/* Define the socket address of the local peer. */
 	inet_sock_addr(&ip->my_addr, my_addr, my_p);
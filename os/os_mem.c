@@ -9,6 +9,9 @@
 /*============================================================================
   IMPORTED INCLUDE REFERENCES
   ============================================================================*/
+#include <pthread.h>     /* POSIX thread: pthread_key_create(). */
+#include <time.h>        /* Time types: clock_gettime(). */
+#include <string.h>      /* String operations: memset(). */
 #include "os.h"          /* Operating system: os_sem_create() */
 
 /*============================================================================
@@ -19,65 +22,169 @@
 /*============================================================================
   LOCAL NAME CONSTANTS DEFINITIONS
   ============================================================================*/
+/* End of the free list of a shard. */
+#define OS_MEM_NIL  0
+
+/* Number of the elements of the first chunk of a shard; each further chunk
+ * doubles the capacity. */
+#define OS_MEM_CHUNK  512
+
+/* Max. number of the chunks of a shard. */
+#define OS_MEM_CHUNK_N  22
+
+/* Number of the call site entries of the profiler, a power of two. */
+#define OS_MEM_SITE_N  1024
+
+/* Number of the released buffers, which the diagnostic mode holds back. */
+#define OS_MEM_QUARANTINE_N  1024
+
+/* Fill byte of a new buffer in the diagnostic mode. */
+#define OS_MEM_POISON_NEW  0x5a
+
 /*============================================================================
   MACROS
   ============================================================================*/
 /*============================================================================
   LOCAL TYPE DEFINITIONS
   ============================================================================*/
+struct os_mem_shard_s;
+
+/**
+ * os_mem_state_t - state of a tracking element.
+ *
+ * @OS_MEM_FREE:         the element is in the free list of its shard.
+ * @OS_MEM_USED:         the buffer is allocated.
+ * @OS_MEM_QUARANTINED:  the buffer is released and poisoned, but its memory
+ *                       is held back to detect double frees and writes
+ *                       after the release.
+ **/
+typedef enum {
+	OS_MEM_FREE,
+	OS_MEM_USED,
+	OS_MEM_QUARANTINED
+} os_mem_state_t;
+
+/**
+ * os_mem_site_state_t - state of a call site entry.
+ *
+ * @OS_MEM_SITE_FREE:   the entry is unused.
+ * @OS_MEM_SITE_BUSY:   a thread is saving the key of the call site.
+ * @OS_MEM_SITE_READY:  the key of the call site is valid.
+ **/
+typedef enum {
+	OS_MEM_SITE_FREE,
+	OS_MEM_SITE_BUSY,
+	OS_MEM_SITE_READY
+} os_mem_site_state_t;
 
-/* State of a single malloc element. */
+/**
+ * os_mem_site_t - allocation profile of an os_malloc call site.
+ *
+ * @state:    state of the entry.
+ * @file:     __FILE__ pointer of the call site.
+ * @line:     line number of the call site.
+ * @live:     outstanding bytes.
+ * @peak:     high-water mark of the outstanding bytes.
+ * @alloc_c:  number of the os_malloc calls.
+ * @free_c:   number of the os_free calls.
+ * @hist:     lifetime histogram of the released buffers.
+ **/
+typedef struct {
+	atomic_int           state;
+	char                *file;
+	unsigned long        line;
+	atomic_llong         live;
+	atomic_llong         peak;
+	atomic_ullong        alloc_c;
+	atomic_ullong        free_c;
+	atomic_ullong        hist[OS_MEM_HIST_LEN];
+} os_mem_site_t;
 
 /**
- * os_mem_t - start addess of the memory allocated with malloc().
+ * os_mem_elem_t - tracking element of an os_malloc call.
  *
- * @elem_idx:   position in the memory list.
- * @file_idx:   position in the file list.
- * @line:       line number of the os_malloc() call.
- * @allocated:  1, if the element is in use.
+ * @next:       position + 1 of the next free element of the shard.
+ * @idx:        position of the element in the shard.
+ * @state:      element state.
+ * @site:       profile of the os_malloc() call site.
+ * @size:       requested size of the buffer.
+ * @birth:      time of the os_malloc() call in nanoseconds.
  * @start:      start address of the allocated memoy for the client.
+ * @free_file:  __FILE__ of the os_free() call in the diagnostic mode.
+ * @free_line:  __LINE__ of the os_free() call in the diagnostic mode.
  **/
 typedef struct {
-        int    elem_idx;
-        int    file_idx;
-        unsigned long line;
-        int    allocated;
-        void  *start;
+	atomic_int      next;
+	int             idx;
+	atomic_int      state;
+	os_mem_site_t  *site;
+	size_t          size;
+	long long       birth;
+	void           *start;
+	char           *free_file;
+	unsigned long   free_line;
 } os_mem_elem_t;
 
-/* State of the malloc table. */
 /**
- * os_mem_stat_t - list for the os_malloc calls.
- *
- * @protect:   mutex for the critical section.
- * @file:      file list.
- * @next:      current start index of the element list.
- * @malloc_c:  number of the os_malloc calls.
- * @free_c:    number of the os_free calls.
- * @elem:      os_malloc list.
+ * os_mem_shard_t - os_malloc list of a thread: only the owner allocates the
+ * elements and adds chunks, but any thread may return the elements.
+ *
+ * @next:      successor in the shard list.
+ * @owned:     1, if a living thread uses the shard.
+ * @free:      lock-free list of the free elements with the position + 1 of
+ *             the first element; only the owner removes elements, so the
+ *             list needs no ABA counter.
+ * @chunk_n:   number of the installed chunks.
+ * @malloc_c:  number of the os_malloc calls of the owner.
+ * @free_c:    number of the os_free calls for the shard elements.
+ * @chunk:     element chunks, chunk k contains OS_MEM_CHUNK << k elements.
+ **/
+typedef struct os_mem_shard_s {
+	struct os_mem_shard_s  *next;
+	atomic_int              owned;
+	atomic_int              free;
+	atomic_int              chunk_n;
+	atomic_ulong            malloc_c;
+	atomic_ulong            free_c;
+	os_mem_elem_t          *chunk[OS_MEM_CHUNK_N];
+} os_mem_shard_t;
+
+/**
+ * os_mem_stat_t - state of the os_malloc tracker.
+ *
+ * @protect:  mutex for the installation of the shards.
+ * @key:      data key to orphan the shard of a terminated thread.
+ * @gen:      generation of the tracker, which invalidates the thread cache
+ *            after os_mem_exit().
+ * @shard:    list of the shards.
+ * @site:     open addressed table of the call sites.
+ * @other:    profile of the call sites beyond the table capacity.
+ * @diag:     1, if the released buffers are poisoned and quarantined.
+ * @q_head:   insertion counter of the quarantine ring.
+ * @q_ring:   quarantined elements, the oldest one is released on insertion.
  **/
 typedef struct {
-        pthread_mutex_t   protect;
-        char             *file[OS_MALLOC_FILE_LIMIT];
-        int               next;
-        unsigned long     malloc_c;
-        unsigned long     free_c;
-        os_mem_elem_t     elem[OS_MALLOC_LIMIT];
+	pthread_mutex_t             protect;
+	pthread_key_t               key;
+	atomic_int                  gen;
+	_Atomic(os_mem_shard_t *)   shard;
+	os_mem_site_t               site[OS_MEM_SITE_N];
+	os_mem_site_t               other;
+	int                         diag;
+	atomic_uint                 q_head;
+	_Atomic(os_mem_elem_t *)    q_ring[OS_MEM_QUARANTINE_N];
 } os_mem_stat_t;
 
 /**
- * os_mem_t - start addess of the memory allocated with malloc().
+ * os_mem_t - header in front of the client memory, which keeps the 16 byte
+ * alignment of malloc().
  *
- * @idx:    position in the memory list.
- * @align:  64 bit alignmen.
- * @start:  start address of the allocated memoy for the client.
+ * @shard:  shard of the os_malloc element.
+ * @elem:   tracking element of the allocation.
  **/
 typedef struct {
-        int list_idx;
-        union {
-                unsigned long long align;
-                void *start;
-        } ptr;
+	os_mem_shard_t  *shard;
+	os_mem_elem_t   *elem;
 } os_mem_t;
 
 /*============================================================================
@@ -87,185 +194,385 @@ typedef struct {
 /* State of the os_malloc list. */
 static os_mem_stat_t os_mem_stat;
 
+/* Shard of the current thread and its tracker generation. */
+static __thread os_mem_shard_t *os_mem_shard;
+static __thread int os_mem_gen;
+
 /*============================================================================
   LOCAL FUNCTION PROTOTYPES
   ============================================================================*/
 /*============================================================================
   LOCAL FUNCTIONS
   ============================================================================*/
+/**
+ * os_mem_orphan() - destructor of the data key: release the shard of the
+ * terminated thread for the next new thread.
+ *
+ * @arg:  reference to the shard.
+ *
+ * Return:	None.
+ **/
+static void os_mem_orphan(void *arg)
+{
+	os_mem_shard_t *shard;
+
+	/* Decode the reference to the shard. */
+	shard = arg;
+
+	/* The outstanding elements remain valid. */
+	atomic_store(&shard->owned, 0);
+}
 
 /**
- * os_mem_elem_put() - free an os_malloc element.
+ * os_mem_elem() - map the position of an element to its chunk.
  *
- * @idx:  index of the reserved list element.
- * @ptr:  address of the external os_malloc buffer.
+ * @shard:  pointer to the shard.
+ * @idx:    position of the element in the shard.
  *
- * Return:     None.
+ * Return:	the pointer to the element.
  **/
-static void os_mem_elem_put(int idx, void *ptr)
+static os_mem_elem_t *os_mem_elem(os_mem_shard_t *shard, int idx)
 {
-	os_mem_stat_t *p;
-	os_mem_elem_t *elem;
-	
-	/* Get the reference of the os_malloc list. */
-        p = &os_mem_stat;
+	unsigned int k, base;
 
-        /* Enter the critical section. */
-        os_cs_enter(&p->protect);
+	/* Chunk k starts at OS_MEM_CHUNK * (2^k - 1). */
+	k = 31 - __builtin_clz((unsigned int) idx / OS_MEM_CHUNK + 1);
+	base = OS_MEM_CHUNK * ((1U << k) - 1);
 
-        /* Entry condition. */
-        OS_TRAP_IF(idx < 0 || idx >= OS_MALLOC_LIMIT);
+	return &shard->chunk[k][idx - base];
+}
 
+/**
+ * os_mem_grow() - add a chunk of double size to the shard and insert its
+ * elements in the free list. Only the owner calls this function.
+ *
+ * @shard:  pointer to the shard.
+ *
+ * Return:	None.
+ **/
+static void os_mem_grow(os_mem_shard_t *shard)
+{
+	os_mem_elem_t *chunk;
+	int k, n, base, head, i;
+
+	/* Calculate the size and the first position of the new chunk. */
+	k = atomic_load(&shard->chunk_n);
+	OS_TRAP_IF(k >= OS_MEM_CHUNK_N);
+	n    = OS_MEM_CHUNK << k;
+	base = OS_MEM_CHUNK * ((1 << k) - 1);
+
+	/* Allocate and chain the new elements. */
+	chunk = calloc(n, sizeof(os_mem_elem_t));
+	OS_TRAP_IF(chunk == NULL);
+	for (i = 0; i < n; i++) {
+		chunk[i].idx = base + i;
+		atomic_init(&chunk[i].next, base + i + 2);
+	}
+
+	/* Publish the chunk before its positions. */
+	shard->chunk[k] = chunk;
+	atomic_store(&shard->chunk_n, k + 1);
 
-        /* Get the reference of the os_malloc element. */
-        elem = &p->elem[idx];
+	/* Insert the chain in front of the concurrently returned elements. */
+	head = atomic_load(&shard->free);
+	do {
+		atomic_store(&chunk[n - 1].next, head);
+	} while (! atomic_compare_exchange_weak(&shard->free, &head, base + 1));
+}
 
-        /* Test the element state. */
-        OS_TRAP_IF((! elem->allocated) || elem->start != ptr);
+/**
+ * os_mem_now() - read the monotonic clock.
+ *
+ * Return:	the current time in nanoseconds.
+ **/
+static long long os_mem_now(void)
+{
+	struct timespec t;
 
-        /* Reset the os_malloc element. */
-        elem->allocated = 0;
+	/* Read the monotonic clock. */
+	clock_gettime(CLOCK_MONOTONIC, &t);
 
-        /* Increment the free counter. */
-        p->free_c++;
-	
-	/* Leave the critical section. */
-        os_cs_leave(&p->protect);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
 }
 
 /**
- * os_mem_elem_alloc() - get a new os_malloc element.
+ * os_mem_site_find() - search for the profile of the call site and install
+ * it optionally.
  *
- * @p:     address of the os_malloc state.
+ * @file:     __FILE__ pointer of the call site.
+ * @line:     line number of the call site.
+ * @install:  1, if a missing call site shall be installed.
  *
- * Return:     the os_malloc element.
+ * Return:	the profile of the call site or NULL.
  **/
-static os_mem_elem_t *os_mem_elem_alloc(os_mem_stat_t *p)
+static os_mem_site_t *os_mem_site_find(char *file, unsigned long line,
+				       int install)
 {
-        os_mem_elem_t *elem, *list;
-        int  next, last;
+	unsigned long long h;
+	os_mem_site_t *site;
+	int i, state;
+
+	/* Hash the identity of the call site. */
+	h = ((unsigned long) file ^ line) * 0x9e3779b97f4a7c15ULL;
+	h >>= 32;
+
+	/* Probe the table in linear order. */
+	for (i = 0; i < OS_MEM_SITE_N; i++) {
+		site  = &os_mem_stat.site[(h + i) & (OS_MEM_SITE_N - 1)];
+		state = atomic_load(&site->state);
+
+		/* Claim the unused entry. */
+		if (state == OS_MEM_SITE_FREE) {
+			if (! install)
+				return NULL;
+
+			if (atomic_compare_exchange_strong(&site->state, &state,
+							   OS_MEM_SITE_BUSY)) {
+				site->file = file;
+				site->line = line;
+				atomic_store(&site->state, OS_MEM_SITE_READY);
+				return site;
+			}
+		}
+
+		/* Wait for the key of a concurrent installation. */
+		while (state == OS_MEM_SITE_BUSY)
+			state = atomic_load(&site->state);
+
+		/* Compare the key. */
+		if (site->file == file && site->line == line)
+			return site;
+	}
 
-        /* Initialize the local state. */
-        list = p->elem;
-        next = p->next;
-        elem = &list[next];
+	/* The table is full. */
+	return install ? &os_mem_stat.other : NULL;
+}
 
-        elem->allocated = 1;
-        elem->start = NULL;
+/**
+ * os_mem_site_copy() - copy the counters of the call site profile.
+ *
+ * @site:   pointer to the call site profile.
+ * @stats:  address of the copy.
+ *
+ * Return:	None.
+ **/
+static void os_mem_site_copy(os_mem_site_t *site, os_mem_site_stats_t *stats)
+{
+	int i;
 
-        last  = next;
+	/* Copy the atomic counters. */
+	stats->live    = atomic_load(&site->live);
+	stats->peak    = atomic_load(&site->peak);
+	stats->alloc_c = atomic_load(&site->alloc_c);
+	stats->free_c  = atomic_load(&site->free_c);
+	for (i = 0; i < OS_MEM_HIST_LEN; i++)
+		stats->hist[i] = atomic_load(&site->hist[i]);
+}
 
-        /* Search for the next free element. */
-        for (;;) {
+/**
+ * os_mem_site_print() - print the profile of a call site.
+ *
+ * @site:  pointer to the call site profile.
+ *
+ * Return:	None.
+ **/
+static void os_mem_site_print(os_mem_site_t *site)
+{
+	os_mem_site_stats_t st;
+	int i;
 
-                /* Increment the search index. */
-                next++;
-                if (next >= OS_MALLOC_LIMIT)
-                        next = 0;
+	/* Test the usage of the call site. */
+	os_mem_site_copy(site, &st);
+	if (st.alloc_c < 1)
+		return;
 
-                /* Test the list state. */
-                OS_TRAP_IF(next == last);
+	/* Print the byte and call counters. */
+	printf("%s [%s:%lu,live=%lld,peak=%lld,n=%llu,f=%llu]\n", OS,
+	       site->file != NULL ? site->file : "?", site->line, st.live,
+	       st.peak, st.alloc_c, st.free_c);
+
+	/* Print the used lifetime buckets. */
+	for (i = 0; i < OS_MEM_HIST_LEN; i++) {
+		if (st.hist[i] > 0)
+			printf("%s   <%lluns: %llu\n", OS, 1ULL << i, st.hist[i]);
+	}
+}
 
-                /* Test the state of the list element. */
-                if (! list[next].allocated) {
-                        /* Save the index of the next free element. */
-                        p->next = next;
-                        break;
-                }
-        }
+/**
+ * os_mem_name() - replace a missing __FILE__ reference.
+ *
+ * @file:  __FILE__ reference or NULL.
+ *
+ * Return:	the printable file name.
+ **/
+static char *os_mem_name(char *file)
+{
+	return file != NULL ? file : "?";
+}
 
-        return elem;
+/**
+ * os_mem_release() - return the element to the free list of its shard and
+ * release the buffer.
+ *
+ * @elem:  pointer to the element of the released buffer.
+ *
+ * Return:	None.
+ **/
+static void os_mem_release(os_mem_elem_t *elem)
+{
+	os_mem_shard_t *shard;
+	os_mem_t *mem;
+	int head;
 
+	/* Calculate the start of the allocated memory. */
+	mem   = (os_mem_t *) ((char *) elem->start - sizeof (os_mem_t));
+	shard = mem->shard;
+
+	/* Insert the element at the start of the free list of the shard. */
+	atomic_store(&elem->state, OS_MEM_FREE);
+	head = atomic_load(&shard->free);
+	do {
+		atomic_store(&elem->next, head);
+	} while (! atomic_compare_exchange_weak(&shard->free, &head,
+						elem->idx + 1));
+
+	/* Free the allocated buffer. */
+	free(mem);
 }
 
 /**
- * os_mem_file_idx() - map the file name to index.
+ * os_mem_evict() - test the poison of a quarantined buffer and release it.
  *
- * @p:     address of the os_malloc state.
- * @file:  matches __FILE__.
+ * @elem:  pointer to the element of the quarantined buffer.
  *
- * Return:	the file index.
+ * Return:	None.
  **/
-static int os_mem_file_idx(os_mem_stat_t *p, char *file)
+static void os_mem_evict(os_mem_elem_t *elem)
 {
-        int      i, free;
-        char   **list;
-	size_t   len;
-
-        /* Initialize the file name index. */
-        free = -1;
-
-        /* Get the reference to the file name list. */
-        list = p->file;
-
-        /* Loop thru the file name list. */
-        for (i = 0; i < OS_MALLOC_FILE_LIMIT; i++) {
-                /* Test the file name element. */
-                if (list[i] != NULL) {
-                        /* Test the file name. */
-                        if (os_strcmp(list[i], file) == 0)
-                                return i; /* Found. */
-			
-                        /* Continue with the search. */
-                        continue;
-                }
-
-                /* Test the free index. */
-                if (free < 0)
-                        free = i;
-        }
-
-        /* Test the free index. */
-        OS_TRAP_IF(free < 0);
-
-        /* Create a new file name element. */
-        len = os_strlen(file) + 1;
-        list[free] = malloc (len);
-        OS_TRAP_IF (list[free] == NULL);
-
-        /* Save the file name. */
-        os_strcpy(list[free], len, file);
-
-        return free;
+	unsigned char *data;
+	size_t i;
+
+	/* Search for a write after the release. */
+	data = elem->start;
+	for (i = 0; i < elem->size; i++) {
+		if (data[i] == OS_MEM_POISON)
+			continue;
+
+		printf("%s use after free: [%s:%lu,size=%zu,offset=%zu] "
+		       "freed at [%s:%lu]\n", OS, os_mem_name(elem->site->file),
+		       elem->site->line, elem->size, i,
+		       os_mem_name(elem->free_file), elem->free_line);
+		OS_TRAP();
+	}
+
+	/* Release the buffer. */
+	os_mem_release(elem);
 }
 
 /**
- * os_mem_elem_get() - get a os_malloc element.
+ * os_mem_quarantine() - hold back the released buffer and release the oldest
+ * quarantined buffer instead.
  *
- * @file:  matches __FILE__.
- * @line:  matches __LINE__.
+ * @elem:  pointer to the element of the poisoned buffer.
  *
- * Return:	the pointer to the os_malloc element.
+ * Return:	None.
  **/
-static os_mem_elem_t *os_mem_elem_get(char *file, unsigned long line)
+static void os_mem_quarantine(os_mem_elem_t *elem)
 {
-        os_mem_stat_t *p;
-        os_mem_elem_t *elem;
-        int idx;
+	os_mem_elem_t *old;
+	unsigned int i;
 
-        /* Get the reference of the os_malloc list. */
-        p = &os_mem_stat;
+	/* Replace the oldest entry of the ring. */
+	i = atomic_fetch_add(&os_mem_stat.q_head, 1) % OS_MEM_QUARANTINE_N;
+	old = atomic_exchange(&os_mem_stat.q_ring[i], elem);
 
-        /* Enter the critical section. */
-        os_cs_enter(&p->protect);
+	/* Release the displaced buffer. */
+	if (old != NULL)
+		os_mem_evict(old);
+}
 
-        /* Map the file name to index. */
-        idx = os_mem_file_idx(p, file);
+/**
+ * os_mem_bad_free() - report an invalid os_free() call and trigger a core
+ * dump.
+ *
+ * @elem:   pointer to the element of the header.
+ * @ptr:    start address of the released memory.
+ * @state:  element state.
+ * @file:   __FILE__ of the os_free() call.
+ * @line:   __LINE__ of the os_free() call.
+ *
+ * Return:	None.
+ **/
+static void os_mem_bad_free(os_mem_elem_t *elem, void *ptr, int state,
+			    char *file, unsigned long line)
+{
+	/* Identify the double free of a quarantined buffer. */
+	if (elem->start == ptr && state == OS_MEM_QUARANTINED)
+		printf("%s double free at [%s:%lu]: [%s:%lu,size=%zu] "
+		       "freed at [%s:%lu]\n", OS, os_mem_name(file), line,
+		       os_mem_name(elem->site->file), elem->site->line,
+		       elem->size, os_mem_name(elem->free_file),
+		       elem->free_line);
+	else
+		printf("%s invalid free at [%s:%lu]\n", OS, os_mem_name(file),
+		       line);
+
+	OS_TRAP();
+}
 
-        /* Get os_malloc element. */
-        elem = os_mem_elem_alloc (p);
+/**
+ * os_mem_shard_get() - get the shard of the current thread, reuse an orphaned
+ * shard or install a new one.
+ *
+ * Return:	the pointer to the shard.
+ **/
+static os_mem_shard_t *os_mem_shard_get(void)
+{
+	os_mem_shard_t *shard;
+	os_mem_stat_t *p;
+	int gen, owned, ret;
 
-        /* Increment the os_malloc counter. */
-        p->malloc_c++;
+	/* Test the cache of the thread. */
+	p   = &os_mem_stat;
+	gen = atomic_load(&p->gen);
+	if (os_mem_shard != NULL && os_mem_gen == gen)
+		return os_mem_shard;
 
-        /* Save the file index and the line number. */
-        elem->file_idx = idx;
-        elem->line     = line;
+	/* Enter the critical section. */
+	os_cs_enter(&p->protect);
 
-        /* Leave the critical section. */
-        os_cs_leave(&p->protect);
+	/* Search for an orphaned shard. */
+	for (shard = atomic_load(&p->shard); shard != NULL; shard = shard->next) {
+		owned = 0;
+		if (atomic_compare_exchange_strong(&shard->owned, &owned, 1))
+			break;
+	}
 
-        return elem;
+	/* Install a new shard with the first chunk. */
+	if (shard == NULL) {
+		shard = calloc(1, sizeof(os_mem_shard_t));
+		OS_TRAP_IF(shard == NULL);
+		atomic_init(&shard->free, OS_MEM_NIL);
+		atomic_init(&shard->owned, 1);
+		os_mem_grow(shard);
+
+		/* Publish the shard for os_mem_statistics. */
+		shard->next = atomic_load(&p->shard);
+		atomic_store(&p->shard, shard);
+	}
+
+	/* Leave the critical section. */
+	os_cs_leave(&p->protect);
+
+	/* Orphan the shard at the end of the thread. */
+	ret = pthread_setspecific(p->key, shard);
+	OS_TRAP_IF(ret != 0);
+
+	/* Save the shard in the cache of the thread. */
+	os_mem_shard = shard;
+	os_mem_gen   = gen;
+
+	return shard;
 }
 
 /*============================================================================
@@ -284,29 +591,135 @@ static os_mem_elem_t *os_mem_elem_get(char *file, unsigned long line)
  **/
 void *os_malloc(size_t size, char *file, unsigned long line)
 {
-        os_mem_elem_t  *elem;
-        os_mem_t  *mem;
-	
+	os_mem_shard_t *shard;
+	os_mem_site_t *site;
+	os_mem_elem_t *elem;
+	os_mem_t *mem;
+	int head, next;
+	unsigned long c;
+	long long live, peak;
+
 	/* Entry condition. */
 	OS_TRAP_IF(size < 1);
 
-        /* Request memory from the OS. */
-        mem = malloc(size + sizeof(os_mem_t));
-        OS_TRAP_IF(mem == NULL);
-
-        /* Save the start address. */
-        mem->ptr.start = (char *) mem + sizeof(os_mem_t);
+	/* Request memory from the OS. */
+	mem = malloc(size + sizeof(os_mem_t));
+	OS_TRAP_IF(mem == NULL);
+
+	/* Get the shard of the current thread. */
+	shard = os_mem_shard_get();
+
+	/* Remove the first free element, only the owner removes elements. */
+	head = atomic_load(&shard->free);
+	do {
+		/* Grow the shard, if all elements are in use. */
+		if (head == OS_MEM_NIL) {
+			os_mem_grow(shard);
+			head = atomic_load(&shard->free);
+		}
+
+		next = atomic_load(&os_mem_elem(shard, head - 1)->next);
+	} while (! atomic_compare_exchange_weak(&shard->free, &head, next));
+
+	/* Update the profile of the call site. */
+	site = os_mem_site_find(file, line, 1);
+	atomic_fetch_add_explicit(&site->alloc_c, 1, memory_order_relaxed);
+	live = atomic_fetch_add_explicit(&site->live, size,
+					 memory_order_relaxed) + size;
+	peak = atomic_load_explicit(&site->peak, memory_order_relaxed);
+	while (live > peak &&
+	       ! atomic_compare_exchange_weak(&site->peak, &peak, live))
+		;
+
+	/* Save the call site and the start address. */
+	elem = os_mem_elem(shard, head - 1);
+	elem->site  = site;
+	elem->size  = size;
+	elem->birth = os_mem_now();
+	elem->start = (char *) mem + sizeof(os_mem_t);
+	atomic_store(&elem->state, OS_MEM_USED);
+
+	/* Expose the missing initialization in the diagnostic mode. */
+	if (os_mem_stat.diag)
+		memset(elem->start, OS_MEM_POISON_NEW, size);
+
+	/* Increment the os_malloc counter of the single writer. */
+	c = atomic_load_explicit(&shard->malloc_c, memory_order_relaxed);
+	atomic_store_explicit(&shard->malloc_c, c + 1, memory_order_relaxed);
+
+	/* Save the reference to the element. */
+	mem->shard = shard;
+	mem->elem  = elem;
+
+	return elem->start;
+}
 
-        /* Create a os_malloc table element. */
-        elem = os_mem_elem_get(file, line);
+/**
+ * os_free_ext() - frees the memory space pointed to by ptr, which must have
+ * been returned by a previous call to os_malloc(). The diagnostic mode poisons
+ * and quarantines the buffer.
+ *
+ * @ptr:   start address of the allocated memory.
+ * @file:  matches __FILE__ or NULL.
+ * @line:  matches __LINE__.
+ *
+ * Return:	None.
+ **/
+void os_free_ext(void **ptr, char *file, unsigned long line)
+{
+	os_mem_shard_t *shard;
+	os_mem_site_t *site;
+	os_mem_elem_t *elem;
+	unsigned long long age;
+	os_mem_t *mem;
+	int i, state;
 
-        /* Save the start start address of the allocated memory. */
-        elem->start = mem->ptr.start;
+	/* Entry condition. */
+	OS_TRAP_IF (ptr == NULL || *ptr == NULL);
 
-        /* Save the index of the malloc element. */
-        mem->list_idx = elem->elem_idx;
+	/* Calculate the start of the allocated memory. */
+	mem = (os_mem_t *) ((char *) *ptr - sizeof (os_mem_t));
+
+	/* Get the os_malloc element. */
+	shard = mem->shard;
+	elem  = mem->elem;
+	OS_TRAP_IF(shard == NULL || elem == NULL);
+
+	/* Test and change the element state. */
+	state = OS_MEM_USED;
+	if (elem->start != *ptr ||
+	    ! atomic_compare_exchange_strong(&elem->state, &state,
+					     OS_MEM_QUARANTINED))
+		os_mem_bad_free(elem, *ptr, state, file, line);
+
+	/* Select the logarithmic bucket of the lifetime. */
+	age = os_mem_now() - elem->birth;
+	i = age ? 64 - __builtin_clzll(age) : 0;
+	if (i >= OS_MEM_HIST_LEN)
+		i = OS_MEM_HIST_LEN - 1;
+
+	/* Update the profile of the call site. */
+	site = elem->site;
+	atomic_fetch_sub_explicit(&site->live, elem->size, memory_order_relaxed);
+	atomic_fetch_add_explicit(&site->free_c, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&site->hist[i], 1, memory_order_relaxed);
+
+	/* Increment the free counter. */
+	atomic_fetch_add_explicit(&shard->free_c, 1, memory_order_relaxed);
+
+	/* Poison and quarantine the buffer in the diagnostic mode. */
+	if (os_mem_stat.diag) {
+		elem->free_file = file;
+		elem->free_line = line;
+		memset(elem->start, OS_MEM_POISON, elem->size);
+		os_mem_quarantine(elem);
+	}
+	else {
+		os_mem_release(elem);
+	}
 
-        return mem->ptr.start;
+	/* Reset the pointer. */
+	*ptr = NULL;
 }
 
 /**
@@ -319,22 +732,45 @@ void *os_malloc(size_t size, char *file, unsigned long line)
  **/
 void os_free(void **ptr)
 {
-	os_mem_t  *mem;
-	
-	/* Entry condition. */
-	OS_TRAP_IF (ptr == NULL || *ptr == NULL);
-
-	/* Calculate the start of the allocated memory. */
-        mem = (os_mem_t *) ((char *) *ptr - sizeof (os_mem_t));
-
-        /* Free the list element. */
-        os_mem_elem_put(mem->list_idx, mem->ptr.start);
+	os_free_ext(ptr, NULL, 0);
+}
 
-        /* Free the allocated buffer. */
-        free(mem);
+/**
+ * os_mem_leak_dump() - print the outstanding os_malloc buffers.
+ *
+ * Return:	the number of the outstanding buffers.
+ **/
+int os_mem_leak_dump(void)
+{
+	os_mem_shard_t *shard;
+	os_mem_elem_t *elem;
+	long long now;
+	int i, k, n, count;
+
+	/* Loop over the elements of all shards. */
+	now   = os_mem_now();
+	count = 0;
+	for (shard = atomic_load(&os_mem_stat.shard); shard != NULL;
+	     shard = shard->next) {
+		n = atomic_load(&shard->chunk_n);
+		for (k = 0; k < n; k++) {
+			for (i = 0; i < (OS_MEM_CHUNK << k); i++) {
+				/* Test the element state. */
+				elem = &shard->chunk[k][i];
+				if (atomic_load(&elem->state) != OS_MEM_USED)
+					continue;
+
+				/* Print the call site, size and age. */
+				printf("%s leak: [%s:%lu,size=%zu,age=%lldms]\n",
+				       OS, os_mem_name(elem->site->file),
+				       elem->site->line, elem->size,
+				       (now - elem->birth) / 1000000);
+				count++;
+			}
+		}
+	}
 
-	/* Reset the pointer. */
-	*ptr = NULL;
+	return count;
 }
 
 /**
@@ -346,43 +782,138 @@ void os_free(void **ptr)
  **/
 void os_mem_statistics(os_statistics_t *stat)
 {
-	os_mem_stat_t *p;
+	os_mem_shard_t *shard;
+
+	/* Sum up the counters of the shards. */
+	stat->malloc_c = 0;
+	stat->free_c   = 0;
+	for (shard = atomic_load(&os_mem_stat.shard); shard != NULL;
+	     shard = shard->next) {
+		stat->malloc_c += atomic_load(&shard->malloc_c);
+		stat->free_c   += atomic_load(&shard->free_c);
+	}
+}
+
+/**
+ * os_mem_usage() - provide the capacity and the memory overhead of the
+ * os_malloc tracker.
+ *
+ * @usage:  address of the usage information.
+ *
+ * Return:	None.
+ **/
+void os_mem_usage(os_mem_usage_t *usage)
+{
+	os_mem_shard_t *shard;
+	int k, n;
 
-	/* Get the reference of the os_malloc list. */
-        p = &os_mem_stat;
+	/* Entry condition. */
+	OS_TRAP_IF(usage == NULL);
 
-	/* Enter the critical section. */
-        os_cs_enter(&p->protect);
+	/* Define the fixed costs of an allocation. */
+	os_memset(usage, 0, sizeof(os_mem_usage_t));
+	usage->per_alloc = sizeof(os_mem_t) + sizeof(os_mem_elem_t);
 
-	/* Provide the malloc and free counter. */
-	stat->malloc_c = p->malloc_c;
-	stat->free_c   = p->free_c;
+	/* Loop over the shards. */
+	for (shard = atomic_load(&os_mem_stat.shard); shard != NULL;
+	     shard = shard->next) {
+		/* Sum up the outstanding allocations. */
+		usage->live += atomic_load(&shard->malloc_c) -
+			atomic_load(&shard->free_c);
 
-	/* Leave the critical section. */
-        os_cs_leave(&p->protect);
+		/* Sum up the tracking elements. */
+		n = atomic_load(&shard->chunk_n);
+		for (k = 0; k < n; k++)
+			usage->slots += OS_MEM_CHUNK << k;
+
+		usage->table_bytes += sizeof(os_mem_shard_t);
+	}
+
+	/* Add the memory of the tracking elements. */
+	usage->table_bytes += usage->slots * sizeof(os_mem_elem_t);
+}
+
+/**
+ * os_mem_profile() - provide the allocation profile of a call site.
+ *
+ * @file:   __FILE__ pointer of the os_malloc() call.
+ * @line:   line number of the os_malloc() call.
+ * @stats:  address of the profile.
+ *
+ * Return:	0 or -1, if the call site has not allocated memory.
+ **/
+int os_mem_profile(char *file, unsigned long line, os_mem_site_stats_t *stats)
+{
+	os_mem_site_t *site;
+
+	/* Entry condition. */
+	OS_TRAP_IF(file == NULL || stats == NULL);
+
+	/* Search for the call site. */
+	site = os_mem_site_find(file, line, 0);
+	if (site == NULL)
+		return -1;
+
+	/* Copy the profile. */
+	os_mem_site_copy(site, stats);
+
+	return 0;
+}
+
+/**
+ * os_mem_profile_dump() - print the allocation profiles of all call sites.
+ *
+ * Return:	None.
+ **/
+void os_mem_profile_dump(void)
+{
+	int i;
+
+	/* Loop over the installed call sites. */
+	for (i = 0; i < OS_MEM_SITE_N; i++) {
+		if (atomic_load(&os_mem_stat.site[i].state) == OS_MEM_SITE_READY)
+			os_mem_site_print(&os_mem_stat.site[i]);
+	}
+
+	/* Print the call sites beyond the table capacity. */
+	os_mem_site_print(&os_mem_stat.other);
 }
 
 /**
  * os_mem_init() - initialize the os_malloc list.
  *
+ * @diag:  1, if the released buffers shall be poisoned and quarantined.
+ *
  * Return:	None.
  **/
-void os_mem_init(void)
+void os_mem_init(int diag)
 {
-        os_mem_elem_t *elem;
-        int i;
+	os_mem_stat_t *p;
+	int i, ret;
+
+	/* Get the reference of the os_malloc tracker. */
+	p = &os_mem_stat;
+
+	/* Initialize the mutex for critical section. */
+	os_cs_init(&p->protect);
+
+	/* Create the data key for the shard of a thread. */
+	ret = pthread_key_create(&p->key, os_mem_orphan);
+	OS_TRAP_IF(ret != 0);
 
-        /* Initialize the mutex for critical section. */
-        os_cs_init(&os_mem_stat.protect);
+	/* Reset the shard list and the call site profiles. */
+	atomic_store(&p->shard, NULL);
+	os_memset(p->site, 0, sizeof(p->site));
+	os_memset(&p->other, 0, sizeof(p->other));
 
-        /* Get the reference to the first element. */
-        elem = os_mem_stat.elem;
+	/* Reset the quarantine. */
+	p->diag = diag ? 1 : 0;
+	atomic_store(&p->q_head, 0);
+	for (i = 0; i < OS_MEM_QUARANTINE_N; i++)
+		atomic_store(&p->q_ring[i], NULL);
 
-        /* Run thru the os_malloc list. */
-        for (i = 0; i < OS_MALLOC_LIMIT; i++, elem++) {
-                /* Save the element index. */
-                elem->elem_idx = i;
-        }
+	/* Invalidate the shard caches of the threads. */
+	atomic_fetch_add(&p->gen, 1);
 }
 
 /**
@@ -392,30 +923,51 @@ void os_mem_init(void)
  **/
 void os_mem_exit(void)
 {
+	os_mem_shard_t *shard, *next;
+	os_statistics_t stat;
+	os_mem_elem_t *elem;
 	os_mem_stat_t *p;
-	char **list;
-	int i;
+	int i, ret;
 
 	p = &os_mem_stat;
 
-	/* Enter the critical section. */
-        os_cs_enter(&p->protect);
+	/* Release the quarantined buffers. */
+	for (i = 0; i < OS_MEM_QUARANTINE_N; i++) {
+		elem = atomic_exchange(&p->q_ring[i], NULL);
+		if (elem != NULL)
+			os_mem_evict(elem);
+	}
+
+	/* Test the state of the malloc list and report the leaks. */
+	os_mem_statistics(&stat);
+	if (stat.malloc_c != stat.free_c) {
+		os_mem_leak_dump();
+		OS_TRAP();
+	}
 
-	/* Test the state of the malloc list. */
-	OS_TRAP_IF(p->malloc_c != p->free_c);
+	/* Delete the data key for the shard of a thread. */
+	ret = pthread_key_delete(p->key);
+	OS_TRAP_IF(ret != 0);
 
-	/* Get the reference to the file name list. */
-        list = p->file;
+	/* Enter the critical section. */
+	os_cs_enter(&p->protect);
+
+	/* Release the shards. */
+	for (shard = atomic_load(&p->shard); shard != NULL; shard = next) {
+		next = shard->next;
+		for (i = 0; i < atomic_load(&shard->chunk_n); i++)
+			free(shard->chunk[i]);
 
-	/* Loop thru the file name list. */
-        for (i = 0; i < OS_MALLOC_FILE_LIMIT; i++) {
-		/* Release the file names. */
-		if (list[i] != NULL)
-			free(list[i]);
+		free(shard);
 	}
-	
-        /* Leave the critical section. */
-        os_cs_leave(&p->protect);
+
+	atomic_store(&p->shard, NULL);
+
+	/* Invalidate the shard caches of the threads. */
+	atomic_fetch_add(&p->gen, 1);
+
+	/* Leave the critical section. */
+	os_cs_leave(&p->protect);
 
 	os_cs_destroy(&p->protect);
 }
@@ -9,6 +9,16 @@
 /*============================================================================
   IMPORTED INCLUDE REFERENCES
   ============================================================================*/
+#define _GNU_SOURCE      /* Anonymous memory file: memfd_create(). */
+#include <errno.h>       /* ISO C99 Standard: 7.5 Errors: EAGAIN. */
+#include <limits.h>      /* Limits of the integer types: INT_MAX. */
+#include <time.h>        /* Time types: clock_gettime(). */
+#include <unistd.h>      /* File operations: ftruncate(). */
+#include <sys/mman.h>    /* Map file into memory. */
+#include <sys/eventfd.h> /* Event notification descriptor: eventfd(). */
+#include <sys/syscall.h> /* System call numbers: SYS_futex. */
+#include <linux/futex.h> /* Fast user-space locking: FUTEX_WAIT_PRIVATE. */
+#include <pthread.h>     /* POSIX threads: pthread_self(). */
 #include "os.h"          /* Operating system: OS_MALLOC() */
 #include "os_private.h"  /* Local interfaces of the OS: os_trap_init() */
 
@@ -18,9 +28,25 @@
 /*============================================================================
   LOCAL NAME CONSTANTS DEFINITIONS
   ============================================================================*/
+/* Size of the length header of a framed record. */
+#define OS_MQ_HDR  ((int) sizeof(int))
+
+/* Distance of the producer and consumer indices of the SPSC queue. */
+#define OS_MQ_CACHE_LINE  64
+
+/* Lap bit of the SPSC head and tail, toggled by each wrap-around. */
+#define OS_MQ_LAP  (1 << 30)
+
 /*============================================================================
   MACROS
   ============================================================================*/
+/* Size of a framed record with header and payload, aligned to the header. */
+#define OS_MQ_REC(len_)  (((len_) + 2 * OS_MQ_HDR - 1) & ~(OS_MQ_HDR - 1))
+
+/* Split a SPSC head or tail into the lap bit and the buffer index. */
+#define OS_MQ_LAP_OF(v_)  ((v_) & OS_MQ_LAP)
+#define OS_MQ_IDX(v_)     ((v_) & ~OS_MQ_LAP)
+
 /*============================================================================
   LOCAL TYPE DEFINITIONS
   ============================================================================*/
@@ -28,6 +54,11 @@
  * os_mq_t - buffer queue for the I/O operations.
  *
  * @mutex          protect the critical section of the queue operations.
+ * @flags:         queue mode: OS_MQ_FRAMED, OS_MQ_SPSC, OS_MQ_MIRROR.
+ * @fd:            MIRROR: memory file of the double mapping.
+ * @efd:           EVENT: event descriptor, which counts the added messages.
+ * @seq:           futex word of the waiting threads, changed by each wakeup.
+ * @waiters:       number of the threads in os_mq_wait_readable/writable().
  * @buf:           pointer to the queue memory.
  * @size:          size of the queue buffer.
  * @_1st_idx:      start index of the first queue buffer.
@@ -36,17 +67,42 @@
  * @_2nd_size:     size of the second queue buffer.
  * @lock_idx:      start index of the reseved queue buffer.
  * @lock_size:     size of the reseved queue buffer.
+ * @head:          SPSC: producer index behind the last added message.
+ * @last:          SPSC: end of the valid data, if the head has wrapped.
+ * @tail:          SPSC: consumer index of the next message.
+ * @producer:      SPSC: debug build: owner thread of alloc and add.
+ * @consumer:      SPSC: debug build: owner thread of get and remove.
+ *
+ * The SPSC mode replaces the 1st and 2nd queue buffers with the head, last
+ * and tail indices. The producer owns the reservation, head and last, the
+ * consumer owns the tail. Head and tail carry the lap bit: if the laps differ,
+ * the head has wrapped and the valid data of the tail ends at last. Thus the
+ * producer may restart the empty queue at the start of the buffer.
+ *
+ * The MIRROR mode maps the pages of the queue buffer twice in a row, each
+ * region of up to size bytes behind buf + idx is contiguous. The head and tail
+ * run modulo 2 * size to distinguish the full and the empty queue.
  **/
 typedef struct {
 	pthread_mutex_t  mutex;
+	int    flags;
+	int    fd;
+	int    efd;
+	atomic_int  seq;
+	atomic_int  waiters;
 	char  *buf;
 	int    size;
 	int    _1st_idx;
 	int    _1st_size;
 	int    _2nd_idx;
 	int    _2nd_size;
-	int    lock_idx;
-	int    lock_size;  
+	int    lock_idx __attribute__((aligned(OS_MQ_CACHE_LINE)));
+	int    lock_size;
+	atomic_int  head;
+	atomic_int  last;
+	atomic_int  tail __attribute__((aligned(OS_MQ_CACHE_LINE)));
+	_Atomic(pthread_t)  producer;
+	_Atomic(pthread_t)  consumer;
 } os_mq_t;
 
 /*============================================================================
@@ -55,15 +111,611 @@ typedef struct {
 /*============================================================================
   LOCAL FUNCTION PROTOTYPES
   ============================================================================*/
+static int os_mq_wmem_up(os_mq_t *q);
+
 /**
- * os_mq_remove_up() - remove the message from the unprotected I/O queue.
+ * os_mq_hdr_get() - read the length header of a framed record.
+ *
+ * @rec:  start of the framed record.
+ *
+ * Return:	the size of the payload.
+ **/
+static int os_mq_hdr_get(char *rec)
+{
+	int len;
+
+	/* The records are aligned to the header size. */
+	os_memcpy(&len, sizeof(len), rec, OS_MQ_HDR);
+
+	return len;
+}
+
+/**
+ * os_mq_hdr_set() - write the length header of a framed record.
+ *
+ * @rec:  start of the framed record.
+ * @len:  size of the payload.
+ *
+ * Return:	None.
+ **/
+static void os_mq_hdr_set(char *rec, int len)
+{
+	os_memcpy(rec, OS_MQ_HDR, &len, sizeof(len));
+}
+
+/**
+ * os_mq_owner() - debug build: the first caller owns the producer or consumer
+ * side of the SPSC queue, any other thread is a fatal error.
+ *
+ * @q:      pointer to the I/O queue.
+ * @owner:  pointer to the owner of the producer or consumer side.
+ *
+ * Return:	None.
+ **/
+static void os_mq_owner(os_mq_t *q, _Atomic(pthread_t) *owner)
+{
+#if ! defined(OS_RELEASE)
+	pthread_t self, prev;
+
+	/* The locked queue allows several threads. */
+	if (! (q->flags & OS_MQ_SPSC))
+		return;
+
+	/* Save the first caller or compare it with the current thread. */
+	self = pthread_self();
+	prev = 0;
+	if (! atomic_compare_exchange_strong(owner, &prev, self))
+		OS_TRAP_IF(! pthread_equal(prev, self));
+#endif
+}
+
+/**
+ * os_mq_enter() - enter the critical section of a locked queue.
+ *
+ * @q:  pointer to the I/O queue.
+ *
+ * Return:	None.
+ **/
+static void os_mq_enter(os_mq_t *q)
+{
+	/* The SPSC queue synchronizes with the head and tail indices. */
+	if (! (q->flags & OS_MQ_SPSC))
+		os_cs_enter(&q->mutex);
+}
+
+/**
+ * os_mq_leave() - leave the critical section of a locked queue.
+ *
+ * @q:  pointer to the I/O queue.
+ *
+ * Return:	None.
+ **/
+static void os_mq_leave(os_mq_t *q)
+{
+	/* The SPSC queue synchronizes with the head and tail indices. */
+	if (! (q->flags & OS_MQ_SPSC))
+		os_cs_leave(&q->mutex);
+}
+
+/**
+ * os_mq_notify() - resume the waiting threads after a change of the queue
+ * and signal a new message on the event descriptor.
+ *
+ * @q:      pointer to the I/O queue.
+ * @added:  1, if a message has been added, or 0, if it has been removed.
+ *
+ * Return:	None.
+ **/
+static void os_mq_notify(os_mq_t *q, int added)
+{
+	uint64_t val;
+	long ret;
+
+	/* Order the index update before the test of the waiting threads; the
+	 * waiting threads test the queue after their registration. */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&q->waiters, memory_order_relaxed) > 0) {
+		/* Change the futex word and resume all waiting threads. */
+		atomic_fetch_add(&q->seq, 1);
+		ret = syscall(SYS_futex, (int *) &q->seq, FUTEX_WAKE_PRIVATE,
+			      INT_MAX, NULL, NULL, 0);
+		OS_TRAP_IF(ret < 0);
+	}
+
+	/* Test the event descriptor. */
+	if (! added || q->efd < 0)
+		return;
+
+	/* Count the new message. */
+	val = 1;
+	ret = write(q->efd, &val, sizeof(val));
+	OS_TRAP_IF(ret != sizeof(val));
+}
+
+/**
+ * os_mq_wait() - sleep until the queue condition is true or the waiting time
+ * expires.
+ *
+ * @q:     pointer to the I/O queue.
+ * @cond:  test function of the queue condition.
+ * @size:  argument of the test function.
+ * @ms:    max. waiting time in milliseconds, or -1 without limit.
+ *
+ * Return:	0, if the condition is true, or -1 after the timeout.
+ **/
+static int os_mq_wait(os_mq_t *q, int (*cond)(os_mq_t *q, int size), int size,
+		      int ms)
+{
+	struct timespec end, now, rel;
+	long ret;
+	int seq, rv;
+
+	/* Calculate the absolute end of the waiting time. */
+	if (ms >= 0) {
+		ret = clock_gettime(CLOCK_MONOTONIC, &end);
+		OS_TRAP_IF(ret != 0);
+		end.tv_sec  += ms / 1000;
+		end.tv_nsec += (long) (ms % 1000) * 1000000;
+		if (end.tv_nsec >= 1000000000) {
+			end.tv_sec++;
+			end.tv_nsec -= 1000000000;
+		}
+	}
+
+	/* Register the waiting thread before the test of the condition. */
+	atomic_fetch_add(&q->waiters, 1);
+
+	for (;;) {
+		/* Save the futex word and test the condition. */
+		seq = atomic_load(&q->seq);
+		atomic_thread_fence(memory_order_seq_cst);
+		rv = 0;
+		if (cond(q, size))
+			break;
+
+		/* Calculate the remaining waiting time. */
+		if (ms >= 0) {
+			ret = clock_gettime(CLOCK_MONOTONIC, &now);
+			OS_TRAP_IF(ret != 0);
+			rel.tv_sec  = end.tv_sec  - now.tv_sec;
+			rel.tv_nsec = end.tv_nsec - now.tv_nsec;
+			if (rel.tv_nsec < 0) {
+				rel.tv_sec--;
+				rel.tv_nsec += 1000000000;
+			}
+
+			/* Test the expiry of the waiting time. */
+			rv = -1;
+			if (rel.tv_sec < 0)
+				break;
+		}
+
+		/* Sleep, as long as the queue is unchanged. */
+		ret = syscall(SYS_futex, (int *) &q->seq, FUTEX_WAIT_PRIVATE,
+			      seq, ms >= 0 ? &rel : NULL, NULL, 0);
+		OS_TRAP_IF(ret != 0 && errno != EAGAIN && errno != EINTR &&
+			   errno != ETIMEDOUT);
+	}
+
+	/* Deregister the waiting thread. */
+	atomic_fetch_sub(&q->waiters, 1);
+
+	return rv;
+}
+
+/**
+ * os_mq_readable() - test the presence of a message.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  not used.
+ *
+ * Return:	1, if a message is present, otherwise 0.
+ **/
+static int os_mq_readable(os_mq_t *q, int size)
+{
+	return os_mq_rmem(q) > 0;
+}
+
+/**
+ * os_mq_writable() - test the free space for a message. A queue buffer
+ * reserved by another producer is not writable.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the message.
+ *
+ * Return:	1, if the message fits, otherwise 0.
+ **/
+static int os_mq_writable(os_mq_t *q, int size)
+{
+	int rv;
+
+	/* Enter the critical section. */
+	os_mq_enter(q);
+
+	/* Test the reservation and the free space. */
+	rv = q->lock_size == 0 && os_mq_wmem_up(q) >= size;
+
+	/* Leave the critical section. */
+	os_mq_leave(q);
+
+	return rv;
+}
+
+/**
+ * os_mq_spsc_read_idx() - consumer: get the start and the end of the
+ * contiguous message buffers and follow the wrap-around of the head.
+ *
+ * @q:    pointer to the I/O queue.
+ * @end:  return the end of the readable data.
+ *
+ * Return:	the start index of the next message.
+ **/
+static int os_mq_spsc_read_idx(os_mq_t *q, int *end)
+{
+	int head, last, tail;
+
+	/* Acquire the messages of the producer. */
+	head = atomic_load_explicit(&q->head, memory_order_acquire);
+	last = atomic_load_explicit(&q->last, memory_order_acquire);
+	tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+	/* Test the end of the valid data in front of the wrapped head. */
+	if (OS_MQ_LAP_OF(head) != OS_MQ_LAP_OF(tail) &&
+	    OS_MQ_IDX(tail) == last) {
+		/* Continue at the start of the queue buffer in the lap of the
+		 * head. */
+		tail = OS_MQ_LAP_OF(head);
+		atomic_store_explicit(&q->tail, tail, memory_order_release);
+	}
+
+	/* The valid data ends at the last index, if the head has wrapped. */
+	if (OS_MQ_LAP_OF(head) != OS_MQ_LAP_OF(tail))
+		*end = last;
+	else
+		*end = OS_MQ_IDX(head);
+
+	return OS_MQ_IDX(tail);
+}
+
+/**
+ * os_mq_spsc_remove() - consumer: wait-free removal of the message.
  *
  * @q:     pointer to the I/O queue.
  * @size:  size of the consumed message.
  *
  * Return:	None.
  **/
-static void os_mq_remove_up(os_mq_t *q, int size)
+static void os_mq_spsc_remove(os_mq_t *q, int size)
+{
+	int tail, end, lap;
+
+	/* Get the contiguous message buffers. */
+	tail = os_mq_spsc_read_idx(q, &end);
+	OS_TRAP_IF(end - tail < size);
+
+	/* Release the message buffer to the producer. */
+	lap = OS_MQ_LAP_OF(atomic_load_explicit(&q->tail, memory_order_relaxed));
+	atomic_store_explicit(&q->tail, lap | (tail + size),
+			      memory_order_release);
+}
+
+/**
+ * os_mq_spsc_get() - consumer: wait-free access to the next message buffers.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  return the size of the contiguous message buffers.
+ *
+ * Return:	the pointer to the message buffer.
+ **/
+static char *os_mq_spsc_get(os_mq_t *q, int *size)
+{
+	int tail, end;
+
+	/* Get the contiguous message buffers. */
+	tail = os_mq_spsc_read_idx(q, &end);
+	if (end - tail < 1)
+		return NULL;
+
+	/* Save the size of the message buffers. */
+	*size = end - tail;
+
+	return q->buf + tail;
+}
+
+/**
+ * os_mq_spsc_add() - producer: wait-free release of the filled message buffer.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the message buffer.
+ *
+ * Return:	None.
+ **/
+static void os_mq_spsc_add(os_mq_t *q, int size)
+{
+	int head, lap;
+
+	/* Entry condition. */
+	OS_TRAP_IF(size < 1 || size > q->lock_size);
+
+	/* Get the producer index. */
+	head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	lap  = OS_MQ_LAP_OF(head);
+
+	/* Test the wrap-around of the reservation. */
+	if (q->lock_idx != OS_MQ_IDX(head)) {
+		/* Save the end of the valid data in front of the head and
+		 * start the next lap. */
+		atomic_store_explicit(&q->last, OS_MQ_IDX(head),
+				      memory_order_release);
+		lap ^= OS_MQ_LAP;
+	}
+
+	/* Publish the message to the consumer. */
+	atomic_store_explicit(&q->head, lap | (q->lock_idx + size),
+			      memory_order_release);
+
+	/* Unlock the queue buffer. */
+	q->lock_idx  = 0;
+	q->lock_size = 0;
+}
+
+/**
+ * os_mq_spsc_alloc() - producer: wait-free reservation of a queue buffer. The
+ * head restarts at the start of the queue buffer, if the message does not fit
+ * behind it and the consumer has released enough space in front of it or the
+ * queue is empty.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the wanted message buffer.
+ *
+ * Return:	pointer to the message buffer.
+ **/
+static char *os_mq_spsc_alloc(os_mq_t *q, int size)
+{
+	int head, tail, start;
+
+	/* Acquire the released buffers of the consumer. */
+	head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+	/* Test the state of the head. */
+	if (OS_MQ_LAP_OF(head) != OS_MQ_LAP_OF(tail)) {
+		/* The head has wrapped, it shall not reach the tail. */
+		if (OS_MQ_IDX(head) + size >= OS_MQ_IDX(tail))
+			return NULL;
+		start = OS_MQ_IDX(head);
+	}
+	else if (OS_MQ_IDX(head) + size <= q->size) {
+		/* Reserve the message buffer behind the head. */
+		start = OS_MQ_IDX(head);
+	}
+	else {
+		/* Wrap around, the head shall not reach the tail of a filled
+		 * queue. */
+		if (size > q->size ||
+		    (head != tail && size >= OS_MQ_IDX(tail)))
+			return NULL;
+		start = 0;
+	}
+
+	/* Save the reservation of the producer. */
+	q->lock_idx  = start;
+	q->lock_size = size;
+
+	return q->buf + start;
+}
+
+/**
+ * os_mq_spsc_wmem() - producer: calculate the largest contiguous message
+ * buffer.
+ *
+ * @q:  pointer to the I/O queue.
+ *
+ * Return:	the free queue buffer space.
+ **/
+static int os_mq_spsc_wmem(os_mq_t *q)
+{
+	int head, tail, size;
+
+	/* Acquire the released buffers of the consumer. */
+	head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+	/* The head has wrapped, it shall not reach the tail. */
+	if (OS_MQ_LAP_OF(head) != OS_MQ_LAP_OF(tail))
+		return OS_MQ_IDX(tail) - OS_MQ_IDX(head) - 1;
+
+	/* The head of the empty queue restarts at the start of the buffer. */
+	if (head == tail)
+		return q->size;
+
+	/* Compare the space behind the head and in front of the tail. */
+	size = q->size - OS_MQ_IDX(head);
+	if (size < OS_MQ_IDX(tail) - 1)
+		size = OS_MQ_IDX(tail) - 1;
+
+	return size;
+}
+
+/**
+ * os_mq_spsc_rmem() - calculate the fill level of the queue buffer.
+ *
+ * @q:  pointer to the I/O queue.
+ *
+ * Return:	the fill level of the queue buffer.
+ **/
+static int os_mq_spsc_rmem(os_mq_t *q)
+{
+	int head, last, tail;
+
+	/* Take a snapshot of the indices. */
+	head = atomic_load_explicit(&q->head, memory_order_acquire);
+	last = atomic_load_explicit(&q->last, memory_order_acquire);
+	tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+	/* Test the wrap-around of the head. */
+	if (OS_MQ_LAP_OF(head) == OS_MQ_LAP_OF(tail))
+		return OS_MQ_IDX(head) - OS_MQ_IDX(tail);
+
+	return last - OS_MQ_IDX(tail) + OS_MQ_IDX(head);
+}
+
+/**
+ * os_mq_mirror_fill() - calculate the fill level of the mirrored queue.
+ *
+ * @q:     pointer to the I/O queue.
+ * @head:  return the producer index.
+ * @tail:  return the consumer index.
+ *
+ * Return:	the fill level of the queue buffer.
+ **/
+static int os_mq_mirror_fill(os_mq_t *q, int *head, int *tail)
+{
+	/* Acquire the messages and the released buffers. */
+	*head = atomic_load_explicit(&q->head, memory_order_acquire);
+	*tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+	/* The indices run modulo 2 * size. */
+	return (*head - *tail + 2 * q->size) % (2 * q->size);
+}
+
+/**
+ * os_mq_mirror_remove() - consumer: remove the message from the mirrored
+ * queue.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the consumed message.
+ *
+ * Return:	None.
+ **/
+static void os_mq_mirror_remove(os_mq_t *q, int size)
+{
+	int head, tail;
+
+	/* Test the fill level of the queue buffer. */
+	OS_TRAP_IF(os_mq_mirror_fill(q, &head, &tail) < size);
+
+	/* Release the message buffer to the producer. */
+	atomic_store_explicit(&q->tail, (tail + size) % (2 * q->size),
+			      memory_order_release);
+}
+
+/**
+ * os_mq_mirror_get() - consumer: access to the contiguous message buffers.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  return the fill level of the queue buffer.
+ *
+ * Return:	the pointer to the message buffer.
+ **/
+static char *os_mq_mirror_get(os_mq_t *q, int *size)
+{
+	int head, tail, fill;
+
+	/* Test the fill level of the queue buffer. */
+	fill = os_mq_mirror_fill(q, &head, &tail);
+	if (fill < 1)
+		return NULL;
+
+	/* The messages are contiguous in the second mapping. */
+	*size = fill;
+
+	return q->buf + tail % q->size;
+}
+
+/**
+ * os_mq_mirror_add() - producer: release the filled message buffer.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the message buffer.
+ *
+ * Return:	None.
+ **/
+static void os_mq_mirror_add(os_mq_t *q, int size)
+{
+	int head;
+
+	/* Entry condition. */
+	OS_TRAP_IF(size < 1 || size > q->lock_size);
+
+	/* Publish the message to the consumer. */
+	head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	atomic_store_explicit(&q->head, (head + size) % (2 * q->size),
+			      memory_order_release);
+
+	/* Unlock the queue buffer. */
+	q->lock_idx  = 0;
+	q->lock_size = 0;
+}
+
+/**
+ * os_mq_mirror_alloc() - producer: reserve a contiguous queue buffer.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the wanted message buffer.
+ *
+ * Return:	pointer to the message buffer.
+ **/
+static char *os_mq_mirror_alloc(os_mq_t *q, int size)
+{
+	int head, tail;
+
+	/* Compare the free space and the wanted memory. */
+	if (size > q->size - os_mq_mirror_fill(q, &head, &tail))
+		return NULL;
+
+	/* Save the reservation of the producer. */
+	q->lock_idx  = head % q->size;
+	q->lock_size = size;
+
+	return q->buf + q->lock_idx;
+}
+
+/**
+ * os_mq_mirror_map() - map the pages of a memory file twice in a row.
+ *
+ * @q:  pointer to the I/O queue.
+ *
+ * Return:	the start of the first mapping.
+ **/
+static char *os_mq_mirror_map(os_mq_t *q)
+{
+	char *buf, *p;
+	int rv;
+
+	/* Create the memory file with the size of the queue buffer. */
+	q->fd = memfd_create("os_mq", MFD_CLOEXEC);
+	OS_TRAP_IF(q->fd == -1);
+
+	rv = ftruncate(q->fd, q->size);
+	OS_TRAP_IF(rv != 0);
+
+	/* Reserve the address space of both mappings. */
+	buf = mmap(NULL, 2 * q->size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+		   -1, 0);
+	OS_TRAP_IF(buf == MAP_FAILED);
+
+	/* Map the memory file into the first and the second half. */
+	p = mmap(buf, q->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+		 q->fd, 0);
+	OS_TRAP_IF(p != buf);
+
+	p = mmap(buf + q->size, q->size, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_FIXED, q->fd, 0);
+	OS_TRAP_IF(p != buf + q->size);
+
+	return buf;
+}
+
+/**
+ * os_mq_bip_remove() - remove the message from the 1st queue buffer.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the consumed message.
+ *
+ * Return:	None.
+ **/
+static void os_mq_bip_remove(os_mq_t *q, int size)
 {
 	/* Test the fill level of the queue buffer. */
 	OS_TRAP_IF ((q->_1st_size + q->_2nd_size) < size);
@@ -87,6 +739,31 @@ static void os_mq_remove_up(os_mq_t *q, int size)
         }
 }
 
+/**
+ * os_mq_remove_up() - remove the message from the unprotected I/O queue.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the consumed message.
+ *
+ * Return:	None.
+ **/
+static void os_mq_remove_up(os_mq_t *q, int size)
+{
+	/* Test the consumer thread. */
+	os_mq_owner(q, &q->consumer);
+
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_MIRROR)
+		os_mq_mirror_remove(q, size);
+	else if (q->flags & OS_MQ_SPSC)
+		os_mq_spsc_remove(q, size);
+	else
+		os_mq_bip_remove(q, size);
+
+	/* Resume the threads waiting for space. */
+	os_mq_notify(q, 0);
+}
+
 /**
  * os_mq_get_up() - get the pointer to the next unprotected message bufffer.
  *
@@ -97,6 +774,15 @@ static void os_mq_remove_up(os_mq_t *q, int size)
  **/
 static char *os_mq_get_up(os_mq_t *q, int *size)
 {
+	/* Test the consumer thread. */
+	os_mq_owner(q, &q->consumer);
+
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_MIRROR)
+		return os_mq_mirror_get(q, size);
+	else if (q->flags & OS_MQ_SPSC)
+		return os_mq_spsc_get(q, size);
+
 	/* Test the fill level of the first mesage queue buffer. */
 	if (q->_1st_size < 1)
 		return NULL;
@@ -109,15 +795,15 @@ static char *os_mq_get_up(os_mq_t *q, int *size)
 }
 
 /**
- * os_mq_add_up() - unprotected release of the filled message buffer in the 1st
- * or 2nd queue buffer.
+ * os_mq_bip_add() - release of the filled message buffer in the 1st or 2nd
+ * queue buffer.
  *
  * @q:     pointer to the I/O queue.
  * @size:  size of the message buffer.
  *
  * Return:	None.
  **/
-static void os_mq_add_up(os_mq_t *q, int size)
+static void os_mq_bip_add(os_mq_t *q, int size)
 {
 	/* Entry condition. */
 	OS_TRAP_IF(size < 1 || size > q->lock_size);
@@ -149,6 +835,31 @@ static void os_mq_add_up(os_mq_t *q, int size)
 	q->lock_size = 0;
 }
 
+/**
+ * os_mq_add_up() - unprotected release of the filled message buffer.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  size of the message buffer.
+ *
+ * Return:	None.
+ **/
+static void os_mq_add_up(os_mq_t *q, int size)
+{
+	/* Test the producer thread. */
+	os_mq_owner(q, &q->producer);
+
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_MIRROR)
+		os_mq_mirror_add(q, size);
+	else if (q->flags & OS_MQ_SPSC)
+		os_mq_spsc_add(q, size);
+	else
+		os_mq_bip_add(q, size);
+
+	/* Resume the threads waiting for messages. */
+	os_mq_notify(q, 1);
+}
+
 /**
  * os_mq_alloc_up() - reserve a unprotected queue buffer.
  *
@@ -163,6 +874,15 @@ static char *os_mq_alloc_up(os_mq_t *q, int size)
 	
 	/* Entry condition. */
 	OS_TRAP_IF(size < 1 || q->lock_size > 0);
+
+	/* Test the producer thread. */
+	os_mq_owner(q, &q->producer);
+
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_MIRROR)
+		return os_mq_mirror_alloc(q, size);
+	else if (q->flags & OS_MQ_SPSC)
+		return os_mq_spsc_alloc(q, size);
 	
         /* Test the state of the second queue buffer. */
         if (q->_2nd_size > 0) {
@@ -182,12 +902,12 @@ static char *os_mq_alloc_up(os_mq_t *q, int size)
 		/* Calculate the free space of the first queue buffer. */
 		free = q->size - q->_1st_idx - q->_1st_size;
 		
-		/* Compare the gotten and wanted memory. */
-		if (free < 1 || size > free)
-			return NULL;
-		
 		/* Test the state of the first queue buffer. */
 		if (free >= q->_1st_idx) {
+			/* Compare the gotten and wanted memory. */
+			if (free < 1 || size > free)
+				return NULL;
+		
 			/* Reserve the message buffer from the first queue. */
 			q->lock_idx  = q->_1st_idx + q->_1st_size;
 			q->lock_size = size;
@@ -196,6 +916,11 @@ static char *os_mq_alloc_up(os_mq_t *q, int size)
 		else {
 			/* Switch to the second queue buffer: free < 1st_index */
 
+			/* Compare the free space in front of the first queue
+			 * buffer and the wanted memory. */
+			if (size > q->_1st_idx)
+				return NULL;
+
 			/* Reserve the message buffer from the second queue. */
 			q->lock_idx  = 0;
 			q->lock_size = size;
@@ -204,9 +929,158 @@ static char *os_mq_alloc_up(os_mq_t *q, int size)
         }
 }
 
+/**
+ * os_mq_msg_up() - decode the unprotected message at the start of the
+ * contiguous message buffers.
+ *
+ * @q:         pointer to the I/O queue.
+ * @rec:       start of the message.
+ * @avail:     size of the contiguous message buffers.
+ * @size:      return the size of the message.
+ * @rec_size:  return the size of the message in the queue buffer.
+ *
+ * Return:	the pointer to the message.
+ **/
+static char *os_mq_msg_up(os_mq_t *q, char *rec, int avail, int *size,
+			  int *rec_size)
+{
+	char *end;
+
+	/* Read the length header of the framed record. */
+	if (q->flags & OS_MQ_FRAMED) {
+		*size     = os_mq_hdr_get(rec);
+		*rec_size = OS_MQ_REC(*size);
+		OS_TRAP_IF(*size < 1 || *rec_size > avail);
+		return rec + OS_MQ_HDR;
+	}
+
+	/* Search for the end of the queue element. */
+	end = os_memchr(rec, rec + avail, '#', avail);
+	OS_TRAP_IF(end == NULL);
+
+	/* Calculate the lenght of the queue element. */
+	end++;
+	*size = *rec_size = end - rec;
+	OS_TRAP_IF(*size < 2);
+
+	/* Replace the queue element delimter with EOS. */
+	rec[*size - 1] = '\0';
+
+	return rec;
+}
+
+/**
+ * os_mq_write_up() - unprotected copy of a message to the I/O queue.
+ *
+ * @q:      pointer to the I/O queue.
+ * @buf:    pointer to the queue element.
+ * @count:  size of the queue element.
+ *
+ * Return:	1, if buf has been added, otherwise 0.
+ **/
+static int os_mq_write_up(os_mq_t *q, char *buf, int count)
+{
+	char *dest;
+
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_FRAMED) {
+		/* Entry condition. */
+		OS_TRAP_IF(count < 1 || q->size < OS_MQ_REC(count));
+
+		/* Allocate the framed record. */
+		dest = os_mq_alloc_up(q, OS_MQ_REC(count));
+		if (dest == NULL)
+			return 0;
+
+		/* Save the length header and the binary payload. */
+		os_mq_hdr_set(dest, count);
+		os_memcpy(dest + OS_MQ_HDR, count, buf, count);
+
+		/* Release the framed record. */
+		os_mq_add_up(q, OS_MQ_REC(count));
+		return 1;
+	}
+
+	/* Entry condition. */
+	OS_TRAP_IF(q->size < count);
+	
+	/* Allocate a message buffer. */
+	dest = os_mq_alloc_up(q, count);
+	if (dest == NULL)
+		return 0;
+	
+	/* Replace end of string with the message delimiter. */
+	buf[count - 1] = '#';
+
+	/* Save the message. */
+	os_memcpy(dest, count, buf, count);
+	
+	/* Release the message buffer. */
+	os_mq_add_up(q, count);
+	
+	return 1;
+}
+
 /*============================================================================
   LOCAL FUNCTIONS
   ============================================================================*/
+/**
+ * os_mq_frame() - substract the length header and the alignment of a framed
+ * record from the free queue buffer space.
+ *
+ * @q:     pointer to the I/O queue.
+ * @size:  free queue buffer space.
+ *
+ * Return:	the max. size of the message.
+ **/
+static int os_mq_frame(os_mq_t *q, int size)
+{
+	/* Test the queue mode. */
+	if (! (q->flags & OS_MQ_FRAMED))
+		return size;
+
+	/* Substract the length header and the alignment of a framed record. */
+	size &= ~(OS_MQ_HDR - 1);
+	return size > OS_MQ_HDR ? size - OS_MQ_HDR : 0;
+}
+
+/**
+ * os_mq_wmem_up() - get the size of the largest unprotected message buffer.
+ *
+ * @q:  pointer to the I/O queue.
+ *
+ * Return:	the free queue buffer space.
+ **/
+static int os_mq_wmem_up(os_mq_t *q)
+{
+	int size, head, tail;
+
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_MIRROR) {
+		/* The whole free space is contiguous. */
+		size = q->size - os_mq_mirror_fill(q, &head, &tail);
+	}
+	else if (q->flags & OS_MQ_SPSC) {
+		/* Calculate the largest contiguous message buffer. */
+		size = os_mq_spsc_wmem(q);
+	}
+        else if (q->_2nd_size > 0) {
+		/* Calculate the free space of the second queue buffer. */
+		size = q->_1st_idx - q->_2nd_idx - q->_2nd_size;
+        }
+        else {
+		/* Calculate the free space of the first queue buffer. */
+		size = q->size - q->_1st_idx - q->_1st_size;
+
+		/* Consider the free space in front of the first queue
+		 * buffer. */
+		if (size < q->_1st_idx)
+			size = q->_1st_idx;
+        }
+
+	return os_mq_frame(q, size);
+}
+
 /*============================================================================
   EXPORTED FUNCTIONS
   ============================================================================*/
@@ -220,7 +1094,7 @@ static char *os_mq_alloc_up(os_mq_t *q, int size)
 int os_mq_rmem(void *mq)
 {	
 	os_mq_t *q;
-	int size;
+	int size, head, tail;
 	
 	/* Entry condition. */
 	OS_TRAP_IF(mq == NULL);
@@ -229,13 +1103,18 @@ int os_mq_rmem(void *mq)
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 
 	/* Calculate the fill level of the queue buffer. */
-	size = q->_1st_size + q->_2nd_size;
+	if (q->flags & OS_MQ_MIRROR)
+		size = os_mq_mirror_fill(q, &head, &tail);
+	else if (q->flags & OS_MQ_SPSC)
+		size = os_mq_spsc_rmem(q);
+	else
+		size = q->_1st_size + q->_2nd_size;
 		
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 
 	return size;
 }
@@ -259,23 +1138,16 @@ int os_mq_wmem(void *mq)
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 
 	/* Entry condition. */
 	OS_TRAP_IF(q->lock_size > 0);
 	
-        /* Test the state of the second queue buffer. */
-        if (q->_2nd_size > 0) {
-		/* Calculate the free space of the second queue buffer. */
-		size = q->_1st_idx - q->_2nd_idx - q->_2nd_size;
-        }
-        else {
-		/* Calculate the free space of the first queue buffer. */
-		size = q->size - q->_1st_idx - q->_1st_size;
-        }
+	/* Calculate the largest message buffer. */
+	size = os_mq_wmem_up(q);
 	
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 
 	return size;
 }
@@ -293,20 +1165,32 @@ void os_mq_add(void *mq, int size)
 	os_mq_t *q;
 
 	/* Entry condition. */
-	OS_TRAP_IF(mq == NULL || size < 2);
+	OS_TRAP_IF(mq == NULL || size < 1);
 	
 	/* Decode the reference to the queue. */
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 	
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_FRAMED) {
+		/* Complete the reserved framed record. */
+		OS_TRAP_IF(q->lock_size < OS_MQ_REC(size));
+		os_mq_hdr_set(q->buf + q->lock_idx, size);
+		size = OS_MQ_REC(size);
+	}
+	else {
+		/* The message contains at least one character and delimiter. */
+		OS_TRAP_IF(size < 2);
+	}
+
 	/* Unprotected release of the filled message buffer in the 1st or 2nd
 	 * queue buffer. */
 	os_mq_add_up(q, size);
 
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 }
 
 /**
@@ -327,13 +1211,13 @@ void os_mq_free(void *mq)
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 
 	/* Unlock the queue buffer. */
 	q->lock_size = 0;
 	
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 }
 
 /**
@@ -350,19 +1234,29 @@ char *os_mq_alloc(void *mq, int size)
 	char *buf;
 
 	/* Entry condition. */
-	OS_TRAP_IF(mq == NULL || size < 2);
+	OS_TRAP_IF(mq == NULL || size < 1);
 	
 	/* Decode the reference to the queue. */
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 	
-	/* Allocate a message buffer. */
-	buf = os_mq_alloc_up(q, size);
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_FRAMED) {
+		/* Reserve the framed record behind its length header. */
+		buf = os_mq_alloc_up(q, OS_MQ_REC(size));
+		if (buf != NULL)
+			buf += OS_MQ_HDR;
+	}
+	else {
+		/* Allocate a message buffer. */
+		OS_TRAP_IF(size < 2);
+		buf = os_mq_alloc_up(q, size);
+	}
 
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 
 	return buf;
 }
@@ -378,21 +1272,35 @@ char *os_mq_alloc(void *mq, int size)
 void os_mq_remove(void *mq, int size)
 {
 	os_mq_t *q;
+	char *rec;
+	int n;
 
 	/* Entry condition. */
-	OS_TRAP_IF(mq == NULL || size < 2);
+	OS_TRAP_IF(mq == NULL || size < 1);
 	
 	/* Decode the reference to the queue. */
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 	
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_FRAMED) {
+		/* Compare the size with the length header of the first record. */
+		rec = os_mq_get_up(q, &n);
+		OS_TRAP_IF(rec == NULL || os_mq_hdr_get(rec) != size);
+		size = OS_MQ_REC(size);
+	}
+	else {
+		/* The message contains at least one character and delimiter. */
+		OS_TRAP_IF(size < 2);
+	}
+
 	/* Remove the message from the I/O queue. */
 	os_mq_remove_up(q, size);
 
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 }
 
 /**
@@ -406,7 +1314,8 @@ void os_mq_remove(void *mq, int size)
 char *os_mq_get(void *mq, int *size)
 {
 	os_mq_t *q;
-	char *start, *end;
+	char *start;
+	int n;
 
 	/* Entry condition. */
 	OS_TRAP_IF(mq == NULL || size == NULL);
@@ -415,29 +1324,20 @@ char *os_mq_get(void *mq, int *size)
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 	
 	/* Get the pointer to the next message. */
 	*size = 0;
         start = os_mq_get_up(q, size);
 	if (start == NULL)
 		goto l_end;
-	
-	/* Search for the end of the queue element. */
-	end = os_memchr(start, start + *size, '#', *size);
-	OS_TRAP_IF(end == NULL);
-
-	/* Calculate the lenght of the queue element. */
-	end++;
-	*size = end - start;
-	OS_TRAP_IF(*size < 2);
 
-	/* Replace the queue element delimter with EOS. */
-	start[*size - 1] = '\0';
+	/* Decode the first message. */
+	start = os_mq_msg_up(q, start, *size, size, &n);
 
 l_end:
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 
 	return start;
 }
@@ -456,7 +1356,6 @@ int os_mq_write(void *mq, char *buf, int count)
 {
 	os_mq_t *q;
 	int rv;
-	char *dest;
 
 	/* Entry condition. */
 	OS_TRAP_IF(mq == NULL);
@@ -465,36 +1364,138 @@ int os_mq_write(void *mq, char *buf, int count)
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 
-	/* Entry condition. */
-	OS_TRAP_IF(q->size < count);
+	/* Copy the message to the queue. */
+	rv = os_mq_write_up(q, buf, count);
 
-	/* Initialize the return value. */
-	rv = 0;
+	/* Leave the critical section. */
+	os_mq_leave(q);
+
+	return rv;
+}
+
+/**
+ * os_mq_write_batch() - write a burst of messages to an I/O queue in one
+ * critical section.
+ *
+ * @mq:   generic pointer to the I/O queue.
+ * @iov:  list of the messages.
+ * @n:    number of the messages.
+ *
+ * Return:	the number of the added messages, they are added in order until
+ *              the first message does not fit.
+ **/
+int os_mq_write_batch(void *mq, os_mq_iov_t *iov, int n)
+{
+	os_mq_t *q;
+	int i;
+
+	/* Entry condition. */
+	OS_TRAP_IF(mq == NULL || iov == NULL || n < 0);
 	
-	/* Allocate a message buffer. */
-	dest = os_mq_alloc_up(q, count);
-	if (dest == NULL)
-		goto l_end;
+	/* Decode the reference to the queue. */
+	q = mq;
 	
-	/* Replace end of string with the message delimiter. */
-	buf[count - 1] = '#';
+	/* Enter the critical section. */
+	os_mq_enter(q);
 
-	/* Save the message. */
-	os_memcpy(dest, count, buf, count);
+	/* Copy the messages to the queue. */
+	for (i = 0; i < n; i++) {
+		if (! os_mq_write_up(q, iov[i].buf, iov[i].size))
+			break;
+	}
+
+	/* Leave the critical section. */
+	os_mq_leave(q);
+
+	return i;
+}
+
+/**
+ * os_mq_read_batch() - get the pointers to a burst of messages without copy.
+ * The messages are contiguous in the queue buffer and shall be released with
+ * os_mq_remove_batch(), the size of a '#' delimited message includes EOS.
+ *
+ * @mq:   generic pointer to the I/O queue.
+ * @iov:  return the list of the messages.
+ * @n:    max. number of the messages.
+ *
+ * Return:	the number of the messages in iov.
+ **/
+int os_mq_read_batch(void *mq, os_mq_iov_t *iov, int n)
+{
+	os_mq_t *q;
+	char *rec;
+	int i, avail, rec_size;
+
+	/* Entry condition. */
+	OS_TRAP_IF(mq == NULL || iov == NULL || n < 0);
 	
-	/* Release the message buffer. */
-	os_mq_add_up(q, count);
+	/* Decode the reference to the queue. */
+	q = mq;
 	
-	/* Update the return value. */
-	rv = 1;
+	/* Enter the critical section. */
+	os_mq_enter(q);
+
+	/* Get the contiguous message buffers. */
+	avail = 0;
+	rec   = os_mq_get_up(q, &avail);
+
+	/* Decode the messages up to the end of the contiguous buffers. */
+	for (i = 0; i < n && rec != NULL && avail > 0; i++) {
+		iov[i].buf = os_mq_msg_up(q, rec, avail, &iov[i].size,
+					  &rec_size);
+		rec   += rec_size;
+		avail -= rec_size;
+	}
 
-l_end:
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 
-	return rv;
+	return i;
+}
+
+/**
+ * os_mq_remove_batch() - remove the messages of os_mq_read_batch() from the
+ * I/O queue.
+ *
+ * @mq:   generic pointer to the I/O queue.
+ * @iov:  list of the messages.
+ * @n:    number of the messages.
+ *
+ * Return:	None.
+ **/
+void os_mq_remove_batch(void *mq, os_mq_iov_t *iov, int n)
+{
+	os_mq_t *q;
+	int i, size;
+
+	/* Entry condition. */
+	OS_TRAP_IF(mq == NULL || iov == NULL || n < 0);
+	
+	/* Decode the reference to the queue. */
+	q = mq;
+
+	/* Sum up the size of the messages in the queue buffer. */
+	for (i = size = 0; i < n; i++) {
+		OS_TRAP_IF(iov[i].size < 1);
+		size += q->flags & OS_MQ_FRAMED ?
+			OS_MQ_REC(iov[i].size) : iov[i].size;
+	}
+
+	/* Test the number of the messages. */
+	if (size < 1)
+		return;
+	
+	/* Enter the critical section. */
+	os_mq_enter(q);
+
+	/* Remove the messages from the I/O queue. */
+	os_mq_remove_up(q, size);
+
+	/* Leave the critical section. */
+	os_mq_leave(q);
 }
 
 /**
@@ -520,7 +1521,7 @@ int os_mq_read(void *mq, char *buf, int count)
 	q = mq;
 	
 	/* Enter the critical section. */
-	os_cs_enter(&q->mutex);
+	os_mq_enter(q);
 
 	/* Initialize the return value. */
 	rv = 0;
@@ -531,6 +1532,19 @@ int os_mq_read(void *mq, char *buf, int count)
 	if (src == NULL)
 		goto l_end;
 
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_FRAMED) {
+		/* Read the length header in constant time. */
+		size = os_mq_hdr_get(src);
+		OS_TRAP_IF(size < 1 || size > count);
+
+		/* Copy the binary payload and remove the framed record. */
+		os_memcpy(buf, count, src + OS_MQ_HDR, size);
+		os_mq_remove_up(q, OS_MQ_REC(size));
+		rv = size;
+		goto l_end;
+	}
+
 	/* Search for the end of the queue element. */
 	end = os_memchr(src, src + size, '#', size);
 	OS_TRAP_IF(end == NULL);
@@ -554,11 +1568,72 @@ int os_mq_read(void *mq, char *buf, int count)
 
 l_end:
 	/* Leave the critical section. */
-	os_cs_leave(&q->mutex);
+	os_mq_leave(q);
 
 	return rv;
 }
 
+/**
+ * os_mq_wait_readable() - suspend the consumer without polling, until a
+ * message is present.
+ *
+ * @mq:  generic pointer to the I/O queue.
+ * @ms:  max. waiting time in milliseconds, or -1 without limit.
+ *
+ * Return:	0, if a message is present, or -1 after the timeout.
+ **/
+int os_mq_wait_readable(void *mq, int ms)
+{
+	/* Entry condition. */
+	OS_TRAP_IF(mq == NULL);
+
+	/* Sleep until the producer adds a message. */
+	return os_mq_wait(mq, os_mq_readable, 0, ms);
+}
+
+/**
+ * os_mq_wait_writable() - suspend the producer without polling, until a
+ * message of the given size fits. The size shall fit in the empty queue, which
+ * reserves the length header of a framed record.
+ *
+ * @mq:    generic pointer to the I/O queue.
+ * @size:  size of the message in the sense of os_mq_wmem().
+ * @ms:    max. waiting time in milliseconds, or -1 without limit.
+ *
+ * Return:	0, if the message fits, or -1 after the timeout.
+ **/
+int os_mq_wait_writable(void *mq, int size, int ms)
+{
+	os_mq_t *q;
+
+	/* Entry condition. */
+	q = mq;
+	OS_TRAP_IF(q == NULL || size < 1 || size > os_mq_frame(q, q->size));
+
+	/* Sleep until the consumer removes messages. */
+	return os_mq_wait(q, os_mq_writable, size, ms);
+}
+
+/**
+ * os_mq_fd() - get the event descriptor of the queue for poll() or epoll.
+ * It is readable, if messages have been added; read() returns their number
+ * and clears the counter, the consumer shall empty the queue afterwards.
+ *
+ * @mq:  generic pointer to the I/O queue, created with OS_MQ_EVENT.
+ *
+ * Return:	the event descriptor.
+ **/
+int os_mq_fd(void *mq)
+{
+	os_mq_t *q;
+
+	/* Entry condition. */
+	q = mq;
+	OS_TRAP_IF(q == NULL || q->efd < 0);
+
+	return q->efd;
+}
+
 /**
  * os_mq_delete() - frees the buffer queue object, which must have been returned
  * by a previous call to os_mq_init().
@@ -570,6 +1645,7 @@ l_end:
 void os_mq_delete(void *mq)
 {
 	os_mq_t *q;
+	int rv;
 	
 	/* Entry condition. */
 	OS_TRAP_IF(mq == NULL);
@@ -577,11 +1653,27 @@ void os_mq_delete(void *mq)
 	/* Decode the reference to the queue. */
 	q = mq;
 
-	/* Test the queue buffer state. */
-	OS_TRAP_IF(q->lock_size != 0);
+	/* Test the queue buffer state and the waiting threads. */
+	OS_TRAP_IF(q->lock_size != 0 || atomic_load(&q->waiters) != 0);
+
+	/* Close the event descriptor. */
+	if (q->efd >= 0) {
+		rv = close(q->efd);
+		OS_TRAP_IF(rv != 0);
+	}
 	
-	/* Free the queue buffer. */
-	OS_FREE(q->buf);
+	/* Test the queue mode. */
+	if (q->flags & OS_MQ_MIRROR) {
+		/* Remove both mappings and the memory file. */
+		rv = munmap(q->buf, 2 * q->size);
+		OS_TRAP_IF(rv != 0);
+		rv = close(q->fd);
+		OS_TRAP_IF(rv != 0);
+	}
+	else {
+		/* Free the queue buffer. */
+		OS_FREE(q->buf);
+	}
 	
 	/* Release the mutex for the critical sections in the queue
 	 * operations. */
@@ -593,30 +1685,88 @@ void os_mq_delete(void *mq)
 }
 
 /**
- * os_mq_init() - creates the buffer queue object for the I/O operations.
+ * os_mq_init_ext() - creates the buffer queue object for the I/O operations
+ * with the requested mode.
  *
- * @size:  size of the queue memory.
+ * @size:   size of the queue memory.
+ * @flags:  OS_MQ_FRAMED: save each message as a record with a length header
+ *          instead of the '#' delimiter; the payload may be binary.
+ *          OS_MQ_SPSC: lock-free bip buffer for exactly one producer and one
+ *          consumer thread; alloc, add, write and wmem belong to the producer,
+ *          get, remove and read to the consumer; the debug build traps
+ *          another thread on either side.
+ *          OS_MQ_MIRROR: ring buffer of size rounded up to the page size and
+ *          mapped twice, each reservation up to the free space is contiguous;
+ *          it is lock-free in combination with OS_MQ_SPSC.
+ *          OS_MQ_EVENT: create the event descriptor of os_mq_fd().
  *
  * Return:	the generic pointer to the queue object.
  **/
-void *os_mq_init(int size)
+void *os_mq_init_ext(int size, int flags)
 {
 	os_mq_t *q;
+	long page;
+
+	/* Entry condition. */
+	OS_TRAP_IF(size < 1 || size >= OS_MQ_LAP ||
+		   (flags & ~(OS_MQ_FRAMED | OS_MQ_SPSC | OS_MQ_MIRROR |
+			      OS_MQ_EVENT)));
 	
 	/* Allocate the queue object. */
 	q = OS_MALLOC(sizeof(os_mq_t));
 	os_memset(q, 0, sizeof(os_mq_t));
+	q->flags = flags;
 
 	/* Create the mutex for the critical sections in the queue
 	 * operations. */
 	os_cs_init(&q->mutex);
 
-	/* Allocate the queue buffer. */
-	q->buf = OS_MALLOC(size);
-	os_memset(q->buf, 0, size);
-
-	/* Save the queue buffer size. */
-	q->size = size;
+	/* Test the queue mode. */
+	if (flags & OS_MQ_MIRROR) {
+		/* Round up the queue buffer to the page size. */
+		page = sysconf(_SC_PAGESIZE);
+		q->size = (size + page - 1) / page * page;
+
+		/* Map the zero filled queue buffer twice. */
+		q->buf = os_mq_mirror_map(q);
+	}
+	else {
+		/* Allocate the queue buffer. */
+		q->fd  = -1;
+		q->buf = OS_MALLOC(size);
+		os_memset(q->buf, 0, size);
+
+		/* Save the queue buffer size. */
+		q->size = size;
+	}
+
+	/* Reset the indices of the SPSC queue. */
+	atomic_init(&q->head, 0);
+	atomic_init(&q->last, 0);
+	atomic_init(&q->tail, 0);
+
+	/* Reset the state of the waiting threads. */
+	atomic_init(&q->seq, 0);
+	atomic_init(&q->waiters, 0);
+
+	/* Create the event descriptor. */
+	q->efd = -1;
+	if (flags & OS_MQ_EVENT) {
+		q->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		OS_TRAP_IF(q->efd == -1);
+	}
 
 	return q;
 }
+
+/**
+ * os_mq_init() - creates the buffer queue object for the I/O operations.
+ *
+ * @size:  size of the queue memory.
+ *
+ * Return:	the generic pointer to the queue object.
+ **/
+void *os_mq_init(int size)
+{
+	return os_mq_init_ext(size, 0);
+}
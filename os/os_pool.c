@@ -0,0 +1,589 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Work-stealing thread pool.
+ *
+ * Copyright (C) 2022 Gerald Schueller <gerald.schueller@web.de>
+ */
+
+/*============================================================================
+  IMPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include <stddef.h>      /* Standard type definitions: offsetof(). */
+#include <string.h>      /* String operations. */
+#include <pthread.h>     /* POSIX thread. */
+#include "os.h"          /* Operating system: os_sem_create() */
+
+/*============================================================================
+  EXPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include "os_private.h"  /* Local interfaces of the OS: os_pool_init() */
+
+/*============================================================================
+  LOCAL NAME CONSTANTS DEFINITIONS
+  ============================================================================*/
+/* Initial number of the deque elements of a worker. */
+#define OS_POOL_DEQUE_SIZE  64
+
+/* Size class and number of the recycled message copies of a worker; larger
+ * messages and additional copies are taken from the heap and freed after the
+ * processing. */
+#define OS_POOL_BUF_SIZE  128
+#define OS_POOL_BUF_N     64
+
+/*============================================================================
+  MACROS
+  ============================================================================*/
+/* Map the message copy to the buffer header. */
+#define OS_POOL_BUF(elem_) \
+	((os_pool_buf_t *) ((char *) (elem_) - offsetof(os_pool_buf_t, elem)))
+
+/* Distance of two recycled message copies. */
+#define OS_POOL_BUF_STRIDE \
+	(offsetof(os_pool_buf_t, elem) + OS_POOL_BUF_SIZE)
+
+/*============================================================================
+  LOCAL TYPE DEFINITIONS
+  ============================================================================*/
+struct os_pool_s;
+
+/**
+ * os_pool_buf_t - header of a message copy of the thread pool.
+ *
+ * @next:   successor in the free list of a worker.
+ * @owner:  deque with the free list of the recycled buffer or NULL for a
+ *          heap buffer.
+ * @elem:   start of the message copy.
+ **/
+typedef struct os_pool_buf_s {
+	struct os_pool_buf_s  *next;
+	void                  *owner;
+	max_align_t            elem[];
+} os_pool_buf_t;
+
+/**
+ * os_pool_deque_t - double-ended message queue of a worker: the owner inserts
+ * and removes the messages at the bottom, the other workers steal them from
+ * the top.
+ *
+ * @protect:  protect the access to the deque.
+ * @ring:     ring buffer of the message pointers.
+ * @size:     number of the ring buffer elements.
+ * @top:      steal position of the deque.
+ * @bottom:   insert position of the deque.
+ * @mem:      memory of the recycled message copies.
+ * @free:     free list of the recycled message copies.
+ **/
+typedef struct {
+	spinlock_t        protect;
+	os_queue_elem_t **ring;
+	int               size;
+	int               top;
+	int               bottom;
+	char             *mem;
+	os_pool_buf_t    *free;
+} os_pool_deque_t;
+
+/**
+ * os_pool_worker_t - pthread of the pool with its message queue.
+ *
+ * @pool:     reference to the thread pool.
+ * @idx:      position of the worker in the pool.
+ * @pthread:  pthread object.
+ * @deque:    message queue of the worker.
+ **/
+typedef struct {
+	struct os_pool_s  *pool;
+	int                idx;
+	pthread_t          pthread;
+	os_pool_deque_t    deque;
+} os_pool_worker_t;
+
+/**
+ * os_pool_t - thread pool.
+ *
+ * @name:     name of the thread pool.
+ * @count:    number of the workers.
+ * @worker:   list of the workers.
+ * @next:     round robin index for the external producers.
+ * @pending:  number of the queued messages.
+ * @idle:     number of the workers, which want to suspend.
+ * @is_stop:  if 1, the workers shall terminate.
+ * @work_c:   control semaphore of the idle workers.
+ **/
+typedef struct os_pool_s {
+	char               name[OS_THREAD_NAME_LEN + 1];
+	int                count;
+	os_pool_worker_t  *worker;
+	atomic_uint        next;
+	atomic_int         pending;
+	atomic_int         idle;
+	atomic_int         is_stop;
+	sem_t              work_c;
+} os_pool_t;
+
+/*============================================================================
+  LOCAL DATA
+  ============================================================================*/
+/**
+ * os_pool_list - state of all thread pools.
+ *
+ * @count:  number of the installed thread pools.
+ * @key:    data key with the reference to the current worker.
+ **/
+static struct os_pool_list_s {
+	atomic_int     count;
+	pthread_key_t  key;
+} os_pool_list;
+
+/*============================================================================
+  LOCAL FUNCTION PROTOTYPES
+  ============================================================================*/
+/*============================================================================
+  LOCAL FUNCTIONS
+  ============================================================================*/
+/**
+ * os_pool_alloc() - take a buffer for the message copy from the free list of
+ * the deque or from the heap.
+ *
+ * @d:     pointer to the deque of a worker.
+ * @size:  size of the message.
+ *
+ * Return:	the pointer to the message buffer.
+ **/
+static os_queue_elem_t *os_pool_alloc(os_pool_deque_t *d, int size)
+{
+	os_pool_buf_t *buf;
+
+	/* Remove the first buffer from the free list. */
+	buf = NULL;
+	if (size <= OS_POOL_BUF_SIZE) {
+		os_spin_lock(&d->protect);
+		buf = d->free;
+		if (buf != NULL)
+			d->free = buf->next;
+
+		os_spin_unlock(&d->protect);
+	}
+
+	/* Request memory for a large message or an exhausted free list. */
+	if (buf == NULL) {
+		buf = OS_MALLOC(offsetof(os_pool_buf_t, elem) + size);
+		buf->owner = NULL;
+	}
+
+	return (os_queue_elem_t *) buf->elem;
+}
+
+/**
+ * os_pool_release() - return the processed message copy to the free list of
+ * its deque or to the heap. Any worker may call this function.
+ *
+ * @elem:  pointer to the message copy.
+ *
+ * Return:	None.
+ **/
+static void os_pool_release(os_queue_elem_t *elem)
+{
+	os_pool_deque_t *d;
+	os_pool_buf_t *buf;
+
+	/* Map the message to the buffer header. */
+	buf = OS_POOL_BUF(elem);
+
+	/* Test the origin of the message copy. */
+	d = buf->owner;
+	if (d == NULL) {
+		OS_FREE(buf);
+		return;
+	}
+
+	/* Insert the buffer at the start of the free list. */
+	os_spin_lock(&d->protect);
+	buf->next = d->free;
+	d->free   = buf;
+	os_spin_unlock(&d->protect);
+}
+
+/**
+ * os_pool_push() - insert the message at the bottom of the deque and double
+ * the ring buffer, if it is full.
+ *
+ * @d:     pointer to the deque of a worker.
+ * @elem:  pointer to the message copy.
+ *
+ * Return:	None.
+ **/
+static void os_pool_push(os_pool_deque_t *d, os_queue_elem_t *elem)
+{
+	os_queue_elem_t **ring;
+	int i, n;
+
+	/* Enter the critical section. */
+	os_spin_lock(&d->protect);
+
+	/* Test the filling level of the deque. */
+	n = d->bottom - d->top;
+	if (n >= d->size) {
+		/* Copy the messages into a ring buffer of double size. */
+		ring = OS_MALLOC(2 * d->size * sizeof(os_queue_elem_t *));
+		for (i = 0; i < n; i++)
+			ring[i] = d->ring[(d->top + i) % d->size];
+
+		/* Replace the ring buffer. */
+		OS_FREE(d->ring);
+		d->ring   = ring;
+		d->size  *= 2;
+		d->top    = 0;
+		d->bottom = n;
+	}
+
+	/* Insert the message at the bottom. */
+	d->ring[d->bottom % d->size] = elem;
+	d->bottom++;
+
+	/* Leave the critical section. */
+	os_spin_unlock(&d->protect);
+}
+
+/**
+ * os_pool_take() - remove a message from the deque.
+ *
+ * @d:       pointer to the deque of a worker.
+ * @is_top:  if 1, steal the oldest message at the top, otherwise take the
+ *           youngest message at the bottom.
+ *
+ * Return:	the pointer to the message or NULL, if the deque is empty.
+ **/
+static os_queue_elem_t *os_pool_take(os_pool_deque_t *d, int is_top)
+{
+	os_queue_elem_t *elem;
+
+	/* Enter the critical section. */
+	os_spin_lock(&d->protect);
+
+	/* Test the filling level of the deque. */
+	if (d->bottom == d->top) {
+		elem = NULL;
+	}
+	else if (is_top) {
+		/* Steal the oldest message. */
+		elem = d->ring[d->top % d->size];
+		d->top++;
+	}
+	else {
+		/* Take the youngest message. */
+		d->bottom--;
+		elem = d->ring[d->bottom % d->size];
+	}
+
+	/* Rewind the empty deque. */
+	if (d->bottom == d->top)
+		d->bottom = d->top = 0;
+
+	/* Leave the critical section. */
+	os_spin_unlock(&d->protect);
+
+	return elem;
+}
+
+/**
+ * os_pool_search() - take a message from the own deque or steal it from the
+ * other workers.
+ *
+ * @w:  pointer to the current worker.
+ *
+ * Return:	the pointer to the message or NULL, if all deques are empty.
+ **/
+static os_queue_elem_t *os_pool_search(os_pool_worker_t *w)
+{
+	os_queue_elem_t *elem;
+	os_pool_t *pool;
+	int i;
+
+	/* Get the reference to the thread pool. */
+	pool = w->pool;
+
+	/* Continue with the youngest message of the own deque. */
+	elem = os_pool_take(&w->deque, 0);
+
+	/* Loop over the deques of the other workers. */
+	for (i = 1; elem == NULL && i < pool->count; i++)
+		elem = os_pool_take(&pool->worker[(w->idx + i) % pool->count].deque, 1);
+
+	/* Update the number of the queued messages. */
+	if (elem != NULL)
+		atomic_fetch_sub(&pool->pending, 1);
+
+	return elem;
+}
+
+/**
+ * os_pool_cb() - callback for the worker context.
+ *
+ * @arg:  generic reference to the worker.
+ *
+ * Return:	NULL.
+ **/
+static void *os_pool_cb(void *arg)
+{
+	os_pool_worker_t *w;
+	os_queue_elem_t *elem;
+	os_pool_t *pool;
+	int ret;
+
+	/* Entry condition. */
+	OS_TRAP_IF(arg == NULL);
+
+	/* Decode the reference to the worker. */
+	w = arg;
+	pool = w->pool;
+
+	/* Save the worker pointer for os_pool_submit. */
+	ret = pthread_setspecific(os_pool_list.key, w);
+	OS_TRAP_IF(ret != 0);
+
+	/* Loop thru the worker callback. */
+	for (;;) {
+		/* Search for a message. */
+		elem = os_pool_search(w);
+		if (elem != NULL) {
+			/* Process the current message. */
+			elem->cb(elem);
+
+			/* Recycle the message copy. */
+			os_pool_release(elem);
+			continue;
+		}
+
+		/* Announce the suspension to the producers. */
+		atomic_fetch_add(&pool->idle, 1);
+
+		/* Test the number of the queued messages again, a producer
+		 * may have missed the announcement. */
+		if (atomic_load(&pool->pending) > 0) {
+			atomic_fetch_sub(&pool->idle, 1);
+			continue;
+		}
+
+		/* All messages have been processed before the termination. */
+		if (atomic_load(&pool->is_stop)) {
+			atomic_fetch_sub(&pool->idle, 1);
+			break;
+		}
+
+		/* Suspend the worker. */
+		os_sem_wait(&pool->work_c);
+
+		/* Withdraw the announcement. */
+		atomic_fetch_sub(&pool->idle, 1);
+	}
+
+	return NULL;
+}
+
+/*============================================================================
+  EXPORTED FUNCTIONS
+  ============================================================================*/
+/**
+ * os_pool_create() - create a thread pool whose workers process the messages
+ * of os_pool_submit.
+ *
+ * @name:   name of the thread pool.
+ * @count:  number of the workers.
+ *
+ * Return:	the generic pointer to the thread pool.
+ **/
+void *os_pool_create(const char *name, int count)
+{
+	os_pool_worker_t *w;
+	os_pool_buf_t *buf;
+	os_pool_t *pool;
+	int i, j, ret;
+
+	/* Entry condition. */
+	OS_TRAP_IF(name == NULL || os_strlen(name) >= OS_THREAD_NAME_LEN ||
+		   count < 1);
+
+	/* Allocate the thread pool. */
+	pool = OS_MALLOC(sizeof(os_pool_t));
+	os_memset(pool, 0, sizeof(os_pool_t));
+
+	/* Save the pool name. */
+	os_strcpy(pool->name, OS_THREAD_NAME_LEN, name);
+
+	/* Create the control semaphore of the idle workers. */
+	os_sem_init(&pool->work_c, 0);
+
+	/* Allocate the workers. */
+	pool->count  = count;
+	pool->worker = OS_MALLOC(count * sizeof(os_pool_worker_t));
+	os_memset(pool->worker, 0, count * sizeof(os_pool_worker_t));
+
+	/* Initialize the deques of the workers. */
+	for (i = 0, w = pool->worker; i < count; i++, w++) {
+		w->pool = pool;
+		w->idx  = i;
+		os_spin_init(&w->deque.protect);
+		w->deque.size = OS_POOL_DEQUE_SIZE;
+		w->deque.ring = OS_MALLOC(OS_POOL_DEQUE_SIZE *
+					  sizeof(os_queue_elem_t *));
+
+		/* Fill the free list of the recycled message copies. */
+		w->deque.mem = OS_MALLOC(OS_POOL_BUF_N * OS_POOL_BUF_STRIDE);
+		for (j = OS_POOL_BUF_N - 1; j >= 0; j--) {
+			buf = (os_pool_buf_t *) (w->deque.mem +
+						 j * OS_POOL_BUF_STRIDE);
+			buf->owner = &w->deque;
+			buf->next  = w->deque.free;
+			w->deque.free = buf;
+		}
+	}
+
+	/* Start the workers. */
+	for (i = 0, w = pool->worker; i < count; i++, w++) {
+		ret = pthread_create(&w->pthread, NULL, os_pool_cb, w);
+		OS_TRAP_IF(ret != 0);
+	}
+
+	/* Update the number of the thread pools. */
+	atomic_fetch_add(&os_pool_list.count, 1);
+
+	return pool;
+}
+
+/**
+ * os_pool_submit() - save a copy of the message in the thread pool. A worker
+ * inserts the message in its own deque, other callers distribute the messages
+ * round robin. After os_pool_destroy only the workers may submit messages
+ * until all pending messages have been processed.
+ *
+ * @g_pool:  generic address of the thread pool.
+ * @msg:     reference to the message.
+ * @size:    size of the message.
+ *
+ * Return:	None.
+ **/
+void os_pool_submit(void *g_pool, os_queue_elem_t *msg, int size)
+{
+	os_pool_worker_t *w;
+	os_queue_elem_t *elem;
+	os_pool_t *pool;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_pool == NULL || msg == NULL ||
+		   size < sizeof(os_queue_elem_t) || msg->cb == NULL);
+
+	/* Decode the reference to the thread pool. */
+	pool = g_pool;
+
+	/* Select the deque of the current worker or of the next worker; the
+	 * stopped pool rejects the external producers. */
+	w = pthread_getspecific(os_pool_list.key);
+	if (w == NULL || w->pool != pool) {
+		OS_TRAP_IF(atomic_load(&pool->is_stop));
+		w = &pool->worker[atomic_fetch_add(&pool->next, 1) % pool->count];
+	}
+
+	/* Copy the user message. */
+	elem = os_pool_alloc(&w->deque, size);
+	os_memcpy(elem, size, msg, size);
+
+	/* Insert the message. */
+	os_pool_push(&w->deque, elem);
+	atomic_fetch_add(&pool->pending, 1);
+
+	/* Resume a suspended worker. */
+	if (atomic_load(&pool->idle) > 0)
+		os_sem_release(&pool->work_c);
+}
+
+/**
+ * os_pool_destroy() - process the pending messages, stop the workers and
+ * release the thread pool. The workers may still submit follow-up messages
+ * until all pending messages have been processed.
+ *
+ * @g_pool:  generic address of the thread pool.
+ *
+ * Return:	None.
+ **/
+void os_pool_destroy(void *g_pool)
+{
+	os_pool_worker_t *w;
+	os_pool_t *pool;
+	void *status;
+	int i, ret;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_pool == NULL);
+
+	/* Decode the reference to the thread pool. */
+	pool = g_pool;
+
+	/* A worker may not delete its own pool. */
+	w = pthread_getspecific(os_pool_list.key);
+	OS_TRAP_IF(w != NULL && w->pool == pool);
+
+	/* Request the termination of the workers. */
+	atomic_store(&pool->is_stop, 1);
+	for (i = 0; i < pool->count; i++)
+		os_sem_release(&pool->work_c);
+
+	/* Wait for the termination of the workers. */
+	for (i = 0, w = pool->worker; i < pool->count; i++, w++) {
+		ret = pthread_join(w->pthread, &status);
+		OS_TRAP_IF(ret != 0);
+	}
+
+	/* Test the pool state. */
+	OS_TRAP_IF(atomic_load(&pool->pending) != 0);
+
+	/* Release the deques of the workers and the recycled message copies. */
+	for (i = 0, w = pool->worker; i < pool->count; i++, w++) {
+		OS_FREE(w->deque.mem);
+		OS_FREE(w->deque.ring);
+		os_spin_destroy(&w->deque.protect);
+	}
+
+	/* Release the pool resources. */
+	os_sem_delete(&pool->work_c);
+	OS_FREE(pool->worker);
+	OS_FREE(pool);
+
+	/* Update the number of the thread pools. */
+	atomic_fetch_sub(&os_pool_list.count, 1);
+}
+
+/**
+ * os_pool_init() - initialize the state of the thread pools.
+ *
+ * Return:	None.
+ **/
+void os_pool_init(void)
+{
+	int ret;
+
+	/* Reset the number of the thread pools. */
+	atomic_init(&os_pool_list.count, 0);
+
+	/* Create the data key for the worker reference. */
+	ret = pthread_key_create(&os_pool_list.key, NULL);
+	OS_TRAP_IF(ret != 0);
+}
+
+/**
+ * os_pool_exit() - test the release of all thread pools.
+ *
+ * Return:	None.
+ **/
+void os_pool_exit(void)
+{
+	int ret;
+
+	/* Test the number of the thread pools. */
+	OS_TRAP_IF(atomic_load(&os_pool_list.count) != 0);
+
+	/* Delete the data key for the worker reference. */
+	ret = pthread_key_delete(os_pool_list.key);
+	OS_TRAP_IF(ret != 0);
+}
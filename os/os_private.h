@@ -54,19 +54,30 @@ void os_mem_statistics(os_statistics_t *stat);
 
 /* Bootstrapping. */
 void os_trap_init(os_conf_t *conf);
-void os_mem_init(void);
+void os_mem_init(int diag);
 void os_thread_init(os_conf_t *conf);
+void os_pool_init(void);
+void os_wheel_init(void);
+void os_fiber_init(void);
+void os_arena_init(void);
 void os_cab_init(os_conf_t *conf, int creator);
 void os_inet_init();
 void os_clock_init_(void);
 void os_buf_init(void);
 void os_tcl_init(int test_mode);
 
+/* Release the resources of a destroyed os_thread. */
+void os_wheel_drop(void *g_thread);
+
 /* Test and free the OS resources. */
 void os_inet_exit(void);
 void os_cab_ripcord(int coverage);
 void os_cab_exit(void);
 void os_thread_exit(void);
+void os_pool_exit(void);
+void os_wheel_exit(void);
+void os_fiber_exit(void);
+void os_arena_exit(void);
 void os_mem_exit(void);
 void os_clock_exit_(void);
 void os_buf_exit(void);
@@ -9,8 +9,16 @@
 /*============================================================================
   IMPORTED INCLUDE REFERENCES
   ============================================================================*/
+#define _GNU_SOURCE      /* CPU affinity: pthread_attr_setaffinity_np(). */
+#include <errno.h>       /* ISO C99 Standard: 7.5 Errors: EPERM. */
 #include <string.h>      /* String operations. */
+#include <stddef.h>      /* Standard type definitions: offsetof(). */
+#include <sched.h>       /* Scheduling interfaces: sched_yield(). */
+#include <time.h>        /* Time types: clock_gettime(). */
 #include <pthread.h>     /* POSIX thread. */
+#include <unistd.h>      /* System call: syscall(). */
+#include <sys/syscall.h> /* System call numbers: SYS_futex. */
+#include <linux/futex.h> /* Fast user-space locking: FUTEX_WAIT_PRIVATE. */
 #include "os.h"          /* Operating system: os_sem_create() */
 
 /*============================================================================
@@ -21,33 +29,148 @@
 /*============================================================================
   LOCAL NAME CONSTANTS DEFINITIONS
   ============================================================================*/
+/* Size class of the pooled messages; larger messages are taken from the
+ * heap. */
+#define OS_QUEUE_SLOT_SIZE  128
+
+/* Scheduling states of the os_thread in the futex word of the queue. */
+#define OS_QUEUE_PARKED   -1  /* The thread sleeps on the futex word. */
+#define OS_QUEUE_IDLE      0  /* The thread tests the empty queue. */
+#define OS_QUEUE_RUNNING   1  /* The thread processes the messages. */
+
+/* States of the completion slot of os_call in the futex word. */
+#define OS_CALL_PENDING  0  /* The receiver processes the request. */
+#define OS_CALL_WAITING  1  /* The caller sleeps on the futex word. */
+#define OS_CALL_DONE     2  /* The receiver has saved the reply. */
+
 /*============================================================================
   MACROS
   ============================================================================*/
+/* Map the message to the buffer header. */
+#define OS_QUEUE_SLOT(elem_) \
+	((os_queue_slot_t *) ((char *) (elem_) - offsetof(os_queue_slot_t, elem)))
+
+/* Distance of two pool buffers. */
+#define OS_QUEUE_SLOT_STRIDE \
+	(offsetof(os_queue_slot_t, elem) + OS_QUEUE_SLOT_SIZE)
+
 /*============================================================================
   LOCAL TYPE DEFINITIONS
   ============================================================================*/
 /**
- * os_queue_t - os_thread queue.
+ * os_call_t - completion slot of a synchronous call: each caller owns one
+ * slot, which is reused for all its calls.
  *
- * @protect:     protect the access to the message queue.
- * @suspend_c:   client os_thread control semaphore.
- * @anchor:      first empty queue element.
- * @stopper:     last empty queue element.
- * @limit:       max. number of queue elements.
- * @count:       current number of queue elements.
- * @is_running:  the thread analyzes the message queue.
- * @busy_send:   if 1, a client executes os_queue_send.
+ * @state:  futex word: OS_CALL_PENDING, OS_CALL_WAITING or OS_CALL_DONE.
+ * @buf:    reply buffer of the caller.
+ * @size:   size of the reply buffer.
+ * @len:    length of the saved reply.
+ **/
+typedef struct {
+	atomic_int   state;
+	void        *buf;
+	int          size;
+	int          len;
+} os_call_t;
+
+/**
+ * os_queue_slot_t - header of a message buffer of the os_thread queue.
+ *
+ * @next:   position + 1 of the next free buffer of the message pool.
+ * @idx:    position + 1 in the message pool, 0 for a heap buffer.
+ * @stamp:  enqueue time in nanoseconds.
+ * @owner:  queue, which has provided the buffer.
+ * @ref:    number of the users of the buffer: the consumer and, for a
+ *          synchronous call, the pending os_reply.
+ * @call:   completion slot of the caller or NULL for an asynchronous message.
+ * @elem:   start of the message copy.
+ **/
+typedef struct {
+	atomic_int          next;
+	int                 idx;
+	long long           stamp;
+	struct os_queue_s  *owner;
+	atomic_int          ref;
+	os_call_t          *call;
+	max_align_t         elem[];
+} os_queue_slot_t;
+
+/**
+ * os_queue_pool_t - fixed size class message buffers of an os_thread queue.
+ *
+ * @mem:    start address of the buffer memory.
+ * @free:   lock-free list of the free message buffers: the lower 32 bits
+ *          contain the position + 1 of the first buffer, the upper 32 bits a
+ *          modification counter against the ABA problem.
+ * @count:  number of the message buffers.
  **/
 typedef struct {
-	spinlock_t       protect;
-	sem_t            suspend_c;
-	os_queue_elem_t  anchor;
-	os_queue_elem_t  stopper;
-	int              limit;
-	int              count;
-	volatile int     is_running;
-	atomic_int       busy_send;
+	char                *mem;
+	atomic_ullong        free;
+	int                  count;
+} os_queue_pool_t;
+
+/**
+ * os_queue_stat_t - telemetry of the os_thread queue, only modified by the
+ * consumer apart from the high-water mark.
+ *
+ * @processed:  number of the processed messages.
+ * @max_depth:  high-water mark of the reserved places.
+ * @lat_sum:    sum of the enqueue-to-dispatch latencies in nanoseconds.
+ * @lat_max:    max. enqueue-to-dispatch latency in nanoseconds.
+ * @hist:       latency histogram with logarithmic buckets.
+ **/
+typedef struct {
+	atomic_ullong  processed;
+	atomic_int     max_depth;
+	atomic_ullong  lat_sum;
+	atomic_ullong  lat_max;
+	atomic_ullong  hist[OS_THREAD_HIST_LEN];
+} os_queue_stat_t;
+
+/**
+ * os_queue_fifo_t - priority lane of the os_thread queue: lock-free
+ * multi-producer/single-consumer list of the messages linked with the next
+ * field of OS_QUEUE_MSG_HEAD.
+ *
+ * @anchor:  empty queue element, if all messages have been consumed.
+ * @head:    last queue element, the producers append the messages.
+ * @tail:    first queue element, only read by the consumer.
+ * @limit:   max. number of queue elements.
+ * @count:   number of the reserved places, only read by the capacity check.
+ * @queued:  number of the inserted messages, read by the consumer.
+ * @space_c: control semaphore of the producers waiting for a free place.
+ * @waiting: number of the producers waiting for a free place.
+ * @stat:    telemetry of the lane.
+ **/
+typedef struct {
+	os_queue_elem_t            anchor;
+	_Atomic(os_queue_elem_t *) head;
+	os_queue_elem_t           *tail;
+	atomic_int                 limit;
+	atomic_int                 count;
+	atomic_int                 queued;
+	sem_t                      space_c;
+	atomic_int                 waiting;
+	os_queue_stat_t            stat;
+} os_queue_fifo_t;
+
+/**
+ * os_queue_t - os_thread queue with the priority lanes.
+ *
+ * @lane:        message lists of the priority lanes.
+ * @run_state:   futex word with the scheduling state of the thread:
+ *               OS_QUEUE_RUNNING, OS_QUEUE_IDLE or OS_QUEUE_PARKED.
+ * @latency:     if 1, the messages are stamped to record their latencies.
+ * @busy_send:   if 1, a client executes os_queue_send.
+ * @pool:        message buffers sized from the queue limit.
+ **/
+typedef struct os_queue_s {
+	os_queue_fifo_t            lane[OS_QUEUE_LANES];
+	atomic_int                 run_state;
+	int                        latency;
+	atomic_int                 busy_send;
+	os_queue_pool_t            pool;
 } os_queue_t;
 
 /**
@@ -74,6 +197,7 @@ typedef enum {
  * @state:      current state of the pthread.
  * @prio:       thread priority.
  * @attr:       thread attribute like SCHED_RR.
+ * @eff:        effective scheduling attributes of the running thread.
  * @pthread:    pthread object.
  * @queue:      input queue of the os_thread.
  * @suspend_p:  parent control semaphore for create and destroy.
@@ -84,6 +208,7 @@ typedef struct {
 	char              name[OS_THREAD_NAME_LEN + 1];
 	os_thread_prio_t  prio;
 	pthread_attr_t    attr;
+	os_thread_attr_t  eff;
 	pthread_t         pthread;
 	os_queue_t        queue;
 	sem_t             suspend_p;
@@ -99,9 +224,24 @@ typedef struct {
 typedef struct {
 	os_thread_t  thread;
 	int          idx;
-	int          is_in_use;
+	atomic_int   is_in_use;
 } os_thread_elem_t;
 
+/**
+ * os_thread_dir_t - directory of the thread table chunks with OS_THREAD_LIMIT
+ * entries each. A larger directory replaces the full one, the predecessors
+ * stay valid for the lock-free readers until os_thread_exit.
+ *
+ * @prev:   previous, smaller directory.
+ * @size:   number of the chunk pointers.
+ * @chunk:  list of the chunk pointers.
+ **/
+typedef struct os_thread_dir_s {
+	struct os_thread_dir_s       *prev;
+	int                           size;
+	_Atomic(os_thread_elem_t *)   chunk[];
+} os_thread_dir_t;
+
 /*============================================================================
   LOCAL DATA
   ============================================================================*/
@@ -109,23 +249,34 @@ typedef struct {
 static os_conf_t *os_conf_p;
 
 /**
- * os_thread_list_s - list of the installed threads.
+ * os_thread_list_s - growable list of the installed threads.
  *
- * @list:     list of the installed thread.
- * @count:    number of the installed threads.
- * @protect:  protect the access to the thread list.
- * @key:      data key visible to all threads.
+ * @dir:        directory of the thread table chunks.
+ * @free:       stack of the released table indices.
+ * @free_n:     number of the stacked indices.
+ * @free_size:  capacity of the index stack.
+ * @limit:      number of the used table entries so far.
+ * @count:      number of the installed threads.
+ * @protect:    protect the modification of the thread list.
+ * @key:        data key visible to all threads.
  * @once_c:   
  **/
 static struct os_thread_list_s {
-	os_thread_elem_t  elem[OS_THREAD_LIMIT];
-	int               count;
-	pthread_mutex_t   protect;
-	pthread_key_t     key;
-	pthread_once_t    once_c;
+	_Atomic(os_thread_dir_t *)  dir;
+	int                        *free;
+	int                         free_n;
+	int                         free_size;
+	int                         limit;
+	atomic_int                  count;
+	pthread_mutex_t             protect;
+	pthread_key_t               key;
+	pthread_once_t              once_c;
 
 } os_thread_list;
 
+/* Completion slot of the synchronous calls of the current thread. */
+static __thread os_call_t os_call_slot;
+
 /*============================================================================
   LOCAL FUNCTION PROTOTYPES
   ============================================================================*/
@@ -134,520 +285,1790 @@ static struct os_thread_list_s {
   ============================================================================*/
 
 /**
- * os_queue_loop() - process the received messages.
+ * os_queue_slot_get() - take a buffer for a message copy from the pool of the
+ * queue or from the heap. Any producer may call this function concurrently.
  *
- * @thread:  reference to os_thread.
- * @count:   fill level of the message queue.
+ * @q:     pointer to the OS thread queue.
+ * @size:  size of the message.
  *
- * Return:	0, if the thread state != OS_THREAD_READY.
+ * Return:	the pointer to the message buffer.
  **/
-static int os_queue_loop(os_thread_t *thread, int count)
+static os_queue_elem_t *os_queue_slot_get(os_queue_t *q, int size)
 {
-	os_thread_state_t state;
-	os_queue_elem_t *elem;
-	os_queue_t *q;
-	
-	/* Get the reference to the thread input queue. */
-	q = &thread->queue;
-
-	/* Loop over the message queue. */
-	while (count > 0) {
-		/* Enter the critical section. */
-		os_spin_lock(&q->protect);
-			
-		/* Decrement the element counter. */
-		q->count--;
-
-		/* Get the first queue element. */
-		elem = q->anchor.next;
-
-		/* Calculate the new queue start. */
-		q->anchor.next = elem->next;
-
-		/* Test the fill level of the input queue. */
-		if (q->anchor.next == &q->stopper) {
-			/* As of now, the input queue is empty. */
-			q->stopper.next = &q->anchor;
-		}
+	unsigned long long old, new;
+	os_queue_pool_t *p;
+	os_queue_slot_t *slot;
+	int idx;
+
+	/* Get the reference to the message pool. */
+	p = &q->pool;
+
+	/* Test the size class of the message. */
+	if (size > OS_QUEUE_SLOT_SIZE)
+		goto l_heap;
+
+	/* Remove the first free buffer from the pool. */
+	old = atomic_load(&p->free);
+	do {
+		/* Test the fill level of the pool. */
+		idx = old & 0xffffffff;
+		if (idx < 1)
+			goto l_heap;
+
+		/* Calculate the new list start and modification counter. */
+		slot = (os_queue_slot_t *) (p->mem + (idx - 1) * OS_QUEUE_SLOT_STRIDE);
+		new  = (((old >> 32) + 1) << 32) | atomic_load(&slot->next);
+	} while (! atomic_compare_exchange_weak(&p->free, &old, new));
+
+	/* The message does not belong to a synchronous call. */
+	slot->owner = q;
+	atomic_init(&slot->ref, 1);
+	slot->call  = NULL;
+	return (os_queue_elem_t *) slot->elem;
+
+l_heap:
+	/* Request memory for the os_message. */
+	slot = OS_MALLOC(offsetof(os_queue_slot_t, elem) + size);
+	slot->idx   = 0;
+	slot->owner = q;
+	atomic_init(&slot->ref, 1);
+	slot->call  = NULL;
+	return (os_queue_elem_t *) slot->elem;
+}
 
-		/* Leave the critical section. */
-		os_spin_unlock(&q->protect);
+/**
+ * os_queue_slot_put() - return the message buffer to the pool of the queue or
+ * to the heap. Any thread may call this function concurrently.
+ *
+ * @q:     pointer to the OS thread queue.
+ * @elem:  pointer to the message buffer.
+ *
+ * Return:	None.
+ **/
+static void os_queue_slot_put(os_queue_t *q, os_queue_elem_t *elem)
+{
+	unsigned long long old, new;
+	os_queue_pool_t *p;
+	os_queue_slot_t *slot;
 
-		/* Process the current message. */
-		elem->cb(elem);
+	/* Map the message to the buffer header. */
+	slot = OS_QUEUE_SLOT(elem);
 
+	/* Test the origin of the message buffer. */
+	if (slot->idx < 1) {
 		/* Free the message buffer. */
-		OS_FREE(elem);
+		OS_FREE(slot);
+		return;
+	}
 
-		/* Enter the critical section. */
-		os_spin_lock(&q->protect);
+	/* Insert the buffer at the start of the free list. */
+	p = &q->pool;
+	old = atomic_load(&p->free);
+	do {
+		atomic_store(&slot->next, old & 0xffffffff);
+		new = (((old >> 32) + 1) << 32) | slot->idx;
+	} while (! atomic_compare_exchange_weak(&p->free, &old, new));
+}
 
-		/* Copy the filling level of the queue. */
-		count = q->count;
+/**
+ * os_queue_slot_drop() - remove a user of the message buffer and return the
+ * buffer to the pool of its queue after the last user.
+ *
+ * @elem:  pointer to the message buffer.
+ *
+ * Return:	None.
+ **/
+static void os_queue_slot_drop(os_queue_elem_t *elem)
+{
+	os_queue_slot_t *slot;
 
-		/* Leave the critical section. */
-		os_spin_unlock(&q->protect);
+	/* Map the message to the buffer header. */
+	slot = OS_QUEUE_SLOT(elem);
 
-		/* Test the thread state. */
-		state = atomic_load(&thread->state);
-		if (state != OS_THREAD_READY)
-			return 0;
-	}
+	/* Test the last user of the message buffer. */
+	if (atomic_fetch_sub(&slot->ref, 1) == 1)
+		os_queue_slot_put(slot->owner, elem);
+}
 
-	return 1;
+/**
+ * os_queue_push() - append the message to the lane of the thread input queue.
+ * Any producer may call this function concurrently.
+ *
+ * @q:     pointer to the priority lane.
+ * @elem:  pointer to the message.
+ *
+ * Return:	None.
+ **/
+static void os_queue_push(os_queue_fifo_t *q, os_queue_elem_t *elem)
+{
+	os_queue_elem_t *prev;
+
+	/* The new message is the last queue element. */
+	atomic_store(&elem->next, NULL);
+
+	/* Serialize the producers with a single exchange. */
+	prev = atomic_exchange(&q->head, elem);
+
+	/* Link the predecessor, which makes the message visible. */
+	atomic_store(&prev->next, elem);
 }
 
 /**
- * os_thread_suspend() - suspend the thread, if the message queue is empty.
+ * os_queue_pop() - remove the first message from the lane of the thread input
+ * queue. Only the consumer calls this function.
  *
- * @thread:  reference to os_thread.
- * @count:   pointer to the fill level of the input queue.
+ * @q:  pointer to the priority lane.
  *
- * Return:	0, if the thread state != OS_THREAD_READY.
+ * Return:	the first message or NULL, if the queue is empty or a producer has
+ * not yet linked its message.
  **/
-static int os_thread_suspend(os_thread_t *thread, int *count_p)
+static os_queue_elem_t *os_queue_pop(os_queue_fifo_t *q)
 {
-	os_thread_state_t state;
-	os_queue_t *q;
-	int count;
+	os_queue_elem_t *tail, *next;
 
-	/* Initialize the return value. */
-	*count_p = 0;
+	/* Get the first queue element. */
+	tail = q->tail;
+	next = atomic_load(&tail->next);
 
-	/* Get the reference to the thread input queue. */
-	q = &thread->queue;
+	/* Skip the empty queue element. */
+	if (tail == &q->anchor) {
+		if (next == NULL)
+			return NULL;
 
-	/* Enter the critical section. */
-	os_spin_lock(&q->protect);
+		q->tail = next;
+		tail = next;
+		next = atomic_load(&tail->next);
+	}
 
-	/* If the input queue is empty, suspend the thread. */
-	q->is_running = 0;
+	/* Test the successor of the first message. */
+	if (next != NULL) {
+		q->tail = next;
+		return tail;
+	}
 
-	/* Copy the filling level of the queue. */
-	count = q->count;
+	/* A producer is appending a message. */
+	if (tail != atomic_load(&q->head))
+		return NULL;
 
-	/* Leave the critical section. */
-	os_spin_unlock(&q->protect);
+	/* Append the empty queue element behind the last message. */
+	os_queue_push(q, &q->anchor);
 
-	/* If the input queue is empty, suspend the thread. */
-	if (count < 1) {
-		/* Test the thread state. */
-		state = atomic_load(&thread->state);
-		if (state != OS_THREAD_READY)
-			return 0;
+	/* Test the successor of the first message again. */
+	next = atomic_load(&tail->next);
+	if (next == NULL)
+		return NULL;
 
-		/* Print the suspend information. */
-		OS_TRACE(("%s [t=%s,s=%d,o=suspend]\n", OS, thread->name, state));
+	q->tail = next;
+	return tail;
+}
 
-		/* Suspend the thread. */
-		os_sem_wait (&q->suspend_c);
+/**
+ * os_queue_now() - read the monotonic clock.
+ *
+ * Return:	the current time in nanoseconds.
+ **/
+static long long os_queue_now(void)
+{
+	struct timespec t;
 
-		/* Print the resume information. */
-		OS_TRACE(("%s [t=%s,s=%d,o=resume]\n", OS, thread->name, state));
-	}
+	/* Read the monotonic clock. */
+	clock_gettime(CLOCK_MONOTONIC, &t);
 
-	/* Enter the critical section. */
-	os_spin_lock(&q->protect);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
 
-	/* Change the thread state to running. */
-	q->is_running = 1;
+/**
+ * os_queue_record() - update the telemetry of the lane with the dispatched
+ * message and with its latency, if the messages are stamped. Only the
+ * consumer calls this function.
+ *
+ * @q:        pointer to the priority lane.
+ * @elem:     pointer to the dispatched message.
+ * @latency:  if 1, record the latency of the message.
+ *
+ * Return:	None.
+ **/
+static void os_queue_record(os_queue_fifo_t *q, os_queue_elem_t *elem,
+			    int latency)
+{
+	unsigned long long lat, v;
+	os_queue_stat_t *st;
+	int i;
 
-	/* Copy the filling level of the queue. */
-	count = q->count;
+	/* Count the dispatched message. */
+	st = &q->stat;
+	v  = atomic_load_explicit(&st->processed, memory_order_relaxed);
+	atomic_store_explicit(&st->processed, v + 1, memory_order_relaxed);
 
-	/* Leave the critical section. */
-	os_spin_unlock(&q->protect);
+	/* Test the latency recording. */
+	if (! latency)
+		return;
 
-	/* Update the fill level of the queue. */
-	*count_p = count;
+	/* Calculate the enqueue-to-dispatch latency. */
+	lat = os_queue_now() - OS_QUEUE_SLOT(elem)->stamp;
 
-	/* Test the thread state. */
-	state = atomic_load(&thread->state);
-	if (state != OS_THREAD_READY)
-		return 0;
-		
-	return 1;
+	/* Select the logarithmic bucket of the latency. */
+	i = lat ? 64 - __builtin_clzll(lat) : 0;
+	if (i >= OS_THREAD_HIST_LEN)
+		i = OS_THREAD_HIST_LEN - 1;
+
+	/* The single writer updates the counters without atomic operation. */
+	v = atomic_load_explicit(&st->hist[i], memory_order_relaxed);
+	atomic_store_explicit(&st->hist[i], v + 1, memory_order_relaxed);
+
+	v = atomic_load_explicit(&st->lat_sum, memory_order_relaxed);
+	atomic_store_explicit(&st->lat_sum, v + lat, memory_order_relaxed);
+
+	v = atomic_load_explicit(&st->lat_max, memory_order_relaxed);
+	if (lat > v)
+		atomic_store_explicit(&st->lat_max, lat, memory_order_relaxed);
 }
 
 /**
- * os_pthread_once_init() - init_routine for pthread_once.
+ * os_queue_stat_add() - add the telemetry of the lane to the copy of the
+ * caller.
+ *
+ * @q:      pointer to the priority lane.
+ * @stats:  address of the telemetry copy.
  *
  * Return:	None.
  **/
-static void os_pthread_once_init(void)
+static void os_queue_stat_add(os_queue_fifo_t *q, os_thread_stats_t *stats)
 {
-	int ret;
+	unsigned long long lat_max;
+	os_queue_stat_t *st;
+	int i, max_depth;
+
+	/* Get the reference to the telemetry of the lane. */
+	st = &q->stat;
+
+	/* Sum up the counters. */
+	stats->processed += atomic_load(&st->processed);
+	stats->depth     += atomic_load(&q->count);
+	stats->lat_sum   += atomic_load(&st->lat_sum);
+	for (i = 0; i < OS_THREAD_HIST_LEN; i++)
+		stats->hist[i] += atomic_load(&st->hist[i]);
+
+	/* Take over the maxima. */
+	max_depth = atomic_load(&st->max_depth);
+	if (max_depth > stats->max_depth)
+		stats->max_depth = max_depth;
+
+	lat_max = atomic_load(&st->lat_max);
+	if (lat_max > stats->lat_max)
+		stats->lat_max = lat_max;
+}
 
-	/* The first call to pthread_once() by any thread in a process, with a
-	 * given once_control, will call the init_routine() with no arguments.
-	 * Subsequent calls of pthread_once() with the same once_control will
-	 * not call the init_routine(). On return from pthread_once(), it is
-	 * guaranteed that init_routine() has completed. The once_contro
-	 *l parameter is used to determine whether the associated initialisation
-	 * routine has been called. */
+/**
+ * os_futex_wait() - sleep on the futex word, as long as it contains the
+ * expected value.
+ *
+ * @addr:  address of the futex word.
+ * @val:   expected value of the futex word.
+ *
+ * Return:	None.
+ **/
+static void os_futex_wait(atomic_int *addr, int val)
+{
+	long ret;
 
-	/* Create a data key visible to all theads in the process. */
-	ret = pthread_key_create(&os_thread_list.key, NULL);
-	OS_TRAP_IF(ret != 0);
+	/* Suspend the current thread. */
+	ret = syscall(SYS_futex, (int *) addr, FUTEX_WAIT_PRIVATE, val,
+		      NULL, NULL, 0);
+
+	/* Final condition. */
+	OS_TRAP_IF(ret != 0 && errno != EAGAIN && errno != EINTR);
 }
 
 /**
- * os_thread_save() - save the thread pointer.
+ * os_futex_wake() - resume the thread sleeping on the futex word.
  *
- * @thread:  reference to os_thread.
+ * @addr:  address of the futex word.
  *
  * Return:	None.
  **/
-static void os_thread_save(os_thread_t *thread)
+static void os_futex_wake(atomic_int *addr)
 {
-	pthread_key_t key;
-	int ret;
-	
-	/* Initialze the os_thread_list.key once. */
-	ret = pthread_once(&os_thread_list.once_c, os_pthread_once_init);
-	OS_TRAP_IF(ret != 0);
+	long ret;
 
-	/* Copy the key. */
-	key = os_thread_list.key;
+	/* Resume one thread. */
+	ret = syscall(SYS_futex, (int *) addr, FUTEX_WAKE_PRIVATE, 1,
+		      NULL, NULL, 0);
 
-	/* Get the reference to the os_thread. */
-	if (pthread_getspecific(key) == NULL) {
-		/* Associate the os_thread with key. */
-		ret = pthread_setspecific(key, thread);
-		OS_TRAP_IF(ret != 0);
-	}
+	/* Final condition. */
+	OS_TRAP_IF(ret < 0);
 }
 
 /**
- * os_thread_cb() - callback for the thread context.
+ * os_queue_wake() - change the thread state to running and resume the
+ * thread, if it sleeps on the futex word.
  *
- * @arg:  generic reference to os_thread.
+ * @q:  pointer to the OS thread queue.
  *
- * Return:	NULL.
+ * Return:	None.
  **/
-static void *os_thread_cb(void *arg)
+static void os_queue_wake(os_queue_t *q)
 {
-	os_thread_t *thread;
-	int count;
+	/* Test and change the scheduling state of the thread. */
+	if (atomic_exchange(&q->run_state, OS_QUEUE_RUNNING) == OS_QUEUE_PARKED)
+		os_futex_wake(&q->run_state);
+}
 
-	/* Entry condition. */
-	OS_TRAP_IF(arg == NULL);
-	
-	/* Decode the reference to the os_thread. */
-	thread = arg;
-	
-	/* Save the thread pointer. */
-	os_thread_save(thread);
+/**
+ * os_queue_reserve() - reserve a place for a new message in the lane of the
+ * thread input queue.
+ *
+ * @q:  pointer to the priority lane.
+ *
+ * Return:	0, if a place has been reserved, or -1, if the lane is full.
+ **/
+static int os_queue_reserve(os_queue_fifo_t *q)
+{
+	int count, max;
+
+	/* Increment the number of the queue elements up to the limit. */
+	count = atomic_load(&q->count);
+	do {
+		/* Test the state of the message queue. */
+		if (count >= atomic_load(&q->limit))
+			return -1;
+	} while (! atomic_compare_exchange_weak(&q->count, &count, count + 1));
+
+	/* Update the high-water mark of the lane. */
+	max = atomic_load_explicit(&q->stat.max_depth, memory_order_relaxed);
+	while (count + 1 > max &&
+	       ! atomic_compare_exchange_weak_explicit(&q->stat.max_depth, &max,
+						       count + 1,
+						       memory_order_relaxed,
+						       memory_order_relaxed))
+		;
 
-	/* Change the os_thread state. */
-	OS_TRACE(("%s [t=%s,s=ready,o=create]\n", OS, thread->name));
-	atomic_store(&thread->state, OS_THREAD_READY);
+	return 0;
+}
 
-	/* Resume the caller of os_thread_create. */
-	os_sem_release(&thread->suspend_p);
+/**
+ * os_queue_insert() - append the message buffer to the lane of the thread
+ * input queue and resume the suspended thread. The place has already been
+ * reserved.
+ *
+ * @q:     pointer to the OS thread queue.
+ * @lane:  priority lane of the message.
+ * @elem:  message buffer of the queue.
+ *
+ * Return:	None.
+ **/
+static void os_queue_insert(os_queue_t *q, os_queue_lane_t lane,
+			    os_queue_elem_t *elem)
+{
+	/* Save the enqueue time, if the latencies are recorded. */
+	if (q->latency)
+		OS_QUEUE_SLOT(elem)->stamp = os_queue_now();
+
+	/* Insert the new message at the end of the lane and count it for the
+	 * consumer. */
+	os_queue_push(&q->lane[lane], elem);
+	atomic_fetch_add(&q->lane[lane].queued, 1);
+
+	/* Resume the os_thread, if it is not running. */
+	if (atomic_load(&q->run_state) != OS_QUEUE_RUNNING)
+		os_queue_wake(q);
+}
 
-	/* Loop thru the thread callback. */
-	for (;;)  {
-		/* Suspend the thread, if the message queue is empty. */
-		count = 0;
-		if (! os_thread_suspend(thread, &count))
-			break;
+/**
+ * os_queue_copy() - save a copy of the message in the reserved place of the
+ * thread input queue.
+ *
+ * @q:     pointer to the OS thread queue.
+ * @lane:  priority lane of the message.
+ * @msg:   reference to the message.
+ * @size:  size of the message.
+ *
+ * Return:	None.
+ **/
+static void os_queue_copy(os_queue_t *q, os_queue_lane_t lane,
+			  os_queue_elem_t *msg, int size)
+{
+	os_queue_elem_t *elem;
 
-		/* Loop over the message queue. */
-		if (! os_queue_loop(thread, count))
-			break;
-	}
-	
-	/* Release the parent thread in os_thread_destroy. */
-	os_sem_release(&thread->suspend_p);
-	
-	return NULL;
+	/* Take a message buffer from the pool. */
+	elem = os_queue_slot_get(q, size);
+
+	/* Copy the user message. */
+	os_memcpy (elem, size, msg, size);
+
+	/* Insert the message buffer and resume the thread. */
+	os_queue_insert(q, lane, elem);
 }
 
 /**
- * os_queue_free() - release the queue resources.
+ * os_queue_acquire() - reserve a place in the lane of the thread input queue
+ * or stop the process, if the lane is full.
  *
- * @q:  pointer to the OS thread queue.
+ * @thread:  reference to os_thread.
+ * @lane:    priority lane of the message.
  *
  * Return:	None.
  **/
-static void os_queue_free(os_queue_t *q)
+static void os_queue_acquire(os_thread_t *thread, os_queue_lane_t lane)
 {
-	os_queue_elem_t *elem, *next;
-	int i;
+	os_queue_fifo_t *q;
 
-	/* Get the first queue element. */
-	elem = q->anchor.next;
+	/* Get the reference to the priority lane. */
+	q = &thread->queue.lane[lane];
+
+	/* Test the state of the priority lane. */
+	if (os_queue_reserve(q) != 0) {
+		OS_TRACE(("> %s: \"%s\": lane=%d, count=%d, limit=%d", F,
+			  thread->name, lane, atomic_load(&q->count),
+			  atomic_load(&q->limit)));
+		OS_TRAP();
+	}
+}
+
+/**
+ * os_queue_pending() - count the queued messages of the lanes above the
+ * given lane.
+ *
+ * @q:    pointer to the OS thread queue.
+ * @end:  first lane, which is not counted.
+ *
+ * Return:	the number of the queued messages.
+ **/
+static int os_queue_pending(os_queue_t *q, int end)
+{
+	int i, n;
+
+	/* Sum up the inserted messages of the lanes. */
+	for (i = 0, n = 0; i < end; i++)
+		n += atomic_load(&q->lane[i].queued);
+
+	return n;
+}
+
+/**
+ * os_queue_loop() - process the received messages in batches: the consumer
+ * takes over all messages of the highest non-empty lane inserted at the start
+ * of the batch, the places reserved by os_queue_alloc are not waited for, and
+ * tests the thread state only after the last callback of the
+ * batch. The place of each message is released before its callback, so that
+ * the callback may send to its own thread at the queue limit. A batch of a
+ * lower lane ends early, if a higher lane receives a message.
+ *
+ * @thread:  reference to os_thread.
+ *
+ * Return:	0, if the thread state != OS_THREAD_READY.
+ **/
+static int os_queue_loop(os_thread_t *thread)
+{
+	os_thread_state_t state;
+	os_queue_elem_t *elem;
+	os_queue_fifo_t *lane;
+	os_queue_t *q;
+	int batch, waiting, i, l;
+	
+	/* Get the reference to the thread input queue. */
+	q = &thread->queue;
+
+	/* Loop over the message queue. */
+	for (;;) {
+		/* Search for the highest lane with pending messages. */
+		for (l = 0, batch = 0; l < OS_QUEUE_LANES; l++) {
+			batch = atomic_load(&q->lane[l].queued);
+			if (batch > 0)
+				break;
+		}
+
+		/* Test the filling level of all lanes. */
+		if (batch < 1)
+			return 1;
+
+		/* Detach all pending messages of the lane. */
+		lane = &q->lane[l];
+
+		/* Loop over the batch. */
+		for (i = 0; i < batch; ) {
+			/* Get the first queue element. */
+			while ((elem = os_queue_pop(lane)) == NULL) {
+				/* Wait for the completion of the os_queue_send. */
+				sched_yield();
+			}
+
+			/* Release the place of the message in the lane. */
+			atomic_fetch_sub_explicit(&lane->queued, 1,
+						  memory_order_relaxed);
+			atomic_fetch_sub_explicit(&lane->count, 1,
+						  memory_order_relaxed);
+
+			/* Update the telemetry of the lane. */
+			os_queue_record(lane, elem, q->latency);
+
+			/* Process the current message. */
+			elem->cb(elem);
+
+			/* Return the message buffer to the pool, unless a
+			 * synchronous call is still pending. */
+			os_queue_slot_drop(elem);
+			i++;
+
+			/* Give way to the messages of the higher lanes. */
+			if (l > 0 && os_queue_pending(q, l) > 0)
+				break;
+		}
+
+		/* Count the processed messages of the batch. */
+		batch = i;
+
+		/* Resume the producers waiting for a free place in the lane. */
+		waiting = atomic_load(&lane->waiting);
+		for (i = 0; i < waiting && i < batch; i++)
+			os_sem_release(&lane->space_c);
+
+		/* Test the thread state. */
+		state = atomic_load(&thread->state);
+		if (state != OS_THREAD_READY)
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * os_thread_suspend() - suspend the thread, if the message queue is empty:
+ * the thread parks on the futex word without polling.
+ *
+ * @thread:  reference to os_thread.
+ *
+ * Return:	0, if the thread state != OS_THREAD_READY.
+ **/
+static int os_thread_suspend(os_thread_t *thread)
+{
+	os_thread_state_t state;
+	os_queue_t *q;
+	int idle;
+
+	/* Get the reference to the thread input queue. */
+	q = &thread->queue;
+
+	/* Announce the suspension to the producers, which will resume the
+	 * thread after the insertion of a new message. */
+	atomic_store(&q->run_state, OS_QUEUE_IDLE);
+
+	/* Test the thread state. */
+	state = atomic_load(&thread->state);
+	if (state != OS_THREAD_READY)
+		return 0;
+
+	/* Change the thread state to parked, if the queue is still empty and no
+	 * producer has resumed the thread in the meantime. */
+	idle = OS_QUEUE_IDLE;
+	if (os_queue_pending(q, OS_QUEUE_LANES) < 1 &&
+	    atomic_compare_exchange_strong(&q->run_state, &idle,
+					   OS_QUEUE_PARKED)) {
+		/* Print the suspend information. */
+		OS_TRACE(("%s [t=%s,s=%d,o=suspend]\n", OS, thread->name, state));
+
+		/* Suspend the thread. */
+		while (atomic_load(&q->run_state) == OS_QUEUE_PARKED)
+			os_futex_wait(&q->run_state, OS_QUEUE_PARKED);
+
+		/* Print the resume information. */
+		OS_TRACE(("%s [t=%s,s=%d,o=resume]\n", OS, thread->name, state));
+	}
+
+	/* Change the thread state to running. */
+	atomic_store(&q->run_state, OS_QUEUE_RUNNING);
+
+	/* Test the thread state. */
+	state = atomic_load(&thread->state);
+	if (state != OS_THREAD_READY)
+		return 0;
+		
+	return 1;
+}
+
+/**
+ * os_thread_lookup() - map the table index to the installed thread without
+ * lock.
+ *
+ * @idx:  index of the thread table.
+ *
+ * Return:	the pointer to the table entry or NULL, if the entry is not in use.
+ **/
+static os_thread_elem_t *os_thread_lookup(int idx)
+{
+	os_thread_elem_t *chunk, *elem;
+	os_thread_dir_t *dir;
+
+	/* Get the current chunk directory. */
+	dir = atomic_load(&os_thread_list.dir);
+	if (idx < 0 || dir == NULL || idx / OS_THREAD_LIMIT >= dir->size)
+		return NULL;
+
+	/* Get the chunk of the table entry. */
+	chunk = atomic_load(&dir->chunk[idx / OS_THREAD_LIMIT]);
+	if (chunk == NULL)
+		return NULL;
+
+	/* Test the state of the table entry. */
+	elem = &chunk[idx % OS_THREAD_LIMIT];
+	if (! atomic_load(&elem->is_in_use))
+		return NULL;
+
+	return elem;
+}
+
+/**
+ * os_thread_grow() - add a chunk to the thread table and replace the full
+ * chunk directory. The caller holds the list mutex.
+ *
+ * @list:  pointer to the thread list.
+ * @idx:   index of the first entry of the new chunk.
+ *
+ * Return:	None.
+ **/
+static void os_thread_grow(struct os_thread_list_s *list, int idx)
+{
+	os_thread_dir_t *dir, *old;
+	os_thread_elem_t *chunk;
+	int i, size;
+
+	/* Get the current chunk directory. */
+	old = atomic_load(&list->dir);
+
+	/* Test the capacity of the chunk directory. */
+	if (old == NULL || idx / OS_THREAD_LIMIT >= old->size) {
+		/* Double the chunk directory. */
+		size = old == NULL ? 4 : 2 * old->size;
+		dir = malloc(sizeof(*dir) + size * sizeof(dir->chunk[0]));
+		OS_TRAP_IF(dir == NULL);
+
+		dir->prev = old;
+		dir->size = size;
+		for (i = 0; i < size; i++) {
+			chunk = old && i < old->size ?
+				atomic_load(&old->chunk[i]) : NULL;
+			atomic_init(&dir->chunk[i], chunk);
+		}
+
+		/* Publish the new chunk directory. */
+		atomic_store(&list->dir, dir);
+	}
+
+	/* Create the chunk of the table entries. */
+	chunk = calloc(OS_THREAD_LIMIT, sizeof(os_thread_elem_t));
+	OS_TRAP_IF(chunk == NULL);
+
+	/* Publish the chunk. */
+	dir = atomic_load(&list->dir);
+	atomic_store(&dir->chunk[idx / OS_THREAD_LIMIT], chunk);
+}
+
+/**
+ * os_pthread_once_init() - init_routine for pthread_once.
+ *
+ * Return:	None.
+ **/
+static void os_pthread_once_init(void)
+{
+	int ret;
+
+	/* The first call to pthread_once() by any thread in a process, with a
+	 * given once_control, will call the init_routine() with no arguments.
+	 * Subsequent calls of pthread_once() with the same once_control will
+	 * not call the init_routine(). On return from pthread_once(), it is
+	 * guaranteed that init_routine() has completed. The once_contro
+	 *l parameter is used to determine whether the associated initialisation
+	 * routine has been called. */
+
+	/* Create a data key visible to all theads in the process. */
+	ret = pthread_key_create(&os_thread_list.key, NULL);
+	OS_TRAP_IF(ret != 0);
+}
+
+/**
+ * os_thread_save() - save the thread pointer.
+ *
+ * @thread:  reference to os_thread.
+ *
+ * Return:	None.
+ **/
+static void os_thread_save(os_thread_t *thread)
+{
+	pthread_key_t key;
+	int ret;
+	
+	/* Initialze the os_thread_list.key once. */
+	ret = pthread_once(&os_thread_list.once_c, os_pthread_once_init);
+	OS_TRAP_IF(ret != 0);
+
+	/* Copy the key. */
+	key = os_thread_list.key;
+
+	/* Get the reference to the os_thread. */
+	if (pthread_getspecific(key) == NULL) {
+		/* Associate the os_thread with key. */
+		ret = pthread_setspecific(key, thread);
+		OS_TRAP_IF(ret != 0);
+	}
+}
+
+/**
+ * os_thread_cb() - callback for the thread context.
+ *
+ * @arg:  generic reference to os_thread.
+ *
+ * Return:	NULL.
+ **/
+static void *os_thread_cb(void *arg)
+{
+	os_thread_t *thread;
+
+	/* Entry condition. */
+	OS_TRAP_IF(arg == NULL);
+	
+	/* Decode the reference to the os_thread. */
+	thread = arg;
+	
+	/* Save the thread pointer. */
+	os_thread_save(thread);
+
+	/* Change the os_thread state. */
+	OS_TRACE(("%s [t=%s,s=ready,o=create]\n", OS, thread->name));
+	atomic_store(&thread->state, OS_THREAD_READY);
+
+	/* Resume the caller of os_thread_create. */
+	os_sem_release(&thread->suspend_p);
+
+	/* Loop thru the thread callback. */
+	for (;;)  {
+		/* Suspend the thread, if the message queue is empty. */
+		if (! os_thread_suspend(thread))
+			break;
+
+		/* Loop over the message queue. */
+		if (! os_queue_loop(thread))
+			break;
+	}
+	
+	/* Release the parent thread in os_thread_destroy. */
+	os_sem_release(&thread->suspend_p);
+	
+	return NULL;
+}
+
+/**
+ * os_queue_release() - release the queue resources.
+ *
+ * @q:  pointer to the OS thread queue.
+ *
+ * Return:	None.
+ **/
+static void os_queue_release(os_queue_t *q)
+{
+	os_queue_elem_t *elem;
+	int i, l;
+
+	/* Loop over the priority lanes. */
+	for (l = 0; l < OS_QUEUE_LANES; l++) {
+		/* Free pending messages; the producers have already been
+		 * stopped. */
+		for (i = 0; (elem = os_queue_pop(&q->lane[l])) != NULL; i++) {
+			/* Return the message buffer to the pool. */
+			os_queue_slot_put(q, elem);
+		}
+
+		/* Test the lane state. */
+		OS_TRAP_IF(i != atomic_load(&q->lane[l].queued));
+
+		/* Release the lane OS resources. */
+		os_sem_delete(&q->lane[l].space_c);
+	}
+
+	/* Release the message pool. */
+	OS_FREE(q->pool.mem);
+}
+
+/**
+ * os_thread_free() - release the queue and thread resources.
+ *
+ * @thread:  pointer to the os_thread.
+ *
+ * Return:	None.
+ **/
+static void os_thread_free(os_thread_t *thread)
+{
+	struct os_thread_list_s *list;
+	os_thread_elem_t *elem;
+	int ret;
+	
+	/* Release the queue resources. */
+	os_queue_release(&thread->queue);
+	
+	/* Free the thread resources. */
+	ret = pthread_attr_destroy(&thread->attr);
+	OS_TRAP_IF(ret != 0);
+	
+	os_sem_delete(&thread->suspend_p);
+
+	/* Release the thread element. */
+	list = &os_thread_list;
+
+	/* Get the address of the thread list element. */
+	elem = os_thread_lookup(thread->idx);
+
+	/* Test the thread state. */
+	OS_TRAP_IF(elem == NULL);
+
+	/* Enter the critical section. */
+	os_cs_enter(&list->protect);
+
+	/* Increase the capacity of the index stack. */
+	if (list->free_n >= list->free_size) {
+		list->free_size = list->limit;
+		list->free = realloc(list->free, list->free_size * sizeof(int));
+		OS_TRAP_IF(list->free == NULL);
+	}
+
+	/* Save the released index. */
+	list->free[list->free_n++] = elem->idx;
+
+	/* Reset the thread index. */
+	thread->idx = -1;
+	
+	/* Update the list state. */
+	atomic_store(&elem->is_in_use, 0);
+	atomic_fetch_sub(&list->count, 1);
+
+	/* Leave the critical section. */
+	os_cs_leave(&list->protect);
+}
+
+/**
+ * os_queue_pool_init() - create the message buffers of the queue. One
+ * buffer more than the queue limit is needed, because the consumer returns the
+ * buffer after the message processing. Beyond OS_QUEUE_LIMIT the buffers come
+ * from the heap.
+ *
+ * @p:       pointer to the message pool.
+ * @q_size:  max. number of the input queue messages.
+ *
+ * Return:	None.
+ **/
+static void os_queue_pool_init(os_queue_pool_t *p, int q_size)
+{
+	os_queue_slot_t *slot;
+	int i;
+
+	/* Request the memory for all message buffers at once. */
+	p->count = (q_size < OS_QUEUE_LIMIT ? q_size : OS_QUEUE_LIMIT) + 1;
+	p->mem   = OS_MALLOC(p->count * OS_QUEUE_SLOT_STRIDE);
+
+	/* Link the message buffers to the free list. */
+	for (i = 0; i < p->count; i++) {
+		slot = (os_queue_slot_t *) (p->mem + i * OS_QUEUE_SLOT_STRIDE);
+		slot->idx = i + 1;
+		atomic_init(&slot->next, i + 2 > p->count ? 0 : i + 2);
+	}
+
+	/* The list starts with the first buffer. */
+	atomic_init(&p->free, 1);
+}
+
+/**
+ * os_queue_init() - initialize the input queue of the thread.
+ *
+ * @thread:  pointer to the os_thread.
+ * @q_size:  max. number of the input queue messages.
+ *
+ * Return:	None.
+ **/
+static void os_queue_init(os_thread_t *thread, int q_size)
+{
+	os_queue_fifo_t *lane;
+	os_queue_t *q;
+	int l;
+
+	/* Entry condition. */
+	OS_TRAP_IF(q_size < 1);
+	
+	/* Get the reference to the  os_queue. */
+	q = &thread->queue;
+
+	/* Loop over the priority lanes. */
+	for (l = 0, lane = q->lane; l < OS_QUEUE_LANES; l++, lane++) {
+		/* Initialize the lane with the empty queue element. */
+		atomic_init(&lane->anchor.next, NULL);
+		atomic_init(&lane->head, &lane->anchor);
+		lane->tail = &lane->anchor;
+
+		/* Initialize the boundary conditions of the lane. */
+		atomic_init(&lane->limit, q_size);
+		atomic_init(&lane->count, 0);
+		atomic_init(&lane->queued, 0);
+
+		/* Create the producer control semaphore of the lane. */
+		os_sem_init(&lane->space_c, 0);
+		atomic_init(&lane->waiting, 0);
+	}
+
+	/* Reset the queue state. */
+	atomic_init(&q->run_state, OS_QUEUE_RUNNING);
+	q->latency    = 0;
+	atomic_init(&q->busy_send, 0);
+
+	/* Create the message buffers. */
+	os_queue_pool_init(&q->pool, q_size);
+}
+
+/**
+ * os_thread_alloc() - allocate a os_thread.
+ *
+ * @q_size:  max. number of the input queue messages.
+ *
+ * Return:	the pointer to the allocated thread.
+ **/
+static os_thread_t *os_thread_alloc(int q_size)
+{
+	struct os_thread_list_s *list;
+	os_thread_elem_t *elem;
+	os_thread_dir_t *dir;
+	int i;
+
+	/* Get the address of the thread list. */
+	list = &os_thread_list;
+	
+	/* Enter the critical section. */
+	os_cs_enter(&list->protect);
+	
+	/* Reuse the last released table entry. */
+	if (list->free_n > 0) {
+		i = list->free[--list->free_n];
+	}
+	else {
+		/* Take the next unused table entry. */
+		i = list->limit++;
+
+		/* Add a chunk to the table, if the previous chunk is full. */
+		if (i % OS_THREAD_LIMIT == 0)
+			os_thread_grow(list, i);
+	}
+
+	/* Get the address of the table entry. */
+	dir  = atomic_load(&list->dir);
+	elem = &atomic_load(&dir->chunk[i / OS_THREAD_LIMIT])[i % OS_THREAD_LIMIT];
+
+	/* Reset the thread state. */
+	os_memset(elem, 0, sizeof(os_thread_elem_t));
+	
+	/* Allocate a thread list element. */
+	elem->idx = i;
+	
+	/* Save the index. */
+	elem->thread.idx = i;
+
+	/* Publish the table entry. */
+	atomic_store(&elem->is_in_use, 1);
+	atomic_fetch_add(&list->count, 1);
+
+	/* Leave the critical section. */
+	os_cs_leave(&list->protect);
+
+	/* Initialize the input queue of the thread. */
+	os_queue_init(&elem->thread, q_size);
+	
+	return &elem->thread;
+}
+
+/**
+ * os_thread_prio() - calculate the thread priority.
+ *
+ * @prio:  thread priority.
+ *
+ * Return:	the updated thread priority.
+ **/
+static os_thread_prio_t os_thread_prio(os_thread_prio_t prio)
+{
+	/* Test the thread priority. */
+	switch(prio) {
+	case OS_THREAD_PRIO_HARDRT:
+	case OS_THREAD_PRIO_SOFTRT:
+	case OS_THREAD_PRIO_BACKG:
+	case OS_THREAD_PRIO_FOREG:
+		return prio;
+	default:
+		return OS_THREAD_PRIO_DEFAULT;
+	}
+}
+
+/**
+ * os_thread_policy() - map the scheduling policy to the pthread policy.
+ *
+ * @policy:  scheduling policy of the os_thread.
+ *
+ * Return:	the pthread policy like SCHED_RR.
+ **/
+static int os_thread_policy(os_thread_policy_t policy)
+{
+	/* Test the scheduling policy. */
+	switch(policy) {
+	case OS_THREAD_POLICY_FIFO:
+		return SCHED_FIFO;
+	case OS_THREAD_POLICY_RR:
+		return SCHED_RR;
+	case OS_THREAD_POLICY_OTHER:
+		return SCHED_OTHER;
+	default:
+		OS_TRAP();
+		return SCHED_OTHER;
+	}
+}
+
+/**
+ * os_thread_attr_set() - transfer the scheduling attributes to the pthread
+ * attributes of the os_thread.
+ *
+ * @thread:  pointer to the os_thread.
+ * @attr:    requested scheduling attributes.
+ *
+ * Return:	None.
+ **/
+static void os_thread_attr_set(os_thread_t *thread, os_thread_attr_t *attr)
+{
+	struct sched_param p;
+	cpu_set_t cpus;
+	int i, n, policy, ret;
+
+	/* Initialize the thread attributes with default values. */
+	ret = pthread_attr_init(&thread->attr);
+	OS_TRAP_IF(ret != 0);
+
+	/* Test the origin of the scheduling policy. */
+	if (attr->policy != OS_THREAD_POLICY_INHERIT) {
+		/* Take the scheduling attributes from thread->attr. */
+		ret = pthread_attr_setinheritsched(&thread->attr,
+						   PTHREAD_EXPLICIT_SCHED);
+		OS_TRAP_IF(ret != 0);
+
+		/* Set the scheduling policy attribute. */
+		policy = os_thread_policy(attr->policy);
+		ret = pthread_attr_setschedpolicy(&thread->attr, policy);
+		OS_TRAP_IF(ret != 0);
+
+		/* Define the thread priority. */
+		p.sched_priority = attr->prio;
+		ret = pthread_attr_setschedparam(&thread->attr, &p);
+		OS_TRAP_IF(ret != 0);
+	}
+
+	/* Define the size of the thread stack. */
+	if (attr->stack_size > 0) {
+		ret = pthread_attr_setstacksize(&thread->attr, attr->stack_size);
+		OS_TRAP_IF(ret != 0);
+	}
+
+	/* Convert the CPU set. */
+	CPU_ZERO(&cpus);
+	for (i = 0, n = 0; i < OS_THREAD_CPU_N && i < CPU_SETSIZE; i++) {
+		if (OS_CPU_ISSET(i, attr->cpu_set)) {
+			CPU_SET(i, &cpus);
+			n++;
+		}
+	}
+
+	/* Pin the thread to the CPU set. */
+	if (n > 0) {
+		ret = pthread_attr_setaffinity_np(&thread->attr, sizeof(cpus),
+						  &cpus);
+		OS_TRAP_IF(ret != 0);
+	}
+}
+
+/**
+ * os_thread_attr_read() - save the effective scheduling attributes of the
+ * running os_thread.
+ *
+ * @thread:  pointer to the os_thread.
+ *
+ * Return:	None.
+ **/
+static void os_thread_attr_read(os_thread_t *thread)
+{
+	struct sched_param p;
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	os_thread_attr_t *eff;
+	int i, policy, ret;
+
+	/* Get the reference to the effective attributes. */
+	eff = &thread->eff;
+
+	/* Read the scheduling policy and priority. */
+	ret = pthread_getschedparam(thread->pthread, &policy, &p);
+	OS_TRAP_IF(ret != 0);
+
+	switch(policy) {
+	case SCHED_FIFO:
+		eff->policy = OS_THREAD_POLICY_FIFO;
+		break;
+	case SCHED_RR:
+		eff->policy = OS_THREAD_POLICY_RR;
+		break;
+	default:
+		eff->policy = OS_THREAD_POLICY_OTHER;
+		break;
+	}
+
+	eff->prio = p.sched_priority;
+
+	/* Copy the latency recording. */
+	eff->latency = thread->queue.latency;
+
+	/* Read the CPU set. */
+	ret = pthread_getaffinity_np(thread->pthread, sizeof(cpus), &cpus);
+	OS_TRAP_IF(ret != 0);
+
+	os_memset(eff->cpu_set, 0, sizeof(eff->cpu_set));
+	for (i = 0; i < OS_THREAD_CPU_N && i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET(i, &cpus))
+			OS_CPU_SET(i, eff->cpu_set);
+	}
+
+	/* Read the size of the thread stack. */
+	ret = pthread_getattr_np(thread->pthread, &attr);
+	OS_TRAP_IF(ret != 0);
+
+	ret = pthread_attr_getstacksize(&attr, &eff->stack_size);
+	OS_TRAP_IF(ret != 0);
+
+	ret = pthread_attr_destroy(&attr);
+	OS_TRAP_IF(ret != 0);
+}
+
+/**
+ * os_queue_wait_send() - save a copy of the message in a priority lane of the
+ * os_thread queue and suspend the producer for a limited time, while the lane
+ * is full.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @lane:      priority lane of the message.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
+ * @ms:        max. waiting time for a free place in milliseconds.
+ *
+ * Return:	0, if the message has been saved, or -1, if the lane is still
+ * full after the waiting time.
+ **/
+static int os_queue_wait_send(void *g_thread, os_queue_lane_t lane,
+			      os_queue_elem_t *msg, int size, int ms)
+{
+	struct timespec     start, now;
+	os_thread_t        *thread;
+	os_thread_state_t   state;
+	os_queue_fifo_t    *fifo;
+	os_queue_t         *q;
+	int                 rest, ret;
+	
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || msg == NULL || ms < 0 ||
+		   size < sizeof(os_queue_elem_t) || msg->cb == NULL ||
+		   lane < OS_QUEUE_LANE_HIGH || lane >= OS_QUEUE_LANES);
+
+	/* Decode the reference to the os_thread. */
+	thread = g_thread;
+
+	/* Get the reference to the message queue and the lane. */
+	q    = &thread->queue;
+	fifo = &q->lane[lane];
+
+	/* Change the state of this operation. */
+	atomic_store(&q->busy_send, 1);
+	
+	/* Test the thread state. */
+	state = atomic_load(&thread->state);
+	OS_TRAP_IF(state != OS_THREAD_READY);
+
+	/* Save the start of the waiting time. */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* Wait for a free place in the queue. */
+	for (;;) {
+		/* Reserve a place in the lane. */
+		ret = os_queue_reserve(fifo);
+		if (ret == 0)
+			break;
+
+		/* Calculate the remaining waiting time. */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		rest = ms - (int) ((now.tv_sec - start.tv_sec) * 1000 +
+				   (now.tv_nsec - start.tv_nsec) / 1000000);
+		if (rest <= 0)
+			break;
+
+		/* Announce the waiting producer to the consumer. */
+		atomic_fetch_add(&fifo->waiting, 1);
+
+		/* Test the lane again, the consumer may have missed the
+		 * announcement. */
+		ret = os_queue_reserve(fifo);
+		if (ret != 0)
+			os_sem_timedwait(&fifo->space_c, rest);
+
+		/* Withdraw the announcement. */
+		atomic_fetch_sub(&fifo->waiting, 1);
+
+		/* Test the reservation before the waiting. */
+		if (ret == 0)
+			break;
+	}
+
+	/* Save the copy of the message. */
+	if (ret == 0)
+		os_queue_copy(q, lane, msg, size);
+
+	/* Change the state of this operation. */
+	atomic_store(&q->busy_send, 0);	
+
+	return ret;
+}
+
+
+/*============================================================================
+  EXPORTED FUNCTIONS
+  ============================================================================*/
+/**
+ * os_thread_create() - create a thread and the input queue. The thread takes
+ * over the scheduling policy of the creator.
+ *
+ * @name:    name of the thread.
+ * @prio:    thread priority.
+ * @q_size:  max. number of the input queue messages.
+ *
+ * Return:     the generic pointer to the os_thread.
+ **/
+void *os_thread_create(const char *name, os_thread_prio_t prio, int q_size)
+{
+	os_thread_attr_t attr;
+
+	/* Define the scheduling attributes. */
+	os_memset(&attr, 0, sizeof(attr));
+	attr.policy = OS_THREAD_POLICY_INHERIT;
+	attr.prio   = os_thread_prio(prio);
+
+	return os_thread_create_ext(name, &attr, q_size);
+}
+
+/**
+ * os_thread_create_ext() - create a thread and the input queue with the
+ * requested CPU set, scheduling policy, priority and stack size. If the caller
+ * may not use a realtime policy, the thread takes over the policy of the
+ * creator; os_thread_attr_get provides the effective values.
+ *
+ * @name:    name of the thread.
+ * @attr:    scheduling attributes of the thread.
+ * @q_size:  max. number of the input queue messages.
+ *
+ * Return:     the generic pointer to the os_thread.
+ **/
+void *os_thread_create_ext(const char *name, os_thread_attr_t *attr, int q_size)
+{
+	os_thread_t  *thread;
+	int len, ret, c_type, orig_c;
+
+	/* Entry condition. */
+	OS_TRAP_IF(name == NULL || attr == NULL ||
+		   attr->latency < 0 || attr->latency > 1 ||
+		   attr->policy < OS_THREAD_POLICY_INHERIT ||
+		   attr->policy > OS_THREAD_POLICY_RR);
+
+	/* Test the priority range of the policy. */
+	if (attr->policy != OS_THREAD_POLICY_INHERIT) {
+		ret = os_thread_policy(attr->policy);
+		OS_TRAP_IF(attr->prio < sched_get_priority_min(ret) ||
+			   attr->prio > sched_get_priority_max(ret));
+	}
+
+	/* Allocate the os_thread. */
+	thread = os_thread_alloc(q_size);
+	
+	/* Save the thread name. */
+	len = os_strlen(name);
+	OS_TRAP_IF(len >= OS_THREAD_NAME_LEN);
+	os_memset(thread->name, 0, OS_THREAD_NAME_LEN);
+	os_strcpy(thread->name, OS_THREAD_NAME_LEN, name);
+
+	/* Initialize the thread state. */
+	OS_TRACE(("%s [t=%s,s=boot,o=create]\n", OS, thread->name));
+	atomic_store(&thread->state, OS_THREAD_BOOT);
+	
+	/* Save the thread prioriiy. */
+	thread->prio = attr->prio;
+
+	/* Save the latency recording of the input queue. */
+	thread->queue.latency = attr->latency;
+
+	/* Define the pthread attributes. */
+	os_thread_attr_set(thread, attr);
+
+	/* Create the control semaphore for os_thread_delete. */
+	os_sem_init(&thread->suspend_p, 0);
+	
+	/* Set the cancelability type. */
+	c_type = PTHREAD_CANCEL_ENABLE;
+	ret = pthread_setcancelstate(c_type, &orig_c);
+	OS_TRAP_IF(ret != 0);
+
+	/* Create the pthread. */
+	ret = pthread_create(&thread->pthread, &thread->attr, os_thread_cb, thread);
+
+	/* Without privileges keep the scheduling policy of the creator. */
+	if (ret == EPERM && attr->policy != OS_THREAD_POLICY_INHERIT) {
+		OS_TRACE(("%s [t=%s,s=boot,o=inherit]\n", OS, thread->name));
+		ret = pthread_attr_setinheritsched(&thread->attr,
+						   PTHREAD_INHERIT_SCHED);
+		OS_TRAP_IF(ret != 0);
+
+		ret = pthread_create(&thread->pthread, &thread->attr,
+				     os_thread_cb, thread);
+	}
+
+	OS_TRAP_IF(ret != 0);
+
+	/* Wait for the start of the thread. */
+	os_sem_wait(&thread->suspend_p);
+
+	/* Save the effective scheduling attributes. */
+	os_thread_attr_read(thread);
+	
+	return thread;
+}
+
+/**
+ * os_thread_attr_get() - provide the effective scheduling attributes of the
+ * os_thread.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @attr:      address of the effective attributes.
+ *
+ * Return:	None.
+ **/
+void os_thread_attr_get(void *g_thread, os_thread_attr_t *attr)
+{
+	os_thread_t  *thread;
+	
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || attr == NULL);
+
+	/* Decode the reference to the thread state. */
+	thread = g_thread;
+	
+	/* Test the list index. */
+	OS_TRAP_IF(os_thread_lookup(thread->idx) == NULL);
+
+	/* Copy the effective attributes. */
+	*attr = thread->eff;
+}
+
+/**
+ * os_thread_stats() - provide the telemetry of the os_thread input queue.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @stats:     address of the telemetry copy.
+ *
+ * Return:	None.
+ **/
+void os_thread_stats(void *g_thread, os_thread_stats_t *stats)
+{
+	os_thread_t *thread;
+	int l;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || stats == NULL);
+
+	/* Decode the reference to the thread state. */
+	thread = g_thread;
+	
+	/* Test the list index. */
+	OS_TRAP_IF(os_thread_lookup(thread->idx) == NULL);
+
+	/* Sum up the telemetry of the priority lanes. */
+	os_memset(stats, 0, sizeof(os_thread_stats_t));
+	for (l = 0; l < OS_QUEUE_LANES; l++)
+		os_queue_stat_add(&thread->queue.lane[l], stats);
+}
+
+/**
+ * os_thread_lane_stats() - provide the telemetry of a priority lane of the
+ * os_thread input queue.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @lane:      priority lane of the input queue.
+ * @stats:     address of the telemetry copy.
+ *
+ * Return:	None.
+ **/
+void os_thread_lane_stats(void *g_thread, os_queue_lane_t lane,
+			  os_thread_stats_t *stats)
+{
+	os_thread_t *thread;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || stats == NULL ||
+		   lane < OS_QUEUE_LANE_HIGH || lane >= OS_QUEUE_LANES);
+
+	/* Decode the reference to the thread state. */
+	thread = g_thread;
+	
+	/* Test the list index. */
+	OS_TRAP_IF(os_thread_lookup(thread->idx) == NULL);
+
+	/* Copy the telemetry of the lane. */
+	os_memset(stats, 0, sizeof(os_thread_stats_t));
+	os_queue_stat_add(&thread->queue.lane[lane], stats);
+}
+
+/**
+ * os_thread_stats_dump() - print the telemetry of all installed os_threads.
+ *
+ * Return:	None.
+ **/
+void os_thread_stats_dump(void)
+{
+	struct os_thread_list_s *list;
+	os_thread_elem_t *elem;
+	os_thread_stats_t st;
+	int i, j;
+
+	/* Get the address of the thread list. */
+	list = &os_thread_list;
+
+	/* Enter the critical section. */
+	os_cs_enter(&list->protect);
+
+	/* Loop over the used table entries. */
+	for (i = 0; i < list->limit; i++) {
+		/* Test the state of the table entry. */
+		elem = os_thread_lookup(i);
+		if (elem == NULL)
+			continue;
+
+		/* Print the telemetry of the thread. */
+		os_thread_stats(&elem->thread, &st);
+		printf("%s [t=%s,n=%llu,d=%d,m=%d,avg=%lluns,max=%lluns]\n",
+		       OS, elem->thread.name, st.processed, st.depth,
+		       st.max_depth, st.processed ? st.lat_sum / st.processed : 0,
+		       st.lat_max);
+
+		/* Print the used latency buckets. */
+		for (j = 0; j < OS_THREAD_HIST_LEN; j++) {
+			if (st.hist[j] > 0)
+				printf("%s   <%lluns: %llu\n", OS, 1ULL << j,
+				       st.hist[j]);
+		}
+	}
+
+	/* Leave the critical section. */
+	os_cs_leave(&list->protect);
+}
+
+/**
+ * os_queue_alloc() - reserve a place in the default lane of the os_thread
+ * queue and provide a message buffer, which the caller fills in place and
+ * transfers with os_queue_post or gives back with os_queue_free.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @size:      size of the message.
+ *
+ * Return:	the message buffer with a cleared message header.
+ **/
+os_queue_elem_t *os_queue_alloc(void *g_thread, int size)
+{
+	os_thread_t        *thread;
+	os_thread_state_t   state;
+	os_queue_elem_t    *elem;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || size < sizeof(os_queue_elem_t));
+
+	/* Decode the reference to the os_thread. */
+	thread = g_thread;
+
+	/* Test the thread state. */
+	state = atomic_load(&thread->state);
+	OS_TRAP_IF(state != OS_THREAD_READY);
 
-	/* Free pending messages. */
-	for (i = 0; elem != &q->stopper; i++) {
-		/* Save the reference to the successor. */
-		next = elem->next;
-		
-		/* Free the message buffer. */
-		OS_FREE(elem);
+	/* Reserve a place in the default lane. */
+	os_queue_acquire(thread, OS_QUEUE_LANE_NORM);
 
-		/* Continue with the next element. */
-		elem = next;
-	}
+	/* Take a message buffer from the pool. */
+	elem = os_queue_slot_get(&thread->queue, size);
 
-	/* Test the queue state. */
-	OS_TRAP_IF(i != q->count);
+	/* Reset the message header. */
+	atomic_init(&elem->next, NULL);
+	elem->param = NULL;
+	elem->cb    = NULL;
 
-	/* Release the queue OS resources. */
-	os_spin_destroy(&q->protect);
-	os_sem_delete(&q->suspend_c);
+	return elem;
 }
 
 /**
- * os_thread_free() - release the queue and thread resources.
+ * os_queue_post() - save the message buffer from os_queue_alloc in the
+ * os_thread queue without copy, which has reserved the place for it. The
+ * ownership of the buffer passes to the receiver, which releases it after the
+ * message processing.
  *
- * @thread:  pointer to the os_thread.
+ * @g_thread:  generic address of the os_thread.
+ * @elem:      message buffer from os_queue_alloc of this os_thread.
  *
  * Return:	None.
  **/
-static void os_thread_free(os_thread_t *thread)
+void os_queue_post(void *g_thread, os_queue_elem_t *elem)
 {
-	struct os_thread_list_s *list;
-	os_thread_elem_t *elem;
-	int ret;
-	
-	/* Release the queue resources. */
-	os_queue_free(&thread->queue);
-	
-	/* Free the thread resources. */
-	ret = pthread_attr_destroy(&thread->attr);
-	OS_TRAP_IF(ret != 0);
-	
-	os_sem_delete(&thread->suspend_p);
+	os_thread_t        *thread;
+	os_thread_state_t   state;
+	os_queue_t         *q;
 
-	/* Release the thread element. */
-	list = &os_thread_list;
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || elem == NULL || elem->cb == NULL);
 
-	/* Get the address of the thread list element. */
-	elem = &list->elem[thread->idx];
+	/* Decode the reference to the os_thread. */
+	thread = g_thread;
 
-	/* Enter the critical section. */
-	os_cs_enter(&list->protect);
+	/* Get the reference to the message queue. . */
+	q = &thread->queue;
 
-	/* Test the thread state. */
-	OS_TRAP_IF(! elem->is_in_use);
+	/* The buffer shall come from the pool of this queue. */
+	OS_TRAP_IF(OS_QUEUE_SLOT(elem)->owner != q);
 
-	/* Reset the thread index. */
-	thread->idx = -1;
+	/* Change the state of this operation. */
+	atomic_store(&q->busy_send, 1);
 	
-	/* Update the list state. */
-	elem->is_in_use = 0;
-	list->count--;
+	/* Test the thread state. */
+	state = atomic_load(&thread->state);
+	OS_TRAP_IF(state != OS_THREAD_READY);
 
-	/* Leave the critical section. */
-	os_cs_leave(&list->protect);
+	/* Insert the message buffer and resume the thread. */
+	os_queue_insert(q, OS_QUEUE_LANE_NORM, elem);
+
+	/* Change the state of this operation. */
+	atomic_store(&q->busy_send, 0);	
 }
 
 /**
- * os_queue_init() - initialize the input queue of the thread.
+ * os_queue_free() - give back an unused message buffer from os_queue_alloc
+ * and release its place in the default lane of the os_thread queue.
  *
- * @thread:  pointer to the os_thread.
- * @q_size:  max. number of the input queue messages.
+ * @g_thread:  generic address of the os_thread.
+ * @elem:      message buffer from os_queue_alloc of this os_thread.
  *
  * Return:	None.
  **/
-static void os_queue_init(os_thread_t *thread, int q_size)
+void os_queue_free(void *g_thread, os_queue_elem_t *elem)
 {
-	os_queue_t  *q;
+	os_thread_t      *thread;
+	os_queue_fifo_t  *lane;
+	os_queue_t       *q;
 
 	/* Entry condition. */
-	OS_TRAP_IF(q_size >= OS_QUEUE_LIMIT);
-	
-	/* Get the reference to the  os_queue. */
-	q = &thread->queue;
+	OS_TRAP_IF(g_thread == NULL || elem == NULL);
 
-	/* Initialize the spinlock. */
-	os_spin_init(&q->protect);
+	/* Decode the reference to the os_thread. */
+	thread = g_thread;
 
-	/* Create the thread control semaphore. */
-	os_sem_init(&q->suspend_c, 0);
+	/* Get the reference to the message queue and the default lane. */
+	q    = &thread->queue;
+	lane = &q->lane[OS_QUEUE_LANE_NORM];
 
-	/* Initialize the input queue. */
-	q->anchor.next  = &q->stopper;
-	q->stopper.next = &q->anchor;
+	/* The buffer shall come from the pool of this queue. */
+	OS_TRAP_IF(OS_QUEUE_SLOT(elem)->owner != q);
 
-	/* Initialize the boundary conditions of a thread input queue. */
-	q->limit = q_size;
-	q->count = 0;
+	/* Return the message buffer to the pool. */
+	os_queue_slot_put(q, elem);
 
-	/* Reset the queue state. */
-	q->is_running = 0;
-	q->busy_send  = 0;
+	/* Release the reserved place and resume a waiting producer. */
+	atomic_fetch_sub(&lane->count, 1);
+	if (atomic_load(&lane->waiting) > 0)
+		os_sem_release(&lane->space_c);
 }
 
 /**
- * os_thread_alloc() - allocate a os_thread.
+ * os_queue_send_lane() - save a copy of the message in a priority lane of the
+ * os_thread queue and stop the process, if the lane is full.
  *
- * @q_size:  max. number of the input queue messages.
+ * @g_thread:  generic address of the os_thread.
+ * @lane:      priority lane of the message.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
  *
- * Return:	the pointer to the allocated thread.
+ * Return:	None.
  **/
-static os_thread_t *os_thread_alloc(int q_size)
+void os_queue_send_lane(void *g_thread, os_queue_lane_t lane,
+			os_queue_elem_t *msg, int size)
 {
-	struct os_thread_list_s *list;
-	os_thread_elem_t *elem;
-	int i;
-
-	/* Get the address of the thread list. */
-	list = &os_thread_list;
+	os_thread_t        *thread;
+	os_thread_state_t   state;
+	os_queue_t         *q;
 	
-	/* Get the address of the first list element. */
-	elem = list->elem;
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || msg == NULL ||
+		   size < sizeof(os_queue_elem_t) || msg->cb == NULL ||
+		   lane < OS_QUEUE_LANE_HIGH || lane >= OS_QUEUE_LANES);
 
-	/* Enter the critical section. */
-	os_cs_enter(&list->protect);
-	
-	/* Search for a free table entry. */
-	for (i = 0; i < OS_THREAD_LIMIT && elem->is_in_use; i++, elem++)
-		;
+	/* Decode the reference to the os_thread. */
+	thread = g_thread;
 
-	/* Test the table state. */
-	OS_TRAP_IF(i >= OS_THREAD_LIMIT);
+	/* Get the reference to the message queue. . */
+	q = &thread->queue;
 
-	/* Reset the thread state. */
-	os_memset(elem, 0, sizeof(os_thread_elem_t));
+	/* Change the state of this operation. */
+	atomic_store(&q->busy_send, 1);
 	
-	/* Allocate a thread list element. */
-	elem->idx       = i;
-	elem->is_in_use = 1;
+	/* Test the thread state. */
+	state = atomic_load(&thread->state);
+	OS_TRAP_IF(state != OS_THREAD_READY);
 	
-	/* Save the index. */
-	elem->thread.idx = i;
-
-	list->count++;
+	/* Reserve a place in the lane. */
+	os_queue_acquire(thread, lane);
 
-	/* Leave the critical section. */
-	os_cs_leave(&list->protect);
+	/* Save the copy of the message. */
+	os_queue_copy(q, lane, msg, size);
 
-	/* Initialize the input queue of the thread. */
-	os_queue_init(&elem->thread, q_size);
-	
-	return &elem->thread;
+	/* Change the state of this operation. */
+	atomic_store(&q->busy_send, 0);	
 }
 
 /**
- * os_thread_prio() - calculate the thread priority.
+ * os_queue_send() - save a copy of the message in the default lane of the
+ * os_thread queue and stop the process, if the lane is full.
  *
- * @prio:  thread priority.
+ * @g_thread:  generic address of the os_thread.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
  *
- * Return:	the updated thread priority.
+ * Return:	None.
  **/
-static os_thread_prio_t os_thread_prio(os_thread_prio_t prio)
+void os_queue_send(void *g_thread, os_queue_elem_t *msg, int size)
 {
-	/* Test the thread priority. */
-	switch(prio) {
-	case OS_THREAD_PRIO_HARDRT:
-	case OS_THREAD_PRIO_SOFTRT:
-	case OS_THREAD_PRIO_BACKG:
-	case OS_THREAD_PRIO_FOREG:
-		return prio;
-	default:
-		return OS_THREAD_PRIO_DEFAULT;
-	}
+	os_queue_send_lane(g_thread, OS_QUEUE_LANE_NORM, msg, size);
 }
 
-/*============================================================================
-  EXPORTED FUNCTIONS
-  ============================================================================*/
 /**
- * os_thread_create() - create a thread and the input queue.
+ * os_queue_try_send() - save a copy of the message in the os_thread queue, if
+ * the queue is not full.
  *
- * @thread:  address of the pthread data.
- * @name:    name of the thread.
- * @prio:    thread priority.
- * @q_size:  max. number of the input queue messages.
+ * @g_thread:  generic address of the os_thread.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
  *
- * Return:     the generic pointer to the os_thread.
+ * Return:	0, if the message has been saved, or -1, if the queue is full.
  **/
-void *os_thread_create(const char *name, os_thread_prio_t prio, int q_size)
+int os_queue_try_send(void *g_thread, os_queue_elem_t *msg, int size)
 {
-	struct sched_param p;
-	os_thread_t  *thread;
-	int len, ret, c_type, orig_c;
-
-	/* Entry condition. */
-	OS_TRAP_IF(name == NULL);
-
-	/* Allocate the os_thread. */
-	thread = os_thread_alloc(q_size);
-	
-	/* Save the thread name. */
-	len = os_strlen(name);
-	OS_TRAP_IF(len >= OS_THREAD_NAME_LEN);
-	os_memset(thread->name, 0, OS_THREAD_NAME_LEN);
-	os_strcpy(thread->name, OS_THREAD_NAME_LEN, name);
-
-	/* Initialize the thread state. */
-	OS_TRACE(("%s [t=%s,s=boot,o=create]\n", OS, thread->name));
-	atomic_store(&thread->state, OS_THREAD_BOOT);
-	
-	/* Calculate the thread priority. */
-	prio = os_thread_prio(prio);
-	
-	/* Initialize the thread attributes with default values. */
-	ret = pthread_attr_init(&thread->attr);
-	OS_TRAP_IF(ret != 0);
+	return os_queue_send_timed(g_thread, msg, size, 0);
+}
 
-	/* Set the scheduling policy attribute. */
-	ret = pthread_attr_setschedpolicy(&thread->attr, SCHED_RR);
-	OS_TRAP_IF(ret != 0);
+/**
+ * os_queue_send_timed() - save a copy of the message in the os_thread queue and
+ * suspend the producer for a limited time, while the queue is full.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
+ * @ms:        max. waiting time for a free place in milliseconds.
+ *
+ * Return:	0, if the message has been saved, or -1, if the queue is still
+ * full after the waiting time.
+ **/
+int os_queue_send_timed(void *g_thread, os_queue_elem_t *msg, int size, int ms)
+{
+	return os_queue_wait_send(g_thread, OS_QUEUE_LANE_NORM, msg, size, ms);
+}
 
-	/* Define the thread priority. */
-	p.sched_priority = prio;
-	ret = pthread_attr_setschedparam(&thread->attr, &p);
-	OS_TRAP_IF(ret != 0);
+/**
+ * os_queue_try_send_lane() - save a copy of the message in a priority lane of
+ * the os_thread queue, if the lane is not full.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @lane:      priority lane of the message.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
+ *
+ * Return:	0, if the message has been saved, or -1, if the lane is full.
+ **/
+int os_queue_try_send_lane(void *g_thread, os_queue_lane_t lane,
+			   os_queue_elem_t *msg, int size)
+{
+	return os_queue_wait_send(g_thread, lane, msg, size, 0);
+}
 
-	/* Save the thread prioriiy. */
-	thread->prio = prio;
+/**
+ * os_queue_lane_limit() - change the max. number of the messages of a
+ * priority lane; the default limit is the queue size of the thread.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @lane:      priority lane of the input queue.
+ * @limit:     max. number of the lane messages.
+ *
+ * Return:	None.
+ **/
+void os_queue_lane_limit(void *g_thread, os_queue_lane_t lane, int limit)
+{
+	os_thread_t *thread;
 
-	/* Create the control semaphore for os_thread_delete. */
-	os_sem_init(&thread->suspend_p, 0);
-	
-	/* Set the cancelability type. */
-	c_type = PTHREAD_CANCEL_ENABLE;
-	ret = pthread_setcancelstate(c_type, &orig_c);
-	OS_TRAP_IF(ret != 0);
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || limit < 1 ||
+		   lane < OS_QUEUE_LANE_HIGH || lane >= OS_QUEUE_LANES);
 
-	/* Create the pthread. */
-	ret = pthread_create(&thread->pthread, NULL, os_thread_cb, thread);
-	OS_TRAP_IF(ret != 0);
+	/* Decode the reference to the os_thread. */
+	thread = g_thread;
 
-	/* Wait for the start of the thread. */
-	os_sem_wait(&thread->suspend_p);
-	
-	return thread;
+	/* Save the new limit; queued messages above it remain valid. */
+	atomic_store(&thread->queue.lane[lane].limit, limit);
 }
 
 /**
- * os_queue_send() - save the message in the os_thread queue.
+ * os_call() - save a copy of the request in the os_thread queue and suspend
+ * the caller until the receiver answers with os_reply(). The completion slot
+ * of the caller is reused, so that a round trip needs no allocation and one
+ * wakeup in each direction. The receiver may answer in its callback or pass
+ * the request to another thread, which answers later: the request buffer
+ * remains valid until os_reply.
  *
- * @g_thread:  generic address of the os_thread.
- * @msg:       reference to the message.
- * @size:      size of the message.
+ * @g_thread:    generic address of the os_thread.
+ * @msg:         reference to the request.
+ * @size:        size of the request.
+ * @reply:       buffer for the reply or NULL.
+ * @reply_size:  size of the reply buffer.
  *
- * Return:	None.
+ * Return:	the length of the saved reply.
  **/
-void os_queue_send(void *g_thread, os_queue_elem_t *msg, int size)
+int os_call(void *g_thread, os_queue_elem_t *msg, int size, void *reply,
+	    int reply_size)
 {
-	os_thread_t        *thread;
 	os_thread_state_t   state;
-	os_queue_elem_t    *elem, *stopper;
+	os_queue_elem_t    *elem;
+	os_thread_t        *thread;
 	os_queue_t         *q;
-	int                 is_running;
-	
+	os_call_t          *c;
+	int                 expected;
+
 	/* Entry condition. */
 	OS_TRAP_IF(g_thread == NULL || msg == NULL ||
-		   size < sizeof(os_queue_elem_t) || msg->cb == NULL);
+		   size < sizeof(os_queue_elem_t) || msg->cb == NULL ||
+		   reply_size < 0 || (reply == NULL && reply_size > 0));
 
 	/* Decode the reference to the os_thread. */
 	thread = g_thread;
 
+	/* A thread cannot wait for its own reply. */
+	OS_TRAP_IF(pthread_equal(thread->pthread, pthread_self()));
+
+	/* Prepare the completion slot of the caller. */
+	c = &os_call_slot;
+	atomic_store(&c->state, OS_CALL_PENDING);
+	c->buf  = reply;
+	c->size = reply_size;
+	c->len  = 0;
+
 	/* Get the reference to the message queue. . */
 	q = &thread->queue;
 
@@ -658,48 +2079,78 @@ void os_queue_send(void *g_thread, os_queue_elem_t *msg, int size)
 	state = atomic_load(&thread->state);
 	OS_TRAP_IF(state != OS_THREAD_READY);
 	
-	/* Request memory for the os_message. */
-	elem = OS_MALLOC(size);
+	/* Reserve a place in the default lane. */
+	os_queue_acquire(thread, OS_QUEUE_LANE_NORM);
 
-	/* Copy the user message. */
-	os_memcpy (elem, size, msg, size);
+	/* Save the copy of the request with the completion slot, which os_reply
+	 * releases as second user of the buffer. */
+	elem = os_queue_slot_get(q, size);
+	os_memcpy(elem, size, msg, size);
+	atomic_store(&OS_QUEUE_SLOT(elem)->ref, 2);
+	OS_QUEUE_SLOT(elem)->call = c;
 
-	/* Get the reference to the last queue element. */
-	stopper = &q->stopper;
-	
-	/* Enter the critical section. */
-	os_spin_lock(&q->protect);
-	
-	/* Increment the number of the queue elements. */
-	q->count++;
+	/* Insert the message buffer and resume the thread. */
+	os_queue_insert(q, OS_QUEUE_LANE_NORM, elem);
 
-	/* Test the state of the message queue. */
-	if (q->count > q->limit) {
-		OS_TRACE(("> %s: \"%s\": count=%d, limit=%d", F, thread->name,
-			  q->count, q->limit));
-		OS_TRAP();
+	/* Change the state of this operation. */
+	atomic_store(&q->busy_send, 0);
+
+	/* Announce the suspension, if the reply is still pending. */
+	expected = OS_CALL_PENDING;
+	if (atomic_compare_exchange_strong(&c->state, &expected,
+					   OS_CALL_WAITING)) {
+		/* Sleep until os_reply. */
+		while (atomic_load(&c->state) == OS_CALL_WAITING)
+			os_futex_wait(&c->state, OS_CALL_WAITING);
 	}
 
-	/* Insert the new message at the end of the queue. */
-	stopper->next->next = elem;
-	elem->next = stopper;
-	stopper->next = elem;
+	return c->len;
+}
+
+/**
+ * os_reply() - save the reply of a synchronous call in the buffer of the
+ * caller, resume it and release the request buffer. Each request of os_call()
+ * shall be answered exactly once, in its callback or in any other thread
+ * before the receiver is destroyed.
+ *
+ * @msg:   reference to the received request.
+ * @buf:   reference to the reply or NULL.
+ * @size:  length of the reply, which is truncated to the caller's buffer.
+ *
+ * Return:	None.
+ **/
+void os_reply(os_queue_elem_t *msg, void *buf, int size)
+{
+	os_queue_slot_t *slot;
+	os_call_t *c;
 
-	/* Change the thread state. */
-	is_running = q->is_running;
-	q->is_running = 1;
+	/* Entry condition. */
+	OS_TRAP_IF(msg == NULL || size < 0 || (buf == NULL && size > 0));
 
-	/* Leave the critical section. */
-	os_spin_unlock (&q->protect);
+	/* Get the completion slot of the caller. */
+	slot = OS_QUEUE_SLOT(msg);
+	c = slot->call;
+	OS_TRAP_IF(c == NULL);
 
-	/* Test the thread state. */
-	if (! is_running) {
-		/* Resume the os_thread. */
-		os_sem_release (&q->suspend_c);
-	}
-	
-	/* Change the state of this operation. */
-	atomic_store(&q->busy_send, 0);	
+	/* Detach the request from the caller. */
+	slot->call = NULL;
+
+	/* Copy the reply. */
+	if (size > c->size)
+		size = c->size;
+
+	if (size > 0)
+		os_memcpy(c->buf, c->size, buf, size);
+
+	c->len = size;
+
+	/* Release the request buffer before the caller may destroy the
+	 * receiver. */
+	os_queue_slot_drop(msg);
+
+	/* Complete the call and resume the waiting caller. */
+	if (atomic_exchange(&c->state, OS_CALL_DONE) == OS_CALL_WAITING)
+		os_futex_wake(&c->state);
 }
 
 /**
@@ -725,12 +2176,15 @@ void os_thread_destroy(void *g_thread)
 	thread = g_thread;
 	
 	/* Test the list index. */
-	OS_TRAP_IF(thread->idx < 0 || thread->idx >= OS_THREAD_LIMIT);
+	OS_TRAP_IF(os_thread_lookup(thread->idx) == NULL);
 
 	/* The current thread may not delete itself. */
 	current = pthread_getspecific(os_thread_list.key);
 	OS_TRAP_IF(thread == current);
 
+	/* Remove the pending timers of the thread. */
+	os_wheel_drop(thread);
+
 	/* Get, modify and test the thread state. */
 	OS_TRACE(("%s [t=%s,s=kill,o=destroy]\n", OS, thread->name));
 	state = atomic_load(&thread->state);
@@ -745,7 +2199,7 @@ void os_thread_destroy(void *g_thread)
 	OS_TRAP_IF(busy_send != 0);
 
 	/* Resume the os_thread in os_thread_cb. */
-	os_sem_release (&q->suspend_c);
+	os_queue_wake(q);
 
 	/* Wait for the leave of the thread callback. */
 	os_sem_wait(&thread->suspend_p);
@@ -776,7 +2230,7 @@ char *os_thread_name(void *g_thread)
 	thread = g_thread;
 	
 	/* Test the list index. */
-	OS_TRAP_IF(thread->idx < 0 || thread->idx >= OS_THREAD_LIMIT);
+	OS_TRAP_IF(os_thread_lookup(thread->idx) == NULL);
 
 	return thread->name;
 }
@@ -795,14 +2249,8 @@ void os_thread_statistics(os_statistics_t *stat)
 	/* Get the address of the thread list. */
 	list = &os_thread_list;
 
-	/* Enter the critical section. */
-	os_cs_enter(&list->protect);
-
 	/* Provide the number of the installed threads. */
-	stat->thread_c = list->count;
-	
-	/* Leave the critical section. */
-	os_cs_leave(&list->protect);
+	stat->thread_c = atomic_load(&list->count);
 }
 
 /**
@@ -820,6 +2268,14 @@ void os_thread_init(os_conf_t *conf)
 	/* Create the mutex for the critical section. */
 	os_cs_init(&os_thread_list.protect);
 
+	/* Start with an empty thread table. */
+	atomic_init(&os_thread_list.dir, NULL);
+	atomic_init(&os_thread_list.count, 0);
+	os_thread_list.free      = NULL;
+	os_thread_list.free_n    = 0;
+	os_thread_list.free_size = 0;
+	os_thread_list.limit     = 0;
+
 	/* Initialize the control for pthread_once. */
 	os_thread_list.once_c = PTHREAD_ONCE_INIT;
 }
@@ -832,6 +2288,8 @@ void os_thread_init(os_conf_t *conf)
 void os_thread_exit(void)
 {
 	struct os_thread_list_s *list;
+	os_thread_dir_t *dir, *prev;
+	int i;
 
 	/* Release the thread list resources. */
 	list = &os_thread_list;
@@ -839,7 +2297,25 @@ void os_thread_exit(void)
 	/* Enter the critical section. */
 	os_cs_enter(&list->protect);
 
-	OS_TRAP_IF(list->count != 0);
+	OS_TRAP_IF(atomic_load(&list->count) != 0);
+
+	/* Release the chunks of the thread table. */
+	dir = atomic_load(&list->dir);
+	for (i = 0; dir != NULL && i < dir->size; i++)
+		free(atomic_load(&dir->chunk[i]));
+
+	/* Release the current and all previous chunk directories. */
+	for (; dir != NULL; dir = prev) {
+		prev = dir->prev;
+		free(dir);
+	}
+
+	atomic_store(&list->dir, NULL);
+
+	/* Release the index stack. */
+	free(list->free);
+	list->free = NULL;
+	list->free_n = list->free_size = list->limit = 0;
 
 	/* Leave the critical section. */
 	os_cs_leave(&list->protect);
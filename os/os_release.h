@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * Memory and string wrappers of the release build.
+ *
+ * Copyright (C) 2022 Gerald Schueller <gerald.schueller@web.de>
+ */
+
+#ifndef __os_release_h__
+#define __os_release_h__
+
+/*============================================================================
+  IMPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include <string.h>  /* String operations. */
+
+/*============================================================================
+  NAME CONSTANTS DEFINITIONS
+  ============================================================================*/
+/*============================================================================
+  MACROS
+  ============================================================================*/
+/*============================================================================
+  TYPE DEFINITIONS
+  ============================================================================*/
+/*============================================================================
+  GLOBAL DATA
+  ============================================================================*/
+/*============================================================================
+  EXPORTED FUNCTIONS
+  ============================================================================*/
+/**
+ * os_malloc_thin() - malloc without os_malloc bookkeeping.
+ *
+ * @size:  size of the requested memory.
+ *
+ * Return:	the pointer to the allocated memory.
+ **/
+static inline void *os_malloc_thin(size_t size)
+{
+	void *ptr;
+
+	/* Request memory from the OS, an allocation failure remains fatal. */
+	ptr = malloc(size);
+	OS_TRAP_IF(ptr == NULL);
+
+	return ptr;
+}
+
+/**
+ * os_free_thin() - free without os_malloc bookkeeping.
+ *
+ * @ptr:  address of the pointer to the allocated memory.
+ *
+ * Return:	None.
+ **/
+static inline void os_free_thin(void **ptr)
+{
+	/* Free the buffer and reset the pointer. */
+	free(*ptr);
+	*ptr = NULL;
+}
+
+/* The string wrappers of os_string.c without the traps; os_strcpy keeps the
+ * destination limit, the other limits are only checked by the debug build. */
+static inline void *os_memset(void *s, int c, size_t n)
+{
+	return memset(s, c, n);
+}
+
+static inline void *os_memcpy(void *dest, size_t dest_n, const void *src,
+			      size_t src_n)
+{
+	return memcpy(dest, src, src_n);
+}
+
+static inline int os_memcmp(const void *s1, const void *s2, size_t n)
+{
+	return memcmp(s1, s2, n);
+}
+
+static inline void *os_memchr(const void *s, const void *end, int c, size_t n)
+{
+	return memchr(s, c, n);
+}
+
+static inline size_t os_strnlen(const char *s, size_t maxlen)
+{
+	return strnlen(s, maxlen);
+}
+
+static inline size_t os_strlen(const char *s)
+{
+	return strlen(s);
+}
+
+static inline char *os_strcpy(char *dest, int dest_n, const char *src)
+{
+	size_t src_n;
+
+	/* Copy not more than dest_n - 1 characters and terminate the string. */
+	src_n = strnlen(src, dest_n - 1);
+	memcpy(dest, src, src_n);
+	dest[src_n] = '\0';
+
+	return dest;
+}
+
+static inline int os_strncmp(const char *s1, const char *s2, int n)
+{
+	return strncmp(s1, s2, n);
+}
+
+static inline int os_strcmp(const char *s1, const char *s2)
+{
+	return strcmp(s1, s2);
+}
+
+static inline char *os_strncat(char *dest, const char *src, size_t n)
+{
+	return strncat(dest, src, n);
+}
+
+static inline char *os_strstr(const char *haystack, int haystack_len,
+			      const char *needle)
+{
+	return strstr(haystack, needle);
+}
+
+static inline char *os_strchr(const char *s, int s_len, int c)
+{
+	return strchr(s, c);
+}
+
+static inline long int os_strtol_b10(const char *nptr, int n_len)
+{
+	return strtol(nptr, NULL, 10);
+}
+
+#endif /* __os_release_h__ */
@@ -36,6 +36,8 @@
 /*============================================================================
   EXPORTED FUNCTIONS
   ============================================================================*/
+#if ! defined(OS_RELEASE)
+
 /**
  * os_memset() - memset with additional assertions.
  *
@@ -227,3 +229,5 @@ long int os_strtol_b10(const char *nptr, int n_len)
 
 	return n;
 }
+
+#endif /* ! OS_RELEASE */
@@ -0,0 +1,912 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Delayed and periodic messages of the os_threads: hierarchical timer wheel.
+ *
+ * Copyright (C) 2022 Gerald Schueller <gerald.schueller@web.de>
+ */
+
+/*============================================================================
+  IMPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#define _GNU_SOURCE      /* Monotonic semaphore timeout: sem_clockwait(). */
+#include <errno.h>       /* Linux error codes: EINTR. */
+#include <limits.h>      /* Limits of the integer types: LLONG_MAX. */
+#include <time.h>        /* Monotonic clock: clock_gettime(). */
+#include <pthread.h>     /* POSIX thread. */
+#include <semaphore.h>   /* POSIX semaphore: sem_clockwait(). */
+#include "os.h"          /* Operating system: os_sem_create() */
+
+/*============================================================================
+  EXPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include "os_private.h"  /* Local interfaces of the OS: os_wheel_init() */
+
+/*============================================================================
+  LOCAL NAME CONSTANTS DEFINITIONS
+  ============================================================================*/
+/* Resolution of the timer wheel in nanoseconds: 1 millisecond. */
+#define OS_WHEEL_TICK  1000000LL
+
+/* Number of the slots of a wheel level as power of two. */
+#define OS_WHEEL_BITS  6
+
+/* Number of the slots of a wheel level. */
+#define OS_WHEEL_SLOTS  (1 << OS_WHEEL_BITS)
+
+/* Slot mask of a wheel level. */
+#define OS_WHEEL_MASK  (OS_WHEEL_SLOTS - 1)
+
+/* Number of the wheel levels: 64^4 ms or about 4.6 hours. */
+#define OS_WHEEL_LEVELS  4
+
+/* Maximum timeout of the wheel in ticks, longer timeouts are cascaded. */
+#define OS_WHEEL_SPAN  (1LL << (OS_WHEEL_BITS * OS_WHEEL_LEVELS))
+
+/* Initial number of the timer table entries. */
+#define OS_WHEEL_SIZE  64
+
+/* Number of the index bits in the timer id. */
+#define OS_WHEEL_IDX_BITS  20
+
+/* Index mask of the timer id. */
+#define OS_WHEEL_IDX_MASK  ((1 << OS_WHEEL_IDX_BITS) - 1)
+
+/* Generation mask of the timer id. */
+#define OS_WHEEL_GEN_MASK  0x7ff
+
+/* End of a slot list. */
+#define OS_WHEEL_NIL  -1
+
+/*============================================================================
+  MACROS
+  ============================================================================*/
+/* Build the timer id from the generation and the table index. */
+#define OS_WHEEL_ID(gen_, idx_)  (((gen_) << OS_WHEEL_IDX_BITS) | (idx_))
+
+/*============================================================================
+  LOCAL TYPE DEFINITIONS
+  ============================================================================*/
+/**
+ * os_wheel_timer_t - pending delayed or periodic message.
+ *
+ * @next:       successor in the slot list.
+ * @prev:       predecessor in the slot list.
+ * @level:      wheel level of the timer or OS_WHEEL_NIL.
+ * @slot:       slot of the timer in the wheel level.
+ * @gen:        generation of the table entry to detect stale timer ids.
+ * @is_in_use:  if 1, the table entry is allocated.
+ * @expiry:     due time in ticks.
+ * @period:     period in ticks or 0 for a single message.
+ * @thread:     receiver of the message.
+ * @msg:        copy of the message.
+ * @size:       size of the message.
+ **/
+typedef struct {
+	int               next;
+	int               prev;
+	int               level;
+	int               slot;
+	int               gen;
+	int               is_in_use;
+	long long         expiry;
+	long long         period;
+	void             *thread;
+	os_queue_elem_t  *msg;
+	int               size;
+} os_wheel_timer_t;
+
+/**
+ * os_wheel_due_t - due message, which the timer thread delivers outside the
+ * critical section of the wheel.
+ *
+ * @idx:     table index of the timer.
+ * @thread:  receiver of the message.
+ * @msg:     copy of the message.
+ * @size:    size of the message.
+ * @ret:     result of the delivery.
+ **/
+typedef struct {
+	int               idx;
+	void             *thread;
+	os_queue_elem_t  *msg;
+	int               size;
+	int               ret;
+} os_wheel_due_t;
+
+/*============================================================================
+  LOCAL DATA
+  ============================================================================*/
+/**
+ * os_wheel - state of the timer wheel.
+ *
+ * @once_c:   start the timer thread with the first timer.
+ * @protect:  protect the access to the timer wheel.
+ * @deliver:  serialize the delivery with the removal of the timers.
+ * @wake_c:   control semaphore of the sleeping timer thread.
+ * @pthread:  timer thread.
+ * @is_run:   if 1, the timer thread has been started.
+ * @is_stop:  if 1, the timer thread shall terminate.
+ * @is_idle:  if 1, the timer thread waits for the next timer.
+ * @wake_at:  tick, up to which the timer thread sleeps, or 0, if it runs.
+ * @start:    start time of the wheel.
+ * @now:      current time in ticks.
+ * @head:     slot lists of the wheel levels.
+ * @timer:    table of the timers.
+ * @size:     number of the table entries.
+ * @free:     stack of the free table indices.
+ * @free_n:   number of the free table indices.
+ * @count:    number of the pending timers.
+ * @due:      list of the due messages of the elapsed ticks.
+ * @due_n:    number of the due messages.
+ * @due_size: number of the entries of the due list.
+ **/
+static struct os_wheel_s {
+	pthread_once_t     once_c;
+	pthread_mutex_t    protect;
+	pthread_mutex_t    deliver;
+	sem_t              wake_c;
+	pthread_t          pthread;
+	int                is_run;
+	int                is_stop;
+	int                is_idle;
+	long long          wake_at;
+	struct timespec    start;
+	long long          now;
+	int                head[OS_WHEEL_LEVELS][OS_WHEEL_SLOTS];
+	os_wheel_timer_t  *timer;
+	int                size;
+	int               *free;
+	int                free_n;
+	int                count;
+	os_wheel_due_t    *due;
+	int                due_n;
+	int                due_size;
+} os_wheel;
+
+/*============================================================================
+  LOCAL FUNCTION PROTOTYPES
+  ============================================================================*/
+/*============================================================================
+  LOCAL FUNCTIONS
+  ============================================================================*/
+/**
+ * os_wheel_link() - insert the timer in the slot list of its due time. The
+ * expiry of the timer is not changed.
+ *
+ * @idx:    table index of the timer.
+ * @first:  first tick, whose slot has not been processed yet: the overdue
+ *          timers are inserted in its slot.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_link(int idx, long long first)
+{
+	os_wheel_timer_t *t;
+	long long delta, expiry;
+	int level, head;
+
+	/* Get the reference to the timer. */
+	t = &os_wheel.timer[idx];
+
+	/* Overdue timers expire in the first pending slot. */
+	expiry = t->expiry > first ? t->expiry : first;
+
+	/* Longer timeouts are cascaded again from the highest level. */
+	delta = expiry - os_wheel.now;
+	if (delta >= OS_WHEEL_SPAN) {
+		delta  = OS_WHEEL_SPAN - 1;
+		expiry = os_wheel.now + delta;
+	}
+
+	/* Search for the lowest level, which covers the timeout. */
+	for (level = 0; level < OS_WHEEL_LEVELS - 1; level++) {
+		if (delta < (1LL << (OS_WHEEL_BITS * (level + 1))))
+			break;
+	}
+
+	/* Calculate the slot of the due time. */
+	t->level = level;
+	t->slot  = (expiry >> (OS_WHEEL_BITS * level)) & OS_WHEEL_MASK;
+
+	/* Insert the timer at the head of the slot list. */
+	head = os_wheel.head[level][t->slot];
+	t->prev = OS_WHEEL_NIL;
+	t->next = head;
+	if (head != OS_WHEEL_NIL)
+		os_wheel.timer[head].prev = idx;
+
+	os_wheel.head[level][t->slot] = idx;
+}
+
+/**
+ * os_wheel_unlink() - remove the timer from its slot list.
+ *
+ * @idx:  table index of the timer.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_unlink(int idx)
+{
+	os_wheel_timer_t *t;
+
+	/* Get the reference to the timer. */
+	t = &os_wheel.timer[idx];
+	OS_TRAP_IF(t->level == OS_WHEEL_NIL);
+
+	/* Remove the timer from the doubly linked list. */
+	if (t->prev != OS_WHEEL_NIL)
+		os_wheel.timer[t->prev].next = t->next;
+	else
+		os_wheel.head[t->level][t->slot] = t->next;
+
+	if (t->next != OS_WHEEL_NIL)
+		os_wheel.timer[t->next].prev = t->prev;
+
+	t->level = OS_WHEEL_NIL;
+}
+
+/**
+ * os_wheel_put() - release the message copy and the table entry of a timer.
+ *
+ * @idx:  table index of the timer.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_put(int idx)
+{
+	os_wheel_timer_t *t;
+
+	/* Get the reference to the timer. */
+	t = &os_wheel.timer[idx];
+
+	/* Release the message copy. */
+	OS_FREE(t->msg);
+
+	/* Invalidate the timer id. */
+	t->is_in_use = 0;
+	t->gen = (t->gen + 1) & OS_WHEEL_GEN_MASK;
+
+	/* Push the index onto the free stack. */
+	os_wheel.free[os_wheel.free_n++] = idx;
+	os_wheel.count--;
+}
+
+/**
+ * os_wheel_get() - allocate a table entry and double the table, if it is
+ * full.
+ *
+ * Return:	the table index of the timer.
+ **/
+static int os_wheel_get(void)
+{
+	os_wheel_timer_t *timer;
+	int *free, size, i;
+
+	/* Test the free stack. */
+	if (os_wheel.free_n < 1) {
+		/* Double the timer table. */
+		size = os_wheel.size > 0 ? 2 * os_wheel.size : OS_WHEEL_SIZE;
+		OS_TRAP_IF(size > OS_WHEEL_IDX_MASK + 1);
+
+		timer = OS_MALLOC(size * sizeof(os_wheel_timer_t));
+		os_memset(timer, 0, size * sizeof(os_wheel_timer_t));
+		free = OS_MALLOC(size * sizeof(int));
+
+		/* Save the current timers, the slot lists contain indices. */
+		if (os_wheel.size > 0) {
+			os_memcpy(timer, size * sizeof(os_wheel_timer_t),
+				  os_wheel.timer,
+				  os_wheel.size * sizeof(os_wheel_timer_t));
+			OS_FREE(os_wheel.timer);
+			OS_FREE(os_wheel.free);
+		}
+
+		/* Push the new indices onto the free stack. */
+		for (i = size - 1; i >= os_wheel.size; i--)
+			free[os_wheel.free_n++] = i;
+
+		os_wheel.timer = timer;
+		os_wheel.free  = free;
+		os_wheel.size  = size;
+	}
+
+	/* Pop the index from the free stack. */
+	os_wheel.count++;
+	return os_wheel.free[--os_wheel.free_n];
+}
+
+/**
+ * os_wheel_cascade() - move the timers of a slot to the lower levels; the
+ * due timers are inserted in the slot of the current tick, which is
+ * processed afterwards.
+ *
+ * @level:  wheel level of the slot.
+ * @slot:   slot of the wheel level.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_cascade(int level, int slot)
+{
+	int idx, next;
+
+	/* Detach the slot list. */
+	idx = os_wheel.head[level][slot];
+	os_wheel.head[level][slot] = OS_WHEEL_NIL;
+
+	/* Insert the timers again relative to the current time. */
+	for (; idx != OS_WHEEL_NIL; idx = next) {
+		next = os_wheel.timer[idx].next;
+		os_wheel_link(idx, os_wheel.now);
+	}
+}
+
+/**
+ * os_wheel_collect() - add the message of the due timer to the due list,
+ * which grows by doubling.
+ *
+ * @idx:  table index of the timer.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_collect(int idx)
+{
+	os_wheel_timer_t *t;
+	os_wheel_due_t *due;
+	int size;
+
+	/* Test the fill level of the due list. */
+	if (os_wheel.due_n >= os_wheel.due_size) {
+		/* Double the due list. */
+		size = os_wheel.due_size > 0 ? 2 * os_wheel.due_size : OS_WHEEL_SIZE;
+		due  = OS_MALLOC(size * sizeof(os_wheel_due_t));
+		if (os_wheel.due_size > 0) {
+			os_memcpy(due, size * sizeof(os_wheel_due_t), os_wheel.due,
+				  os_wheel.due_n * sizeof(os_wheel_due_t));
+			OS_FREE(os_wheel.due);
+		}
+
+		os_wheel.due      = due;
+		os_wheel.due_size = size;
+	}
+
+	/* Save the receiver and the message of the timer. */
+	t   = &os_wheel.timer[idx];
+	due = &os_wheel.due[os_wheel.due_n++];
+	due->idx    = idx;
+	due->thread = t->thread;
+	due->msg    = t->msg;
+	due->size   = t->size;
+	due->ret    = 0;
+}
+
+/**
+ * os_wheel_tick() - advance the wheel by one tick and collect the due
+ * messages.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_tick(void)
+{
+	os_wheel_timer_t *t;
+	int level, slot, idx, next;
+
+	/* Update the current time. */
+	os_wheel.now++;
+
+	/* Cascade the higher levels at the wrap-around of the lower ones. */
+	for (level = 1; level < OS_WHEEL_LEVELS; level++) {
+		if ((os_wheel.now & ((1LL << (OS_WHEEL_BITS * level)) - 1)) != 0)
+			break;
+
+		slot = (os_wheel.now >> (OS_WHEEL_BITS * level)) & OS_WHEEL_MASK;
+		os_wheel_cascade(level, slot);
+	}
+
+	/* Detach the due timers of the lowest level. */
+	slot = os_wheel.now & OS_WHEEL_MASK;
+	idx  = os_wheel.head[0][slot];
+	os_wheel.head[0][slot] = OS_WHEEL_NIL;
+
+	/* Loop over the due timers. */
+	for (; idx != OS_WHEEL_NIL; idx = next) {
+		t = &os_wheel.timer[idx];
+		next = t->next;
+		t->level = OS_WHEEL_NIL;
+
+		/* A cascaded long timeout may not be due yet. */
+		if (t->expiry > os_wheel.now) {
+			os_wheel_link(idx, os_wheel.now + 1);
+			continue;
+		}
+
+		/* Save the message for the delivery. */
+		os_wheel_collect(idx);
+
+		/* Rearm a periodic timer in its phase and skip the missed
+		 * periods; a single timer is released after the delivery. */
+		if (t->period > 0) {
+			do {
+				t->expiry += t->period;
+			} while (t->expiry <= os_wheel.now);
+
+			os_wheel_link(idx, os_wheel.now + 1);
+		}
+	}
+}
+
+/**
+ * os_wheel_next() - search for the next tick, which processes a non-empty slot
+ * of a wheel level.
+ *
+ * Return:	the next tick with pending timers or LLONG_MAX.
+ **/
+static long long os_wheel_next(void)
+{
+	long long next, base, tick;
+	int level, shift, k;
+
+	/* Loop over the wheel levels. */
+	next = LLONG_MAX;
+	for (level = 0; level < OS_WHEEL_LEVELS; level++) {
+		/* A slot of a higher level is processed, if the lower levels
+		 * wrap around. */
+		shift = OS_WHEEL_BITS * level;
+		base  = os_wheel.now >> shift;
+
+		/* Search for the first non-empty slot behind the current one. */
+		for (k = 1; k <= OS_WHEEL_SLOTS; k++) {
+			if (os_wheel.head[level][(base + k) & OS_WHEEL_MASK] ==
+			    OS_WHEEL_NIL)
+				continue;
+
+			/* Save the earliest tick of all levels. */
+			tick = (base + k) << shift;
+			if (tick < next)
+				next = tick;
+
+			break;
+		}
+	}
+
+	return next;
+}
+
+/**
+ * os_wheel_deliver() - send the due messages outside the critical section of
+ * the wheel without waiting: a periodic message is dropped, if the input
+ * queue is full, a single message is retried with the next tick.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_deliver(void)
+{
+	os_wheel_timer_t *t;
+	os_wheel_due_t *due;
+	int i;
+
+	/* Leave the critical section, the timers of the due list cannot be
+	 * removed during the delivery. */
+	os_cs_leave(&os_wheel.protect);
+
+	/* Save a copy of the due messages in the input queues. */
+	for (i = 0, due = os_wheel.due; i < os_wheel.due_n; i++, due++)
+		due->ret = os_queue_try_send(due->thread, due->msg, due->size);
+
+	/* Enter the critical section. */
+	os_cs_enter(&os_wheel.protect);
+
+	/* Loop over the due list. */
+	for (i = 0, due = os_wheel.due; i < os_wheel.due_n; i++, due++) {
+		/* The periodic timers have already been rearmed. */
+		t = &os_wheel.timer[due->idx];
+		if (t->period > 0)
+			continue;
+
+		/* Release the delivered single timer or retry it. */
+		if (due->ret == 0)
+			os_wheel_put(due->idx);
+		else
+			os_wheel_link(due->idx, os_wheel.now + 1);
+	}
+
+	/* Empty the due list. */
+	os_wheel.due_n = 0;
+}
+
+/**
+ * os_wheel_ticks() - get the elapsed ticks since the start of the wheel.
+ *
+ * Return:	the current time in ticks.
+ **/
+static long long os_wheel_ticks(void)
+{
+	struct timespec ts;
+	long long ns;
+
+	/* Get the monotonic time. */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ns = (ts.tv_sec - os_wheel.start.tv_sec) * 1000000000LL +
+		(ts.tv_nsec - os_wheel.start.tv_nsec);
+
+	return ns / OS_WHEEL_TICK;
+}
+
+/**
+ * os_wheel_sleep() - suspend the timer thread until the tick or until a new
+ * timer expires earlier.
+ *
+ * @tick:  wakeup time in ticks.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_sleep(long long tick)
+{
+	struct timespec ts;
+	long long ns;
+	int ret;
+
+	/* Calculate the absolute time of the tick. */
+	ns = tick * OS_WHEEL_TICK + os_wheel.start.tv_nsec;
+	ts.tv_sec  = os_wheel.start.tv_sec + ns / 1000000000LL;
+	ts.tv_nsec = ns % 1000000000LL;
+
+	/* Suspend the timer thread. */
+	do {
+		ret = sem_clockwait(&os_wheel.wake_c, CLOCK_MONOTONIC, &ts);
+	} while (ret != 0 && errno == EINTR);
+
+	OS_TRAP_IF(ret != 0 && errno != ETIMEDOUT);
+}
+
+/**
+ * os_wheel_cb() - callback of the timer thread.
+ *
+ * @arg:  not used.
+ *
+ * Return:	NULL.
+ **/
+static void *os_wheel_cb(void *arg)
+{
+	long long now, next;
+
+	/* Enter the critical sections. */
+	os_cs_enter(&os_wheel.deliver);
+	os_cs_enter(&os_wheel.protect);
+
+	/* Loop thru the ticks. */
+	while (! os_wheel.is_stop) {
+		/* Process all elapsed ticks with pending timers, the other ones
+		 * are skipped, and deliver the due messages. */
+		now = os_wheel_ticks();
+		while (os_wheel.now < now) {
+			next = os_wheel_next();
+			if (next > now) {
+				os_wheel.now = now;
+				break;
+			}
+
+			os_wheel.now = next - 1;
+			os_wheel_tick();
+		}
+
+		if (os_wheel.due_n > 0)
+			os_wheel_deliver();
+
+		/* Wait for the next timer, if the wheel is empty. */
+		if (os_wheel.count == 0) {
+			os_wheel.is_idle = 1;
+			os_cs_leave(&os_wheel.protect);
+			os_cs_leave(&os_wheel.deliver);
+			os_sem_wait(&os_wheel.wake_c);
+			os_cs_enter(&os_wheel.deliver);
+			os_cs_enter(&os_wheel.protect);
+			continue;
+		}
+
+		/* Wait for the next tick with pending timers. */
+		os_wheel.wake_at = os_wheel_next();
+		if (os_wheel.wake_at == LLONG_MAX)
+			os_wheel.wake_at = os_wheel.now + 1;
+
+		next = os_wheel.wake_at;
+		os_cs_leave(&os_wheel.protect);
+		os_cs_leave(&os_wheel.deliver);
+		os_wheel_sleep(next);
+		os_cs_enter(&os_wheel.deliver);
+		os_cs_enter(&os_wheel.protect);
+		os_wheel.wake_at = 0;
+	}
+
+	/* Leave the critical sections. */
+	os_cs_leave(&os_wheel.protect);
+	os_cs_leave(&os_wheel.deliver);
+
+	return NULL;
+}
+
+/**
+ * os_wheel_start() - init_routine for pthread_once: create the timer thread
+ * with the first timer.
+ *
+ * Return:	None.
+ **/
+static void os_wheel_start(void)
+{
+	int ret, i, j;
+
+	/* Create the resources of the timer wheel. */
+	os_cs_init(&os_wheel.protect);
+	os_cs_init(&os_wheel.deliver);
+	os_sem_init(&os_wheel.wake_c, 0);
+
+	/* Empty all slot lists. */
+	for (i = 0; i < OS_WHEEL_LEVELS; i++) {
+		for (j = 0; j < OS_WHEEL_SLOTS; j++)
+			os_wheel.head[i][j] = OS_WHEEL_NIL;
+	}
+
+	/* Save the start time of the wheel. */
+	clock_gettime(CLOCK_MONOTONIC, &os_wheel.start);
+	os_wheel.now = 0;
+
+	/* Start the timer thread. */
+	os_wheel.is_run = 1;
+	ret = pthread_create(&os_wheel.pthread, NULL, os_wheel_cb, NULL);
+	OS_TRAP_IF(ret != 0);
+}
+
+/**
+ * os_wheel_arm() - save a copy of the message in the timer wheel.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
+ * @delay:     timeout of the first message in milliseconds.
+ * @period:    period in milliseconds or 0 for a single message.
+ *
+ * Return:	the timer id for os_queue_cancel().
+ **/
+static int os_wheel_arm(void *g_thread, os_queue_elem_t *msg, int size,
+			int delay, int period)
+{
+	os_wheel_timer_t *t;
+	int idx, id, ret;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL || msg == NULL ||
+		   size < sizeof(os_queue_elem_t) || msg->cb == NULL ||
+		   delay < 0 || period < 0);
+
+	/* Start the timer thread with the first timer. */
+	ret = pthread_once(&os_wheel.once_c, os_wheel_start);
+	OS_TRAP_IF(ret != 0);
+
+	/* Enter the critical section. */
+	os_cs_enter(&os_wheel.protect);
+
+	/* The empty wheel skips the ticks of the idle phase. */
+	if (os_wheel.is_idle)
+		os_wheel.now = os_wheel_ticks();
+
+	/* Allocate a timer. */
+	idx = os_wheel_get();
+	t = &os_wheel.timer[idx];
+
+	/* Save the copy of the message. */
+	t->msg = OS_MALLOC(size);
+	os_memcpy(t->msg, size, msg, size);
+	t->size   = size;
+	t->thread = g_thread;
+
+	/* Calculate the due time relative to the processed ticks. */
+	t->expiry = os_wheel_ticks() + delay * 1000000LL / OS_WHEEL_TICK;
+	t->period = period * 1000000LL / OS_WHEEL_TICK;
+	t->is_in_use = 1;
+
+	/* Insert the timer in the wheel. */
+	os_wheel_link(idx, os_wheel.now + 1);
+	id = OS_WHEEL_ID(t->gen, idx);
+
+	/* Resume the idle timer thread or the sleeping one, if the new timer
+	 * expires earlier. */
+	if (os_wheel.is_idle) {
+		os_wheel.is_idle = 0;
+		os_sem_release(&os_wheel.wake_c);
+	}
+	else if (t->expiry < os_wheel.wake_at) {
+		os_wheel.wake_at = 0;
+		os_sem_release(&os_wheel.wake_c);
+	}
+
+	/* Leave the critical section. */
+	os_cs_leave(&os_wheel.protect);
+
+	return id;
+}
+
+/*============================================================================
+  EXPORTED FUNCTIONS
+  ============================================================================*/
+/**
+ * os_queue_send_after() - save a copy of the message in the os_thread queue
+ * after the delay. If the queue is full, the timer thread retries the
+ * delivery with the next tick.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
+ * @delay:     timeout in milliseconds.
+ *
+ * Return:	the timer id for os_queue_cancel().
+ **/
+int os_queue_send_after(void *g_thread, os_queue_elem_t *msg, int size,
+			int delay)
+{
+	/* Insert a single timer. */
+	return os_wheel_arm(g_thread, msg, size, delay, 0);
+}
+
+/**
+ * os_queue_send_every() - save a copy of the message in the os_thread queue
+ * periodically until os_queue_cancel(). If the queue is full, the timer
+ * thread drops the message of this period.
+ *
+ * @g_thread:  generic address of the os_thread.
+ * @msg:       reference to the message.
+ * @size:      size of the message.
+ * @period:    period in milliseconds.
+ *
+ * Return:	the timer id for os_queue_cancel().
+ **/
+int os_queue_send_every(void *g_thread, os_queue_elem_t *msg, int size,
+			int period)
+{
+	/* Entry condition. */
+	OS_TRAP_IF(period < 1);
+
+	/* Insert a periodic timer. */
+	return os_wheel_arm(g_thread, msg, size, period, period);
+}
+
+/**
+ * os_queue_cancel() - remove a pending delayed or periodic message.
+ *
+ * @id:  timer id of os_queue_send_after() or os_queue_send_every().
+ *
+ * Return:	0, if the timer has been removed, or -1, if the message has
+ *		already been sent.
+ **/
+int os_queue_cancel(int id)
+{
+	os_wheel_timer_t *t;
+	int idx, gen;
+
+	/* Entry condition. */
+	OS_TRAP_IF(id < 0);
+
+	/* Decode the timer id. */
+	idx = id & OS_WHEEL_IDX_MASK;
+	gen = id >> OS_WHEEL_IDX_BITS;
+
+	/* A cancel without a timer is not permitted. */
+	OS_TRAP_IF(! os_wheel.is_run);
+
+	/* Enter the critical sections. */
+	os_cs_enter(&os_wheel.deliver);
+	os_cs_enter(&os_wheel.protect);
+
+	/* Test the timer id. */
+	OS_TRAP_IF(idx >= os_wheel.size);
+	t = &os_wheel.timer[idx];
+	if (! t->is_in_use || t->gen != gen) {
+		os_cs_leave(&os_wheel.protect);
+		os_cs_leave(&os_wheel.deliver);
+		return -1;
+	}
+
+	/* Remove the timer from the wheel. */
+	os_wheel_unlink(idx);
+	os_wheel_put(idx);
+
+	/* Leave the critical sections. */
+	os_cs_leave(&os_wheel.protect);
+	os_cs_leave(&os_wheel.deliver);
+
+	return 0;
+}
+
+/**
+ * os_wheel_drop() - remove the pending timers of the os_thread, which is
+ * destroyed.
+ *
+ * @g_thread:  generic address of the os_thread.
+ *
+ * Return:	None.
+ **/
+void os_wheel_drop(void *g_thread)
+{
+	int idx;
+
+	/* Entry condition. */
+	OS_TRAP_IF(g_thread == NULL);
+
+	/* Test the state of the timer thread. */
+	if (! os_wheel.is_run)
+		return;
+
+	/* Enter the critical sections: wait for the end of the delivery. */
+	os_cs_enter(&os_wheel.deliver);
+	os_cs_enter(&os_wheel.protect);
+
+	/* Loop over the timer table. */
+	for (idx = 0; idx < os_wheel.size; idx++) {
+		/* Search for the timers of the os_thread. */
+		if (! os_wheel.timer[idx].is_in_use ||
+		    os_wheel.timer[idx].thread != g_thread)
+			continue;
+
+		/* Remove the timer from the wheel. */
+		os_wheel_unlink(idx);
+		os_wheel_put(idx);
+	}
+
+	/* Leave the critical sections. */
+	os_cs_leave(&os_wheel.protect);
+	os_cs_leave(&os_wheel.deliver);
+}
+
+/**
+ * os_wheel_init() - initialize the state of the timer wheel.
+ *
+ * Return:	None.
+ **/
+void os_wheel_init(void)
+{
+	/* Reset the timer wheel, the timer thread is started on demand. */
+	os_memset(&os_wheel, 0, sizeof(os_wheel));
+	os_wheel.once_c = PTHREAD_ONCE_INIT;
+}
+
+/**
+ * os_wheel_exit() - stop the timer thread and test the release of all timers.
+ *
+ * Return:	None.
+ **/
+void os_wheel_exit(void)
+{
+	void *status;
+	int ret;
+
+	/* Test the state of the timer thread. */
+	if (! os_wheel.is_run)
+		return;
+
+	/* All timers shall be cancelled or expired. */
+	OS_TRAP_IF(os_wheel.count != 0);
+
+	/* Request the termination of the timer thread. */
+	os_cs_enter(&os_wheel.protect);
+	os_wheel.is_stop = 1;
+	os_cs_leave(&os_wheel.protect);
+	os_sem_release(&os_wheel.wake_c);
+
+	/* Wait for the termination of the timer thread. */
+	ret = pthread_join(os_wheel.pthread, &status);
+	OS_TRAP_IF(ret != 0);
+
+	/* Release the timer table and the due list. */
+	if (os_wheel.size > 0) {
+		OS_FREE(os_wheel.timer);
+		OS_FREE(os_wheel.free);
+	}
+
+	if (os_wheel.due_size > 0)
+		OS_FREE(os_wheel.due);
+
+	/* Release the resources of the timer wheel. */
+	os_sem_delete(&os_wheel.wake_c);
+	os_cs_destroy(&os_wheel.deliver);
+	os_cs_destroy(&os_wheel.protect);
+	os_wheel.is_run = 0;
+}
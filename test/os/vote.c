@@ -62,7 +62,7 @@ static test_elem_t shutdown_system[] = {
  **/
 static int test_case_shutdown(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2382, 2382, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10837, 10834, 0 };
 	int stat;
 	
 	/* Verify the OS state. */
@@ -85,7 +85,7 @@ static int test_case_boot(void)
 	int stat;
 	
 	/* Initialize all OS layers. */
-	os_init(OS_CREATE | OS_TEST);
+	os_init(OS_CREATE | OS_TEST | OS_DIAG);
 
 	/* Switch off the OS trace. */
 	os_trace_button(0);
@@ -149,6 +149,12 @@ int test_os_stat(os_statistics_t *expected)
 	os_memset(&stat, 0, sizeof(stat));
 	os_statistics(&stat);
 
+#if defined(OS_RELEASE)
+	/* The release build does not track the OS_MALLOC calls. */
+	stat.malloc_c = expected->malloc_c;
+	stat.free_c   = expected->free_c;
+#endif
+
 	/* Compare the current with expected OS state. */
 	ret = os_memcmp(&stat, expected, sizeof(os_statistics_t));
 
@@ -8,7 +8,8 @@
 /*============================================================================
   IMPORTED INCLUDE REFERENCES
   ============================================================================*/
-#include "vote.h"  /* Van OS test environment. */
+#include <sched.h>  /* Yield the processor: sched_yield(). */
+#include "vote.h"   /* Van OS test environment. */
 
 /*============================================================================
   EXPORTED INCLUDE REFERENCES
@@ -19,6 +20,31 @@
 /* Size of the message buffer. */
 #define BUT_LEN  32
 
+/* Number of the threads beyond the first chunk of the thread table. */
+#define BUT_GROW_N  (4 * OS_THREAD_LIMIT)
+
+/* Number of the workers of the thread pool and of the forked messages. */
+#define BUT_POOL_SIZE  4
+#define BUT_FORK_N     8
+
+/* Number of the pending timers and of the periodic messages. */
+#define BUT_TIMER_N  4096
+#define BUT_TICK_N   3
+
+/* Number of the urgent and the bulk messages of the lane test. */
+#define BUT_HIGH_N  2
+#define BUT_BULK_N  4
+
+/* Number of the fibers of the fiber test. */
+#define BUT_FIBER_N  3
+
+/* Number of the outstanding buffers beyond the first os_malloc chunk. */
+#define BUT_MEM_N  4096
+
+/* Queue size and number of the messages of the self send test. */
+#define BUT_SELF_Q  2
+#define BUT_SELF_N  64
+
 /*============================================================================
   MACROS
   ============================================================================*/
@@ -31,11 +57,21 @@
  * @msg_info:  contents of the message buffer.
  * @thread:    thread list for the multi thread test.
  * @suspend:   control semaphore for the main process.
+ * @block:     control semaphore for the test thread.
+ * @tick:      number of the received periodic messages.
+ * @order:     processing order of the lane test messages.
+ * @fsem:      fiber semaphore of the fiber test.
+ * @mem:       buffers of the os_malloc shard test.
  **/
 typedef struct {
-	char  *msg_info;
-	void  *thread[OS_THREAD_LIMIT];
-	sem_t  suspend;
+	char       *msg_info;
+	void       *thread[OS_THREAD_LIMIT];
+	sem_t       suspend;
+	sem_t       block;
+	atomic_int  tick;
+	char            order[BUT_LEN];
+	os_fiber_sem_t  fsem;
+	void           *mem[BUT_LEN];
 } but_stat_t;
 
 /**
@@ -69,6 +105,22 @@ typedef struct {
   ============================================================================*/
 static void but_mt_msg_send(int his_idx, int my_idx);
 
+static int but_queue_self(void);
+static int but_malloc_diag(void);
+static int but_malloc_profile(void);
+static int but_arena(void);
+static int but_malloc_grow(void);
+static int but_malloc_shard(void);
+static int but_fiber(void);
+static int but_queue_lane(void);
+static int but_queue_call(void);
+static int but_queue_timer(void);
+static int but_thread_stats(void);
+static int but_thread_grow(void);
+static int but_thread_attr(void);
+static int but_pool(void);
+static int but_queue_full(void);
+static int but_queue_post(void);
 static int but_multi_thread(void);
 static int but_queue_limit(void);
 static int but_malloc_limit(void);
@@ -89,6 +141,9 @@ static test_stat_t *vote_p;
 /* State of the but system. */
 static but_stat_t but_stat;
 
+/* Call site of the os_malloc profile test. */
+static char but_site[] = "but_site";
+
 /* List of the of basic van OS test cases. */
 static test_elem_t but_system[] = {
 	{ TEST_ADD(but_trap), 0 },
@@ -101,6 +156,22 @@ static test_elem_t but_system[] = {
 	{ TEST_ADD(but_malloc_limit), 0 },
 	{ TEST_ADD(but_queue_limit), 0 },
 	{ TEST_ADD(but_multi_thread), 0 },
+	{ TEST_ADD(but_queue_post), 0 },
+	{ TEST_ADD(but_queue_full), 0 },
+	{ TEST_ADD(but_pool), 0 },
+	{ TEST_ADD(but_thread_attr), 0 },
+	{ TEST_ADD(but_thread_grow), 0 },
+	{ TEST_ADD(but_thread_stats), 0 },
+	{ TEST_ADD(but_queue_timer), 0 },
+	{ TEST_ADD(but_queue_call), 0 },
+	{ TEST_ADD(but_queue_lane), 0 },
+	{ TEST_ADD(but_fiber), 0 },
+	{ TEST_ADD(but_malloc_shard), 0 },
+	{ TEST_ADD(but_malloc_grow), 0 },
+	{ TEST_ADD(but_arena), 0 },
+	{ TEST_ADD(but_malloc_profile), 0 },
+	{ TEST_ADD(but_malloc_diag), 0 },
+	{ TEST_ADD(but_queue_self), 0 },
 	{ NULL, NULL, 0 }
 };
 
@@ -211,175 +282,283 @@ static void but_msg_exec(os_queue_elem_t *m)
 }
 
 /**
- * but_msg_send() - send the message to the test thread.
+ * but_block_exec() - suspend the test thread until the main process releases
+ * it.
  *
- * @server:  address of test thread.
+ * @m:  pointer to the received message.
  *
  * Return:	None.
  **/
-static void but_msg_send(void *thread)
+static void but_block_exec(os_queue_elem_t *m)
+{
+	/* Suspend the test thread. */
+	os_sem_wait(&but_stat.block);
+
+	/* Resume the main process. */
+	os_sem_release(&but_stat.suspend);
+}
+
+/**
+ * but_fork_exec() - distribute the message over the workers of the thread
+ * pool.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void but_fork_exec(os_queue_elem_t *m)
 {
         but_msg_t msg;
+	int i;
 
-	/* Define the test message. */
+	/* Define the forked messages. */
 	os_memset(&msg, 0, sizeof(msg));
-	msg.param = thread;
+	msg.param = m->param;
 	msg.cb    = but_msg_exec;
 	os_strcpy(msg.buf, BUT_LEN, but_stat.msg_info);
 
-	/* Send the message to the test thread. */
-	OS_SEND(thread, &msg, sizeof(msg));
+	/* Fill the deque of the current worker for the other workers. */
+	for (i = 0; i < BUT_FORK_N; i++)
+		os_pool_submit(m->param, (os_queue_elem_t *) &msg, sizeof(msg));
+
+	/* Resume the main process. */
+	os_sem_release(&but_stat.suspend);
 }
 
 /**
- * but_multi_thread() - send a message from one thread to the other.
+ * but_tick_exec() - count the periodic messages in the test thread context.
  *
- * Return:	the execution state..
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
  **/
-static int but_multi_thread(void)
+static void but_tick_exec(os_queue_elem_t *m)
 {
-	os_statistics_t expected = { 6, 4, 0, 2322, 2322, 0 };
-	char name[OS_MAX_NAME_LEN];
-	void **p;
-	int i, stat;
+	int n;
 
-	/* Define the message information. */
-	but_stat.msg_info = "ping";
+	/* Update the number of the periodic messages. */
+	n = atomic_fetch_add(&but_stat.tick, 1) + 1;
 
-	/* Get the start adderss of the global thread list. */
-	p = but_stat.thread;
+	/* Resume the main process only once. */
+	if (n == BUT_TICK_N)
+		os_sem_release(&but_stat.suspend);
+}
+
+/**
+ * but_call_exec() - answer the synchronous call with the message buffer in
+ * the test thread context.
+ *
+ * @m:  pointer to the received request.
+ *
+ * Return:	None.
+ **/
+static void but_call_exec(os_queue_elem_t *m)
+{
+        but_msg_t *msg;
+	int ret;
 	
-	/* Create the control semaphore for the main process. */
-	os_sem_init(&but_stat.suspend, 0);
+	/* Decode the test message. */
+        msg = (but_msg_t *) m;
 
-	/* Install all available threads. */
-	for (i = 0; i < OS_THREAD_LIMIT; i++) {
-		/* Build the thread name. */
-		snprintf(name, OS_MAX_NAME_LEN, "test_%d", i + 1);
-		
-		/* Create and start the test thread. */
-		p[i] = os_thread_create(name, OS_THREAD_PRIO_FOREG, 256);
-	}
+	/* Test the message buffer. */
+	ret = os_strcmp(msg->buf, but_stat.msg_info);
+	OS_TRAP_IF(ret != 0);
 
-	/* Send the first multi thread message. */
-	but_mt_msg_send(0, 0);
+	/* Return the message buffer to the caller. */
+	os_reply(m, msg->buf, os_strlen(msg->buf) + 1);
+}
+
+/**
+ * but_answer_exec() - answer the forwarded synchronous call in the context
+ * of the second test thread.
+ *
+ * @m:  pointer to the message with the forwarded request.
+ *
+ * Return:	None.
+ **/
+static void but_answer_exec(os_queue_elem_t *m)
+{
+        but_msg_t *msg;
 	
-	/* Suspend the main process. */
-	os_sem_wait(&but_stat.suspend);
+	/* Decode the forwarded request. */
+        msg = m->param;
 
-	/* Kill all installed threads. */
-	for (i = 0; i < OS_THREAD_LIMIT; i++) {
-		/* Kill the test thread. */
-		os_thread_destroy(p[i]);
-	}
+	/* Return the message buffer to the caller. */
+	os_reply((os_queue_elem_t *) msg, msg->buf, os_strlen(msg->buf) + 1);
+}
 
-	/* Release the control semaphore for the main process. */
-	os_sem_delete(&but_stat.suspend);
+/**
+ * but_forward_exec() - pass the synchronous call to the second test thread
+ * without answer in the test thread context.
+ *
+ * @m:  pointer to the received request.
+ *
+ * Return:	None.
+ **/
+static void but_forward_exec(os_queue_elem_t *m)
+{
+	os_queue_elem_t msg;
 
-	/* Reset the global thread list. */
-	os_memset(p, 0, sizeof(void *) * OS_THREAD_LIMIT);
-	
-	/* Verify the OS state. */
-	stat = test_os_stat(&expected);
+	/* Define the message with the reference to the request. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = m;
+	msg.cb    = but_answer_exec;
+
+	/* Send the request to the second test thread. */
+	OS_SEND(but_stat.thread[0], &msg, sizeof(msg));
+}
+
+/**
+ * but_lane_exec() - save the processing order of the lane test messages in
+ * the test thread context.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void but_lane_exec(os_queue_elem_t *m)
+{
+        but_msg_t *msg;
+	int n;
 	
-	return stat;
+	/* Decode the test message. */
+        msg = (but_msg_t *) m;
+
+	/* Append the lane tag of the message. */
+	n = atomic_fetch_add(&but_stat.tick, 1);
+	but_stat.order[n] = msg->buf[0];
+
+	/* Resume the main process after the last message. */
+	if (n + 1 == BUT_HIGH_N + BUT_BULK_N)
+		os_sem_release(&but_stat.suspend);
 }
 
 /**
- * but_queue_limit() - fill the thread input queue up to the limit.
+ * but_fiber_exec() - wait for the fiber semaphore in a loop.
  *
- * Return:	the execution state..
+ * @arg:  not used.
+ *
+ * Return:	None.
  **/
-static int but_queue_limit(void)
+static void but_fiber_exec(void *arg)
 {
-	os_statistics_t expected = { 6, 4, 0, 2306, 2306, 0 };
-	void *p;
-	int i, stat;
+	int i;
 
-	/* Define the message information. */
-	but_stat.msg_info = "ping";
-	
-	/* Create the control semaphore for the main process. */
-	os_sem_init(&but_stat.suspend, 0);
+	/* Loop over the events of the fiber. */
+	for (i = 0; i < BUT_TICK_N; i++) {
+		/* Suspend the fiber, but not the test thread. */
+		os_fiber_sem_wait(&but_stat.fsem);
+		atomic_fetch_add(&but_stat.tick, 1);
 
-	/* Create and start the test thread. */
-	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 256);
+		/* Give way to the other fibers. */
+		os_fiber_yield();
+	}
 
-	/* Send the messagae to the test thread and verify the cleanup of the
-	 *  message queue in os_exit. */
-	for (i = 0; i < 256; i++)
-		but_msg_send(p);
+	/* Resume the main process. */
+	os_sem_release(&but_stat.suspend);
+}
 
-	/* Suspend the main process. */
-	os_sem_wait(&but_stat.suspend);
+/**
+ * but_alloc_exec() - allocate buffers in the test thread context.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void but_alloc_exec(os_queue_elem_t *m)
+{
+	int i;
 
-	/* Kill the test thread. */
-	os_thread_destroy(p);
+	/* Fill the shard of the test thread. */
+	for (i = 0; i < BUT_LEN; i++)
+		but_stat.mem[i] = OS_MALLOC(i + 1);
 
-	/* Release the control semaphore for the main process. */
-	os_sem_delete(&but_stat.suspend);
+	/* Resume the main process. */
+	os_sem_release(&but_stat.suspend);
+}
 
-	/* Verify the OS state. */
-	stat = test_os_stat(&expected);
-	
-	return stat;
+/**
+ * but_self_exec() - send the message again to the own thread, which input
+ * queue is full, in the test thread context.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void but_self_exec(os_queue_elem_t *m)
+{
+	int n;
+
+	/* Update the number of the received messages. */
+	n = atomic_fetch_add(&but_stat.tick, 1) + 1;
+
+	/* Resume the main process only once. */
+	if (n == BUT_SELF_N)
+		os_sem_release(&but_stat.suspend);
+
+	/* Forward the message to the own thread. */
+	if (n < BUT_SELF_N)
+		OS_SEND(m->param, m, sizeof(but_msg_t));
 }
 
 /**
- * but_malloc_limit() - loop over malloc and free.
+ * but_msg_send() - send the message to the test thread.
  *
- * Return:	the execution state..
+ * @server:  address of test thread.
+ *
+ * Return:	None.
  **/
-static int but_malloc_limit(void)
+static void but_msg_send(void *thread)
 {
-	os_statistics_t expected = { 6, 4, 0, 2050, 2050, 0 };
-	int i, stat;
-	void *p;
+        but_msg_t msg;
 
-	/* malloc and free test */
-	for (i = 0; i < (2 * OS_MALLOC_LIMIT); i++) {
-		p = OS_MALLOC(1);
-		OS_FREE(p);
-		p = OS_MALLOC(1);
-		OS_FREE(p);
-	}
+	/* Define the test message. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = thread;
+	msg.cb    = but_msg_exec;
+	os_strcpy(msg.buf, BUT_LEN, but_stat.msg_info);
 
-	/* Verify the OS state. */
-	stat = test_os_stat(&expected);
-	
-	return stat;
+	/* Send the message to the test thread. */
+	OS_SEND(thread, &msg, sizeof(msg));
 }
 
 /**
- * but_queue() - test the thread input queue.
+ * but_queue_self() - verify that the callbacks may send to their own thread
+ * at the limit of the input queue.
  *
- * Return:	the execution state..
+ * Return:	the execution state.
  **/
-static int but_queue(void)
+static int but_queue_self(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2, 2, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10756, 10753, 0 };
+	but_msg_t msg;
 	void *p;
-	int stat;
+	int i, stat;
 
-	/* Define the message information. */
-	but_stat.msg_info = "ping";
-	
-	/* Create the control semaphore for the main process. */
+	/* Reset the message counter. */
+	atomic_init(&but_stat.tick, 0);
+
+	/* Create the control semaphore. */
 	os_sem_init(&but_stat.suspend, 0);
 
-	/* Create and start the test thread. */
-	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 256);
+	/* Create and start the test thread with the minimal queue. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, BUT_SELF_Q);
 
-	/* Start the interworking with the test thread. */
-	but_msg_send(p);
+	/* Fill the input queue of the test thread. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = p;
+	msg.cb    = but_self_exec;
+	for (i = 0; i < BUT_SELF_Q; i++)
+		OS_SEND(p, &msg, sizeof(msg));
 
-	/* Suspend the main process. */
+	/* Wait for the forwarded messages. */
 	os_sem_wait(&but_stat.suspend);
+	TEST_ASSERT_EQ(1, atomic_load(&but_stat.tick) >= BUT_SELF_N);
 
 	/* Kill the test thread. */
 	os_thread_destroy(p);
 
-	/* Release the control semaphore for the main process. */
+	/* Release the control semaphore. */
 	os_sem_delete(&but_stat.suspend);
 
 	/* Verify the OS state. */
@@ -389,34 +568,82 @@ static int but_queue(void)
 }
 
 /**
- * but_thread_limit() - install and kill all availabe threads.
+ * but_malloc_diag() - verify the leak report and the poisoned buffers of the
+ * diagnostic mode.
  *
- * Return:	the execution state..
+ * Return:	the execution state.
  **/
-static int but_thread_limit(void)
+static int but_malloc_diag(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 1, 1, 0 };
-	char name[OS_MAX_NAME_LEN];
-	void *p[OS_THREAD_LIMIT];
-	int i, j, stat;
+	os_statistics_t expected = { 8, 5, 0, 10755, 10752, 0 };
+	unsigned char *p, *q;
+	int i, n, stat;
 
-	j = OS_THREAD_LIMIT;
-	
-	/* Install all available threads. */
-	for (i = 0; i < j; i++) {
-		/* Build the thread name. */
-		snprintf(name, OS_MAX_NAME_LEN, "test_%d", i + 1);
-		
-		/* Create and start the test thread. */
-		p[i] = os_thread_create(name, OS_THREAD_PRIO_FOREG, 256);
-	}
+	/* Report the outstanding buffer. */
+	n = os_mem_leak_dump();
+	p = os_malloc(BUT_LEN, __FILE__, __LINE__);
+	TEST_ASSERT_EQ(n + 1, os_mem_leak_dump());
 
-	/* Kill all installed threads. */
-	for (j = j - 1; j >= 0; j--) {
-		/* Kill the test thread. */
-		os_thread_destroy(p[j]);
-	}
+	/* The quarantine holds back the released buffer. */
+	os_memset(p, 0, BUT_LEN);
+	q = p;
+	os_free((void **) &p);
+	for (i = 0, n = 0; i < BUT_LEN; i++)
+		n += q[i] == OS_MEM_POISON;
+
+	TEST_ASSERT_EQ(BUT_LEN, n);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
 	
+	return stat;
+}
+
+/**
+ * but_malloc_profile() - verify the byte counters and the lifetime histogram
+ * of an os_malloc call site.
+ *
+ * Return:	the execution state.
+ **/
+static int but_malloc_profile(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 10754, 10751, 0 };
+	os_mem_site_stats_t st;
+	void *mem[BUT_LEN];
+	unsigned long long n;
+	int i, ret, stat;
+
+	/* The call site is unknown. */
+	ret = os_mem_profile(but_site, 1, &st);
+	TEST_ASSERT_EQ(-1, ret);
+
+	/* Allocate the buffers of the call site. */
+	for (i = 0; i < BUT_LEN; i++)
+		mem[i] = os_malloc(100, but_site, 1);
+
+	ret = os_mem_profile(but_site, 1, &st);
+	TEST_ASSERT_EQ(0, ret);
+	TEST_ASSERT_EQ(BUT_LEN * 100, (int) st.live);
+	TEST_ASSERT_EQ(BUT_LEN * 100, (int) st.peak);
+
+	/* Release the buffers and print the profiles. */
+	for (i = 0; i < BUT_LEN; i++)
+		os_free(&mem[i]);
+
+	os_mem_profile_dump();
+
+	/* Verify the counters and the lifetime histogram. */
+	ret = os_mem_profile(but_site, 1, &st);
+	for (i = 0, n = 0; i < OS_MEM_HIST_LEN; i++)
+		n += st.hist[i];
+
+	TEST_ASSERT_EQ(0, ret);
+	TEST_ASSERT_EQ(0, (int) st.live);
+	TEST_ASSERT_EQ(BUT_LEN * 100, (int) st.peak);
+	TEST_ASSERT_EQ(BUT_LEN, (int) st.alloc_c);
+	TEST_ASSERT_EQ(BUT_LEN, (int) st.free_c);
+	TEST_ASSERT_EQ(BUT_LEN, (int) n);
+
 	/* Verify the OS state. */
 	stat = test_os_stat(&expected);
 	
@@ -424,13 +651,983 @@ static int but_thread_limit(void)
 }
 
 /**
- * but_thread() - test the thread handling.
+ * but_arena() - reuse the buffers of the size classes and reset the arena.
  *
- * Return:	the execution state..
+ * Return:	the execution state.
  **/
-static int but_thread(void)
+static int but_arena(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 1, 1, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10722, 10719, 0 };
+	os_arena_stats_t st;
+	void *arena, *p, *q;
+	int i, stat;
+
+	/* Create an arena with small chunks. */
+	arena = os_arena_create("test", 4096);
+
+	/* Reuse the released buffer of the same size class. */
+	p = os_arena_alloc(arena, 20);
+	os_arena_free(arena, p, 20);
+	q = os_arena_alloc(arena, 32);
+	TEST_ASSERT_EQ(1, p == q);
+	TEST_ASSERT_EQ(0, (int) ((long) q % 16));
+
+	/* Fill more than one chunk without release. */
+	for (i = 0; i < BUT_LEN; i++)
+		os_arena_alloc(arena, 1000);
+
+	os_arena_stats(arena, &st);
+	TEST_ASSERT_EQ(BUT_LEN + 1, (int) st.live);
+	TEST_ASSERT_EQ(BUT_LEN + 1, (int) st.peak);
+	TEST_ASSERT_EQ(BUT_LEN / 4 + 1, (int) st.chunk_c);
+
+	/* Release all buffers at once and repeat the cycle in the kept
+	 * chunks. */
+	os_arena_reset(arena);
+	for (i = 0; i < BUT_LEN; i++)
+		os_arena_alloc(arena, 1000);
+
+	os_arena_stats(arena, &st);
+	TEST_ASSERT_EQ(BUT_LEN, (int) st.live);
+	TEST_ASSERT_EQ(BUT_LEN / 4 + 1, (int) st.chunk_c);
+
+	/* Release the arena. */
+	os_arena_reset(arena);
+	os_arena_destroy(arena);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_malloc_grow() - keep more buffers outstanding than the first chunk of
+ * the os_malloc shard provides.
+ *
+ * Return:	the execution state.
+ **/
+static int but_malloc_grow(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 10712, 10709, 0 };
+	static void *mem[BUT_MEM_N];
+	os_mem_usage_t usage;
+	int i, stat;
+
+	/* Allocate the buffers without release. */
+	for (i = 0; i < BUT_MEM_N; i++)
+		mem[i] = os_malloc(1, __FILE__, __LINE__);
+
+	/* Verify the growth of the tracker. */
+	os_mem_usage(&usage);
+	TEST_ASSERT_EQ(1, usage.live >= BUT_MEM_N);
+	TEST_ASSERT_EQ(1, usage.slots >= usage.live);
+	TEST_ASSERT_EQ(1, usage.per_alloc > 0);
+
+	/* Release the buffers. */
+	for (i = 0; i < BUT_MEM_N; i++)
+		os_free(&mem[i]);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_malloc_shard() - release the buffers of another thread's os_malloc
+ * shard after the termination of the thread.
+ *
+ * Return:	the execution state.
+ **/
+static int but_malloc_shard(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 6616, 6613, 0 };
+	os_queue_elem_t msg;
+	void *p;
+	int i, stat;
+
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Create and start the test thread. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 16);
+
+	/* Allocate the buffers in the test thread. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.cb = but_alloc_exec;
+	OS_SEND(p, &msg, sizeof(msg));
+	os_sem_wait(&but_stat.suspend);
+
+	/* Kill the test thread, its shard is orphaned. */
+	os_thread_destroy(p);
+
+	/* Free the buffers of the orphaned shard. */
+	for (i = 0; i < BUT_LEN; i++)
+		OS_FREE(but_stat.mem[i]);
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_fiber() - multiplex blocking loops as fibers on one test thread.
+ *
+ * Return:	the execution state.
+ **/
+static int but_fiber(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 6583, 6580, 0 };
+	void *p;
+	int i, stat;
+
+	/* Reset the event counter. */
+	atomic_init(&but_stat.tick, 0);
+
+	/* Create the control semaphores. */
+	os_sem_init(&but_stat.suspend, 0);
+	os_fiber_sem_init(&but_stat.fsem, 0);
+
+	/* Create and start the test thread with its fibers. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 16);
+	for (i = 0; i < BUT_FIBER_N; i++)
+		os_fiber_create(p, but_fiber_exec, NULL, 0);
+
+	/* Resume the waiting fibers. */
+	for (i = 0; i < BUT_FIBER_N * BUT_TICK_N; i++)
+		os_fiber_sem_post(&but_stat.fsem);
+
+	/* Wait for the termination of the fibers. */
+	for (i = 0; i < BUT_FIBER_N; i++)
+		os_sem_wait(&but_stat.suspend);
+
+	TEST_ASSERT_EQ(BUT_FIBER_N * BUT_TICK_N, atomic_load(&but_stat.tick));
+
+	/* Kill the test thread. */
+	os_thread_destroy(p);
+
+	/* Release the control semaphores. */
+	os_fiber_sem_delete(&but_stat.fsem);
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_queue_lane() - verify the priority, the limit and the telemetry of the
+ * lanes of the thread input queue.
+ *
+ * Return:	the execution state.
+ **/
+static int but_queue_lane(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 6576, 6573, 0 };
+	os_thread_stats_t st;
+	but_msg_t msg;
+	void *p;
+	int i, ret, stat;
+
+	/* Reset the processing order. */
+	atomic_init(&but_stat.tick, 0);
+	os_memset(but_stat.order, 0, BUT_LEN);
+	
+	/* Create the control semaphores. */
+	os_sem_init(&but_stat.suspend, 0);
+	os_sem_init(&but_stat.block, 0);
+
+	/* Create and start the test thread and limit the urgent lane. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 16);
+	os_queue_lane_limit(p, OS_QUEUE_LANE_HIGH, BUT_HIGH_N);
+
+	/* Block the test thread. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = p;
+	msg.cb    = but_block_exec;
+	OS_SEND(p, &msg, sizeof(msg));
+
+	/* Fill the bulk lane before the urgent lane. */
+	msg.cb = but_lane_exec;
+	os_strcpy(msg.buf, BUT_LEN, "b");
+	for (i = 0; i < BUT_BULK_N; i++)
+		OS_SEND_LANE(p, OS_QUEUE_LANE_BULK, &msg, sizeof(msg));
+
+	os_strcpy(msg.buf, BUT_LEN, "h");
+	for (i = 0; i < BUT_HIGH_N; i++)
+		OS_SEND_LANE(p, OS_QUEUE_LANE_HIGH, &msg, sizeof(msg));
+
+	/* The urgent lane is full, the other lanes are not. */
+	ret = os_queue_try_send_lane(p, OS_QUEUE_LANE_HIGH,
+				     (os_queue_elem_t *) &msg, sizeof(msg));
+	TEST_ASSERT_EQ(-1, ret);
+
+	/* Resume the test thread and wait for all messages. */
+	os_sem_release(&but_stat.block);
+	os_sem_wait(&but_stat.suspend);
+	os_sem_wait(&but_stat.suspend);
+
+	/* The urgent messages overtake the bulk messages. */
+	TEST_ASSERT_EQ(0, os_strcmp(but_stat.order, "hhbbbb"));
+
+	/* Verify the telemetry of the lanes. */
+	os_thread_lane_stats(p, OS_QUEUE_LANE_HIGH, &st);
+	TEST_ASSERT_EQ(BUT_HIGH_N, (int) st.processed);
+	os_thread_lane_stats(p, OS_QUEUE_LANE_BULK, &st);
+	TEST_ASSERT_EQ(BUT_BULK_N, (int) st.processed);
+	TEST_ASSERT_EQ(BUT_BULK_N, st.max_depth);
+	os_thread_stats(p, &st);
+	TEST_ASSERT_EQ(1 + BUT_HIGH_N + BUT_BULK_N, (int) st.processed);
+
+	/* The thread does not record the latencies by default. */
+	TEST_ASSERT_EQ(0, (int) st.lat_max);
+	TEST_ASSERT_EQ(0, (int) st.hist[0]);
+
+	/* Kill the test thread. */
+	os_thread_destroy(p);
+
+	/* Release the control semaphores. */
+	os_sem_delete(&but_stat.block);
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_queue_call() - execute synchronous calls of the test thread, which
+ * answers them itself or passes them to a second thread.
+ *
+ * Return:	the execution state.
+ **/
+static int but_queue_call(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 6575, 6572, 0 };
+	char reply[BUT_LEN];
+	but_msg_t msg;
+	void *p;
+	int i, n, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "call";
+	
+	/* Create and start the test thread. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 16);
+
+	/* Define the test message. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = p;
+	msg.cb    = but_call_exec;
+	os_strcpy(msg.buf, BUT_LEN, but_stat.msg_info);
+
+	/* Execute a series of round trips. */
+	for (i = 0; i < BUT_LEN; i++) {
+		os_memset(reply, 0, BUT_LEN);
+		n = os_call(p, (os_queue_elem_t *) &msg, sizeof(msg), reply,
+			    BUT_LEN);
+		TEST_ASSERT_EQ(5, n);
+		TEST_ASSERT_EQ(0, os_strcmp(reply, but_stat.msg_info));
+	}
+
+	/* The reply is truncated to the buffer of the caller. */
+	n = os_call(p, (os_queue_elem_t *) &msg, sizeof(msg), reply, 2);
+	TEST_ASSERT_EQ(2, n);
+
+	/* A caller may ignore the reply. */
+	n = os_call(p, (os_queue_elem_t *) &msg, sizeof(msg), NULL, 0);
+	TEST_ASSERT_EQ(0, n);
+
+	/* The receiver passes the requests to a second thread. */
+	but_stat.thread[0] = os_thread_create("answer", OS_THREAD_PRIO_FOREG, 16);
+	msg.cb = but_forward_exec;
+	for (i = 0; i < BUT_LEN; i++) {
+		os_memset(reply, 0, BUT_LEN);
+		n = os_call(p, (os_queue_elem_t *) &msg, sizeof(msg), reply,
+			    BUT_LEN);
+		TEST_ASSERT_EQ(5, n);
+		TEST_ASSERT_EQ(0, os_strcmp(reply, but_stat.msg_info));
+	}
+
+	/* Kill the test threads: the receiver may still forward the last
+	 * request. */
+	os_thread_destroy(p);
+	os_thread_destroy(but_stat.thread[0]);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_queue_timer() - send delayed and periodic messages to the test thread,
+ * cancel pending timers and overfill the input queue with timer messages.
+ *
+ * Return:	the execution state.
+ **/
+static int but_queue_timer(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 6573, 6570, 0 };
+	int id[BUT_TIMER_N];
+	but_msg_t msg;
+	void *p;
+	int i, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "timer";
+	atomic_init(&but_stat.tick, 0);
+	
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Create and start the test thread. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 16);
+
+	/* Define the test message. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = p;
+	msg.cb    = but_msg_exec;
+	os_strcpy(msg.buf, BUT_LEN, but_stat.msg_info);
+
+	/* Send a delayed message and wait for it. */
+	id[0] = os_queue_send_after(p, (os_queue_elem_t *) &msg, sizeof(msg), 20);
+	os_sem_wait(&but_stat.suspend);
+
+	/* The sent message cannot be cancelled. */
+	TEST_ASSERT_EQ(-1, os_queue_cancel(id[0]));
+
+	/* Install many long timers across the wheel levels. */
+	for (i = 0; i < BUT_TIMER_N; i++)
+		id[i] = os_queue_send_after(p, (os_queue_elem_t *) &msg,
+					    sizeof(msg), 100 * (i + 1));
+
+	/* A short timer resumes the sleeping timer thread. */
+	os_queue_send_after(p, (os_queue_elem_t *) &msg, sizeof(msg), 20);
+	os_sem_wait(&but_stat.suspend);
+
+	/* Cancel all long timers. */
+	for (i = 0; i < BUT_TIMER_N; i++)
+		TEST_ASSERT_EQ(0, os_queue_cancel(id[i]));
+
+	/* Send periodic messages and wait for them. */
+	msg.cb = but_tick_exec;
+	id[0] = os_queue_send_every(p, (os_queue_elem_t *) &msg, sizeof(msg), 5);
+	os_sem_wait(&but_stat.suspend);
+
+	/* Stop the periodic messages. */
+	TEST_ASSERT_EQ(0, os_queue_cancel(id[0]));
+	TEST_ASSERT_EQ(-1, os_queue_cancel(id[0]));
+	TEST_ASSERT_EQ(1, atomic_load(&but_stat.tick) >= BUT_TICK_N);
+
+	/* Block the test thread. */
+	os_sem_init(&but_stat.block, 0);
+	msg.cb = but_block_exec;
+	OS_SEND(p, &msg, sizeof(msg));
+
+	/* Overfill the input queue with the timer messages: the periodic
+	 * messages are dropped and the delayed message is retried. */
+	msg.cb = but_tick_exec;
+	os_queue_send_every(p, (os_queue_elem_t *) &msg, sizeof(msg), 1);
+	os_queue_send_after(p, (os_queue_elem_t *) &msg, sizeof(msg), 1);
+	usleep(50 * 1000);
+
+	/* Kill the test thread with the pending timers. */
+	os_sem_release(&but_stat.block);
+	os_thread_destroy(p);
+
+	/* Release the control semaphores for the main process. */
+	os_sem_delete(&but_stat.block);
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_thread_stats() - verify the telemetry of the thread input queue.
+ *
+ * Return:	the execution state..
+ **/
+static int but_thread_stats(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2454, 2454, 0 };
+	os_thread_attr_t attr, eff;
+	os_thread_stats_t st;
+	unsigned long long n;
+	void *p;
+	int i, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "ping";
+	
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Create and start the test thread, which records the latencies. */
+	os_memset(&attr, 0, sizeof(attr));
+	attr.policy  = OS_THREAD_POLICY_INHERIT;
+	attr.latency = 1;
+	p = os_thread_create_ext("test", &attr, 256);
+	os_thread_attr_get(p, &eff);
+	TEST_ASSERT_EQ(1, eff.latency);
+
+	/* Send a burst of messages to the test thread. */
+	for (i = 0; i < BUT_LEN; i++)
+		but_msg_send(p);
+
+	/* Wait for the processing of all messages. */
+	for (i = 0; i < BUT_LEN; i++)
+		os_sem_wait(&but_stat.suspend);
+
+	/* Get and print the telemetry of the test thread. */
+	os_thread_stats(p, &st);
+	os_thread_stats_dump();
+
+	/* Kill the test thread. */
+	os_thread_destroy(p);
+
+	/* Verify the telemetry. */
+	for (i = 0, n = 0; i < OS_THREAD_HIST_LEN; i++)
+		n += st.hist[i];
+
+	TEST_ASSERT_EQ(BUT_LEN, (int) st.processed);
+	TEST_ASSERT_EQ(BUT_LEN, (int) n);
+	TEST_ASSERT_EQ(0, st.depth);
+	TEST_ASSERT_EQ(1, st.max_depth >= 1 && st.max_depth <= BUT_LEN);
+	TEST_ASSERT_EQ(1, st.lat_max > 0 && st.lat_sum >= st.lat_max);
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_thread_grow() - install more threads than a chunk of the thread table
+ * and reuse the released table entries.
+ *
+ * Return:	the execution state..
+ **/
+static int but_thread_grow(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2453, 2453, 0 };
+	os_statistics_t current;
+	char name[OS_MAX_NAME_LEN];
+	void *p[BUT_GROW_N];
+	int i, stat;
+
+	/* Install the threads. */
+	for (i = 0; i < BUT_GROW_N; i++) {
+		snprintf(name, OS_MAX_NAME_LEN, "test_%d", i + 1);
+		p[i] = os_thread_create(name, OS_THREAD_PRIO_FOREG, 16);
+	}
+
+	/* Verify the number of the installed threads. */
+	os_statistics(&current);
+	TEST_ASSERT_EQ(BUT_GROW_N, current.thread_c);
+
+	/* Kill every second thread. */
+	for (i = 0; i < BUT_GROW_N; i += 2)
+		os_thread_destroy(p[i]);
+
+	/* Install the threads again in the released table entries. */
+	for (i = 0; i < BUT_GROW_N; i += 2) {
+		snprintf(name, OS_MAX_NAME_LEN, "again_%d", i + 1);
+		p[i] = os_thread_create(name, OS_THREAD_PRIO_FOREG, 16);
+	}
+
+	/* Verify the number of the installed threads. */
+	os_statistics(&current);
+	TEST_ASSERT_EQ(BUT_GROW_N, current.thread_c);
+
+	/* Kill all installed threads. */
+	for (i = 0; i < BUT_GROW_N; i++)
+		os_thread_destroy(p[i]);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_thread_attr() - create threads with explicit scheduling attributes and
+ * verify the effective values.
+ *
+ * Return:	the execution state..
+ **/
+static int but_thread_attr(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2357, 2357, 0 };
+	os_thread_attr_t attr, eff;
+	void *p;
+	int stat;
+
+	/* Pin the thread to the first CPU with a stack of 1 MB; an absent CPU
+	 * beyond the first word of the CPU set is ignored. */
+	os_memset(&attr, 0, sizeof(attr));
+	OS_CPU_SET(0, attr.cpu_set);
+	OS_CPU_SET(OS_THREAD_CPU_N - 1, attr.cpu_set);
+	attr.policy     = OS_THREAD_POLICY_OTHER;
+	attr.prio       = 0;
+	attr.stack_size = 1024 * 1024;
+
+	/* Create the test thread and get the effective values. */
+	p = os_thread_create_ext("test", &attr, 256);
+	os_thread_attr_get(p, &eff);
+	os_thread_destroy(p);
+
+	/* Verify the effective values. */
+	TEST_ASSERT_EQ(1, OS_CPU_ISSET(0, eff.cpu_set));
+	TEST_ASSERT_EQ(1, (int) eff.cpu_set[0]);
+	TEST_ASSERT_EQ(OS_THREAD_POLICY_OTHER, eff.policy);
+	TEST_ASSERT_EQ(0, eff.prio);
+	TEST_ASSERT_EQ(1, eff.stack_size >= attr.stack_size);
+
+	/* Request a realtime policy. */
+	os_memset(&attr, 0, sizeof(attr));
+	attr.policy = OS_THREAD_POLICY_RR;
+	attr.prio   = OS_THREAD_PRIO_FOREG;
+
+	/* Create the test thread and get the effective values. */
+	p = os_thread_create_ext("test", &attr, 256);
+	os_thread_attr_get(p, &eff);
+	os_thread_destroy(p);
+
+	/* Without privileges the thread keeps the time-sharing policy. */
+	if (eff.policy == OS_THREAD_POLICY_RR)
+		TEST_ASSERT_EQ(OS_THREAD_PRIO_FOREG, eff.prio);
+	else
+		TEST_ASSERT_EQ(OS_THREAD_POLICY_OTHER, eff.policy);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_pool() - distribute messages over the workers of a thread pool.
+ *
+ * Return:	the execution state..
+ **/
+static int but_pool(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2355, 2355, 0 };
+	but_msg_t msg;
+	void *pool;
+	int i, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "ping";
+	
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Create and start the thread pool. */
+	pool = os_pool_create("pool", BUT_POOL_SIZE);
+
+	/* Define the messages, which fork the next messages. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = pool;
+	msg.cb    = but_fork_exec;
+
+	/* Distribute the messages over the workers. */
+	for (i = 0; i < BUT_POOL_SIZE; i++)
+		os_pool_submit(pool, (os_queue_elem_t *) &msg, sizeof(msg));
+
+	/* Wait for the processing of all messages. */
+	for (i = 0; i < BUT_POOL_SIZE * (BUT_FORK_N + 1); i++)
+		os_sem_wait(&but_stat.suspend);
+
+	/* Stop the thread pool, while the workers fork the next messages. */
+	for (i = 0; i < BUT_POOL_SIZE; i++)
+		os_pool_submit(pool, (os_queue_elem_t *) &msg, sizeof(msg));
+
+	os_pool_destroy(pool);
+
+	/* All forked messages have been processed. */
+	for (i = 0; i < BUT_POOL_SIZE * (BUT_FORK_N + 1); i++)
+		TEST_ASSERT_EQ(0, os_sem_timedwait(&but_stat.suspend, 0));
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_queue_full() - fill the thread input queue beyond OS_QUEUE_LIMIT, while
+ * the test thread is blocked, and verify the backpressure of the queue.
+ *
+ * Return:	the execution state..
+ **/
+static int but_queue_full(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2345, 2345, 0 };
+	os_thread_stats_t st;
+	but_msg_t msg;
+	void *p;
+	int i, limit, ret, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "ping";
+
+	/* Define the queue limit: the heap buffers beyond OS_QUEUE_LIMIT are
+	 * tracked by os_malloc. */
+	limit = OS_QUEUE_LIMIT + 256;
+	
+	/* Create the control semaphores for the main process and thread. */
+	os_sem_init(&but_stat.suspend, 0);
+	os_sem_init(&but_stat.block, 0);
+
+	/* Create and start the test thread. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, limit);
+
+	/* Block the test thread. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.param = p;
+	msg.cb    = but_block_exec;
+	ret = os_queue_try_send(p, (os_queue_elem_t *) &msg, sizeof(msg));
+	TEST_ASSERT_EQ(0, ret);
+
+	/* Wait until the blocked message has released its place. */
+	do {
+		sched_yield();
+		os_thread_stats(p, &st);
+	} while (st.depth > 0);
+
+	/* Fill the input queue. */
+	msg.cb = but_msg_exec;
+	os_strcpy(msg.buf, BUT_LEN, but_stat.msg_info);
+	for (i = 0; i < limit; i++) {
+		ret = os_queue_try_send(p, (os_queue_elem_t *) &msg, sizeof(msg));
+		TEST_ASSERT_EQ(0, ret);
+	}
+
+	/* The input queue is full. */
+	ret = os_queue_try_send(p, (os_queue_elem_t *) &msg, sizeof(msg));
+	TEST_ASSERT_EQ(-1, ret);
+	
+	ret = os_queue_send_timed(p, (os_queue_elem_t *) &msg, sizeof(msg), 10);
+	TEST_ASSERT_EQ(-1, ret);
+
+	/* Release the test thread and wait for a free place. */
+	os_sem_release(&but_stat.block);
+	ret = os_queue_send_timed(p, (os_queue_elem_t *) &msg, sizeof(msg), 5000);
+	TEST_ASSERT_EQ(0, ret);
+
+	/* Wait for the processing of all messages. */
+	for (i = 0; i < limit + 2; i++)
+		os_sem_wait(&but_stat.suspend);
+
+	/* Kill the test thread. */
+	os_thread_destroy(p);
+
+	/* Release the control semaphores. */
+	os_sem_delete(&but_stat.block);
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_queue_post() - fill the message buffers of the thread input queue in
+ * place: the first message fits the pool, the second comes from the heap.
+ * Unused message buffers are given back with their places.
+ *
+ * Return:	the execution state..
+ **/
+static int but_queue_post(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2088, 2088, 0 };
+	os_thread_stats_t st;
+	but_msg_t *msg, high;
+	void *p;
+	int i, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "ping";
+	
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Create and start the test thread. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 256);
+
+	/* Define the message of the high lane. */
+	os_memset(&high, 0, sizeof(high));
+	high.param = p;
+	high.cb    = but_msg_exec;
+	os_strcpy(high.buf, BUT_LEN, but_stat.msg_info);
+
+	/* Loop over the size classes of the message buffers. */
+	for (i = 0; i < 2; i++) {
+		/* Get the message buffer of the test thread. */
+		msg = (but_msg_t *) os_queue_alloc(p, i ? 1024 : sizeof(*msg));
+
+		/* Define the test message in place. */
+		msg->param = p;
+		msg->cb    = but_msg_exec;
+		os_strcpy(msg->buf, BUT_LEN, but_stat.msg_info);
+
+		/* Transfer the message without copy. */
+		os_queue_post(p, (os_queue_elem_t *) msg);
+
+		/* Suspend the main process. */
+		os_sem_wait(&but_stat.suspend);
+	}
+
+	/* Loop over the size classes of the abandoned message buffers. */
+	for (i = 0; i < 2; i++) {
+		/* The message buffer reserves a place in the queue. */
+		msg = (but_msg_t *) os_queue_alloc(p, i ? 1024 : sizeof(*msg));
+		os_thread_stats(p, &st);
+		TEST_ASSERT_EQ(1, st.depth);
+
+		/* The reserved place shall not stop the processing of the
+		 * other lanes. */
+		os_queue_send_lane(p, OS_QUEUE_LANE_HIGH, (os_queue_elem_t *) &high,
+				   sizeof(high));
+		os_sem_wait(&but_stat.suspend);
+
+		/* Give back the message buffer and its place. */
+		os_queue_free(p, (os_queue_elem_t *) msg);
+		os_thread_stats(p, &st);
+		TEST_ASSERT_EQ(0, st.depth);
+	}
+
+	/* Kill the test thread. */
+	os_thread_destroy(p);
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_multi_thread() - send a message from one thread to the other.
+ *
+ * Return:	the execution state..
+ **/
+static int but_multi_thread(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2085, 2085, 0 };
+	char name[OS_MAX_NAME_LEN];
+	void **p;
+	int i, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "ping";
+
+	/* Get the start adderss of the global thread list. */
+	p = but_stat.thread;
+	
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Install all available threads. */
+	for (i = 0; i < OS_THREAD_LIMIT; i++) {
+		/* Build the thread name. */
+		snprintf(name, OS_MAX_NAME_LEN, "test_%d", i + 1);
+		
+		/* Create and start the test thread. */
+		p[i] = os_thread_create(name, OS_THREAD_PRIO_FOREG, 256);
+	}
+
+	/* Send the first multi thread message. */
+	but_mt_msg_send(0, 0);
+	
+	/* Suspend the main process. */
+	os_sem_wait(&but_stat.suspend);
+
+	/* Kill all installed threads. */
+	for (i = 0; i < OS_THREAD_LIMIT; i++) {
+		/* Kill the test thread. */
+		os_thread_destroy(p[i]);
+	}
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&but_stat.suspend);
+
+	/* Reset the global thread list. */
+	os_memset(p, 0, sizeof(void *) * OS_THREAD_LIMIT);
+	
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_queue_limit() - fill the thread input queue up to the limit.
+ *
+ * Return:	the execution state..
+ **/
+static int but_queue_limit(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2069, 2069, 0 };
+	void *p;
+	int i, stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "ping";
+	
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Create and start the test thread. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 256);
+
+	/* Send the messagae to the test thread and verify the cleanup of the
+	 *  message queue in os_exit. */
+	for (i = 0; i < 256; i++)
+		but_msg_send(p);
+
+	/* Suspend the main process. */
+	os_sem_wait(&but_stat.suspend);
+
+	/* Kill the test thread. */
+	os_thread_destroy(p);
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_malloc_limit() - loop over malloc and free.
+ *
+ * Return:	the execution state..
+ **/
+static int but_malloc_limit(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 2068, 2068, 0 };
+	int i, stat;
+	void *p;
+
+	/* malloc and free test */
+	for (i = 0; i < 1024; i++) {
+		p = OS_MALLOC(1);
+		OS_FREE(p);
+		p = OS_MALLOC(1);
+		OS_FREE(p);
+	}
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_queue() - test the thread input queue.
+ *
+ * Return:	the execution state..
+ **/
+static int but_queue(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 20, 20, 0 };
+	void *p;
+	int stat;
+
+	/* Define the message information. */
+	but_stat.msg_info = "ping";
+	
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&but_stat.suspend, 0);
+
+	/* Create and start the test thread. */
+	p = os_thread_create("test", OS_THREAD_PRIO_FOREG, 256);
+
+	/* Start the interworking with the test thread. */
+	but_msg_send(p);
+
+	/* Suspend the main process. */
+	os_sem_wait(&but_stat.suspend);
+
+	/* Kill the test thread. */
+	os_thread_destroy(p);
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&but_stat.suspend);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_thread_limit() - install and kill all availabe threads.
+ *
+ * Return:	the execution state..
+ **/
+static int but_thread_limit(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 19, 19, 0 };
+	char name[OS_MAX_NAME_LEN];
+	void *p[OS_THREAD_LIMIT];
+	int i, j, stat;
+
+	j = OS_THREAD_LIMIT;
+	
+	/* Install all available threads. */
+	for (i = 0; i < j; i++) {
+		/* Build the thread name. */
+		snprintf(name, OS_MAX_NAME_LEN, "test_%d", i + 1);
+		
+		/* Create and start the test thread. */
+		p[i] = os_thread_create(name, OS_THREAD_PRIO_FOREG, 256);
+	}
+
+	/* Kill all installed threads. */
+	for (j = j - 1; j >= 0; j--) {
+		/* Kill the test thread. */
+		os_thread_destroy(p[j]);
+	}
+	
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+	
+	return stat;
+}
+
+/**
+ * but_thread() - test the thread handling.
+ *
+ * Return:	the execution state..
+ **/
+static int but_thread(void)
+{
+	os_statistics_t expected = { 6, 4, 0, 3, 3, 0 };
 	void *p;
 	char *name;
 	int stat;
@@ -127,7 +127,7 @@ static void clk_thr_exec(os_queue_elem_t *msg)
  **/
 static int clk_all_clocks(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2350, 2350, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10782, 10779, 0 };
 	os_queue_elem_t msg;
 	void *thr[OS_CLOCK_LIMIT];
 	char n[OS_MAX_NAME_LEN];
@@ -190,7 +190,7 @@ static int clk_all_clocks(void)
  **/
 static int clk_1st_clock(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2346, 2346, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10778, 10775, 0 };
 	int t_id, stat;
 	
 	/* Create the interval timer. */
@@ -227,7 +227,7 @@ static int clk_1st_clock(void)
  **/
 static int clk_stop(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2350, 2350, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10782, 10779, 0 };
 	int stat;
 
 	/* Verify the OS state. */
@@ -243,7 +243,7 @@ static int clk_stop(void)
  **/
 static int clk_start(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2346, 2346, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10778, 10775, 0 };
 	int stat;
 
 	/* Verify the OS state. */
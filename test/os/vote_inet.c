@@ -53,7 +53,7 @@ static test_elem_t inet_system[] = {
  **/
 static int inet_stop(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2382, 2382, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10837, 10834, 0 };
 	int stat;
 
 	/* Verify the OS state. */
@@ -69,7 +69,7 @@ static int inet_stop(void)
  **/
 static int inet_start(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2382, 2382, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10837, 10834, 0 };
 	int stat;
 
 	/* Verify the OS state. */
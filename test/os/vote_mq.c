@@ -10,7 +10,10 @@
 /*============================================================================
   IMPORTED INCLUDE REFERENCES
   ============================================================================*/
-#include "vote.h"  /* Van OS test environment. */
+#include "vote.h"   /* Van OS test environment. */
+#include <sched.h>  /* Scheduling interfaces: sched_yield(). */
+#include <poll.h>   /* Wait for an event on a descriptor: poll(). */
+#include <stdint.h> /* Integer types: uint64_t. */
 
 /*============================================================================
   EXPORTED INCLUDE REFERENCES
@@ -18,16 +21,38 @@
 /*============================================================================
   LOCAL NAME CONSTANTS DEFINITIONS
   ============================================================================*/
+/* Number of the records of the concurrent SPSC test. */
+#define MQ_SPSC_N  100000
+
+/* Number of the records of the blocking wait test. */
+#define MQ_WAIT_N  10000
+
 /*============================================================================
   MACROS
   ============================================================================*/
 /*============================================================================
   LOCAL TYPE DEFINITIONS
   ============================================================================*/
+/**
+ * mq_stat_t - state of the message queue tests.
+ *
+ * @suspend:  control semaphore of the main process.
+ * @q:        queue of the producer thread.
+ **/
+typedef struct {
+	sem_t   suspend;
+	void   *q;
+} mq_stat_t;
+
 /*============================================================================
   LOCAL FUNCTION PROTOTYPES
   ============================================================================*/
 static int mq_start(void);
+static int mq_wait(void);
+static int mq_mirror(void);
+static int mq_batch(void);
+static int mq_spsc(void);
+static int mq_framed(void);
 static int mq_init_loop(void);
 static int mq_io(void);
 static int mq_overflow(void);
@@ -39,12 +64,20 @@ static int mq_stop(void);
 /* Define vot_p for TEST_ASSERT_EQ. */
 static test_stat_t *vote_p;
 
+/* State of the message queue tests. */
+static mq_stat_t mq_stat;
+
 /* List of the of the message queue test cases. */
 static test_elem_t mq_system[] = {
 	{ TEST_ADD(mq_start), 0 },
 	{ TEST_ADD(mq_init_loop), 0 },	
 	{ TEST_ADD(mq_io), 0 },	
 	{ TEST_ADD(mq_overflow), 0 },	
+	{ TEST_ADD(mq_framed), 0 },
+	{ TEST_ADD(mq_spsc), 0 },
+	{ TEST_ADD(mq_batch), 0 },
+	{ TEST_ADD(mq_mirror), 0 },
+	{ TEST_ADD(mq_wait), 0 },
 	{ TEST_ADD(mq_stop), 0 },	
 	{ NULL, NULL, 0 }
 };
@@ -52,6 +85,391 @@ static test_elem_t mq_system[] = {
 /*============================================================================
   LOCAL FUNCTIONS
   ============================================================================*/
+/**
+ * mq_wait_exec() - write the numbered records in the test thread context and
+ * sleep, while the queue is full.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void mq_wait_exec(os_queue_elem_t *m)
+{
+	int i;
+
+	/* Wait for the space of each record. */
+	for (i = 0; i < MQ_WAIT_N; i++) {
+		os_mq_wait_writable(mq_stat.q, sizeof(i), -1);
+		OS_TRAP_IF(! os_mq_write(mq_stat.q, (char *) &i, sizeof(i)));
+	}
+
+	/* Resume the main process. */
+	os_sem_release(&mq_stat.suspend);
+}
+
+/**
+ * mq_wait() - test the blocking waits and the event descriptor of the queue.
+ *
+ * Return:	the test status.
+ **/
+static int mq_wait(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 10837, 10834, 0 };
+	os_queue_elem_t msg;
+	struct pollfd pfd;
+	uint64_t val;
+	char buf[16], *p;
+	void *thr, *q;
+	int i, n, err, stat;
+
+	/* Create a pollable queue. */
+	mq_stat.q = os_mq_init_ext(16, OS_MQ_FRAMED | OS_MQ_SPSC | OS_MQ_EVENT);
+	pfd.fd     = os_mq_fd(mq_stat.q);
+	pfd.events = POLLIN;
+
+	/* Test the timeout of the empty queue. */
+	TEST_ASSERT_EQ(-1, os_mq_wait_readable(mq_stat.q, 10));
+	TEST_ASSERT_EQ(0, poll(&pfd, 1, 0));
+	TEST_ASSERT_EQ(0, os_mq_wait_writable(mq_stat.q, 4, 0));
+
+	/* The event descriptor counts the new messages. */
+	for (i = 0; i < 2; i++)
+		TEST_ASSERT_EQ(1, os_mq_write(mq_stat.q, (char *) &i, sizeof(i)));
+	TEST_ASSERT_EQ(0, os_mq_wait_readable(mq_stat.q, 0));
+	TEST_ASSERT_EQ(-1, os_mq_wait_writable(mq_stat.q, 4, 10));
+	TEST_ASSERT_EQ(1, poll(&pfd, 1, 0));
+	TEST_ASSERT_EQ(8, (int) read(pfd.fd, &val, sizeof(val)));
+	TEST_ASSERT_EQ(2, (int) val);
+	for (i = 0; i < 2; i++)
+		TEST_ASSERT_EQ(4, os_mq_read(mq_stat.q, buf, sizeof(buf)));
+
+	/* The producer of the SPSC queue changes to the test thread. */
+	os_mq_delete(mq_stat.q);
+	mq_stat.q = os_mq_init_ext(16, OS_MQ_FRAMED | OS_MQ_SPSC | OS_MQ_EVENT);
+
+	/* Start the blocking producer in the test thread. */
+	os_sem_init(&mq_stat.suspend, 0);
+	thr = os_thread_create("test", OS_THREAD_PRIO_FOREG, 16);
+	os_memset(&msg, 0, sizeof(msg));
+	msg.cb = mq_wait_exec;
+	OS_SEND(thr, &msg, sizeof(msg));
+
+	/* Sleep for each record and compare the record number. */
+	for (i = err = 0; i < MQ_WAIT_N; i++) {
+		os_mq_wait_readable(mq_stat.q, -1);
+		n = os_mq_read(mq_stat.q, buf, sizeof(buf));
+		err += n != sizeof(i) || os_memcmp(buf, &i, sizeof(i)) != 0;
+	}
+	TEST_ASSERT_EQ(0, err);
+
+	/* Wait for the end of the producer. */
+	os_sem_wait(&mq_stat.suspend);
+	os_thread_destroy(thr);
+
+	/* Release the resources. */
+	os_sem_delete(&mq_stat.suspend);
+	os_mq_delete(mq_stat.q);
+
+	/* The largest record fills the empty locked queue. */
+	q = os_mq_init_ext(64, OS_MQ_FRAMED);
+	TEST_ASSERT_EQ(0, os_mq_wait_writable(q, 60, 0));
+
+	/* A reserved queue buffer is not writable for another producer. */
+	p = os_mq_alloc(q, 8);
+	TEST_ASSERT_EQ(1, p != NULL);
+	TEST_ASSERT_EQ(-1, os_mq_wait_writable(q, 4, 10));
+	os_memset(p, 0, 8);
+	os_mq_add(q, 8);
+	TEST_ASSERT_EQ(0, os_mq_wait_writable(q, 4, 0));
+	TEST_ASSERT_EQ(8, os_mq_read(q, buf, sizeof(buf)));
+	os_mq_delete(q);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+
+	return stat;
+}
+
+/**
+ * mq_mirror() - test the contiguous records across the end of the double
+ * mapped queue buffer.
+ *
+ * Return:	the test status.
+ **/
+static int mq_mirror(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 10830, 10827, 0 };
+	char buf[1000], *p;
+	void *q;
+	int i, n, size, err, stat;
+
+	/* The queue buffer is rounded up to the page size. */
+	q = os_mq_init_ext(100, OS_MQ_FRAMED | OS_MQ_MIRROR);
+	size = sysconf(_SC_PAGESIZE);
+	TEST_ASSERT_EQ(size - 4, os_mq_wmem(q));
+
+	/* Fill the queue with numbered records and test the overflow. */
+	for (i = 0; i < size / 1004; i++) {
+		os_memset(buf, i, sizeof(buf));
+		TEST_ASSERT_EQ(1, os_mq_write(q, buf, sizeof(buf)));
+	}
+	TEST_ASSERT_EQ(0, os_mq_write(q, buf, sizeof(buf)));
+
+	/* Release the first record, the next one wraps around. */
+	TEST_ASSERT_EQ(1000, os_mq_read(q, buf, sizeof(buf)));
+	os_memset(buf, i, sizeof(buf));
+	TEST_ASSERT_EQ(1, os_mq_write(q, buf, sizeof(buf)));
+
+	/* Read the records in place, the last one crosses the end. */
+	for (n = 1, err = 0; n <= i; n++) {
+		p = os_mq_get(q, &size);
+		TEST_ASSERT_EQ(1000, size);
+		os_memset(buf, n, sizeof(buf));
+		err += os_memcmp(p, buf, sizeof(buf)) != 0;
+		os_mq_remove(q, size);
+	}
+	TEST_ASSERT_EQ(0, err);
+	TEST_ASSERT_EQ(0, os_mq_rmem(q));
+
+	/* Release the mappings. */
+	os_mq_delete(q);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+
+	return stat;
+}
+
+/**
+ * mq_batch() - test the batched write and read operations in all queue modes.
+ *
+ * Return:	the test status.
+ **/
+static int mq_batch(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 10829, 10826, 0 };
+	int mode[] = { 0, OS_MQ_FRAMED, OS_MQ_FRAMED | OS_MQ_SPSC };
+	char msg[3][3];
+	os_mq_iov_t iov[8];
+	void *q;
+	int i, m, n, stat;
+
+	/* Loop thru the queue modes. */
+	for (m = 0; m < 3; m++) {
+		/* Create a queue with space for two messages. */
+		q = os_mq_init_ext(mode[m] ? 20 : 7, mode[m]);
+
+		/* Define the messages with EOS. */
+		for (i = 0; i < 3; i++) {
+			os_memcpy(msg[i], 3, "a\0", 3);
+			msg[i][0] += i;
+			iov[i].buf  = msg[i];
+			iov[i].size = 3;
+		}
+
+		/* The third message does not fit. */
+		TEST_ASSERT_EQ(2, os_mq_write_batch(q, iov, 3));
+
+		/* Get both messages without copy. */
+		n = os_mq_read_batch(q, iov, 8);
+		TEST_ASSERT_EQ(2, n);
+		for (i = 0; i < n; i++) {
+			TEST_ASSERT_EQ(3, iov[i].size);
+			TEST_ASSERT_EQ('a' + i, iov[i].buf[0]);
+			TEST_ASSERT_EQ('\0', iov[i].buf[2]);
+		}
+
+		/* Release the burst. */
+		os_mq_remove_batch(q, iov, n);
+		TEST_ASSERT_EQ(0, os_mq_rmem(q));
+		TEST_ASSERT_EQ(0, os_mq_read_batch(q, iov, 8));
+		os_mq_delete(q);
+	}
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+
+	return stat;
+}
+
+/**
+ * mq_produce_exec() - write the numbered records in the test thread context.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void mq_produce_exec(os_queue_elem_t *m)
+{
+	int i;
+
+	/* Retry the write operation, while the consumer is behind. */
+	for (i = 0; i < MQ_SPSC_N; i++) {
+		while (! os_mq_write(mq_stat.q, (char *) &i, sizeof(i)))
+			sched_yield();
+	}
+
+	/* Resume the main process. */
+	os_sem_release(&mq_stat.suspend);
+}
+
+/**
+ * mq_spsc() - test the lock-free queue with one producer and one consumer
+ * thread.
+ *
+ * Return:	the test status.
+ **/
+static int mq_spsc(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 10823, 10820, 0 };
+	os_queue_elem_t msg;
+	char rec[] = { 'a', '#', '\0', 'b' };
+	char buf[16], big[1200], out[1200], *p;
+	void *thr;
+	int i, n, err, stat;
+
+	/* Create a SPSC queue with space for 4 small records. */
+	mq_stat.q = os_mq_init_ext(36, OS_MQ_FRAMED | OS_MQ_SPSC);
+	TEST_ASSERT_EQ(32, os_mq_wmem(mq_stat.q));
+
+	/* Fill the queue and test the overflow. */
+	for (i = 0; i < 4; i++)
+		TEST_ASSERT_EQ(1, os_mq_write(mq_stat.q, rec, sizeof(rec)));
+	TEST_ASSERT_EQ(0, os_mq_write(mq_stat.q, rec, sizeof(rec)));
+	TEST_ASSERT_EQ(32, os_mq_rmem(mq_stat.q));
+
+	/* Release the first two records and wrap around. */
+	for (i = 0; i < 2; i++)
+		TEST_ASSERT_EQ(4, os_mq_read(mq_stat.q, buf, sizeof(buf)));
+	TEST_ASSERT_EQ(8, os_mq_wmem(mq_stat.q));
+	TEST_ASSERT_EQ(1, os_mq_write(mq_stat.q, rec, sizeof(rec)));
+	TEST_ASSERT_EQ(24, os_mq_rmem(mq_stat.q));
+
+	/* Read the records up to the wrapped head. */
+	for (i = 0; i < 3; i++) {
+		p = os_mq_get(mq_stat.q, &n);
+		TEST_ASSERT_EQ(4, n);
+		TEST_ASSERT_EQ(0, os_memcmp(p, rec, sizeof(rec)));
+		os_mq_remove(mq_stat.q, n);
+	}
+	TEST_ASSERT_EQ(0, os_mq_read(mq_stat.q, buf, sizeof(buf)));
+	os_mq_delete(mq_stat.q);
+
+	/* Pass records larger than half of the queue, the indices of the empty
+	 * queue are in the middle of the buffer after each round. */
+	mq_stat.q = os_mq_init_ext(2048, OS_MQ_FRAMED | OS_MQ_SPSC);
+	for (i = err = 0; i < 4; i++) {
+		os_memset(big, i, sizeof(big));
+		TEST_ASSERT_EQ(2044, os_mq_wmem(mq_stat.q));
+		TEST_ASSERT_EQ(1, os_mq_write(mq_stat.q, big, sizeof(big)));
+		TEST_ASSERT_EQ(1204, os_mq_rmem(mq_stat.q));
+		n = os_mq_read(mq_stat.q, out, sizeof(out));
+		err += n != sizeof(big) || os_memcmp(out, big, sizeof(big)) != 0;
+		TEST_ASSERT_EQ(0, os_mq_rmem(mq_stat.q));
+	}
+	TEST_ASSERT_EQ(0, err);
+	os_mq_delete(mq_stat.q);
+
+	/* Create the queue of the producer thread. */
+	mq_stat.q = os_mq_init_ext(64, OS_MQ_FRAMED | OS_MQ_SPSC);
+	os_sem_init(&mq_stat.suspend, 0);
+
+	/* Start the producer in the test thread. */
+	thr = os_thread_create("test", OS_THREAD_PRIO_FOREG, 16);
+	os_memset(&msg, 0, sizeof(msg));
+	msg.cb = mq_produce_exec;
+	OS_SEND(thr, &msg, sizeof(msg));
+
+	/* Consume the records in the order of the write operations. */
+	for (i = err = 0; i < MQ_SPSC_N; ) {
+		n = os_mq_read(mq_stat.q, buf, sizeof(buf));
+		if (n < 1) {
+			sched_yield();
+			continue;
+		}
+
+		/* Compare the record number. */
+		err += n != sizeof(i) || os_memcmp(buf, &i, sizeof(i)) != 0;
+		i++;
+	}
+	TEST_ASSERT_EQ(0, err);
+
+	/* Wait for the end of the producer. */
+	os_sem_wait(&mq_stat.suspend);
+	os_thread_destroy(thr);
+
+	/* Release the resources. */
+	os_sem_delete(&mq_stat.suspend);
+	os_mq_delete(mq_stat.q);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+
+	return stat;
+}
+
+/**
+ * mq_framed() - test the binary records of the framed message queue.
+ *
+ * Return:	the test status.
+ **/
+static int mq_framed(void)
+{
+	os_statistics_t expected = { 8, 5, 0, 10816, 10813, 0 };
+	char rec[] = { 'a', '#', '\0', 'b' };
+	char buf[16], *p;
+	void *q;
+	int i, n, stat;
+
+	/* Create a framed queue with space for 4 small records. */
+	q = os_mq_init_ext(36, OS_MQ_FRAMED);
+	TEST_ASSERT_EQ(32, os_mq_wmem(q));
+
+	/* The delimiter and EOS are part of the binary payload. */
+	TEST_ASSERT_EQ(1, os_mq_write(q, rec, sizeof(rec)));
+	TEST_ASSERT_EQ(8, os_mq_rmem(q));
+	p = os_mq_get(q, &n);
+	TEST_ASSERT_EQ(4, n);
+	TEST_ASSERT_EQ(0, os_memcmp(p, rec, sizeof(rec)));
+	os_mq_remove(q, n);
+	TEST_ASSERT_EQ(0, os_mq_rmem(q));
+
+	/* Fill the queue and test the overflow. */
+	for (i = 0; i < 4; i++)
+		TEST_ASSERT_EQ(1, os_mq_write(q, rec, sizeof(rec)));
+	TEST_ASSERT_EQ(0, os_mq_write(q, rec, sizeof(rec)));
+	TEST_ASSERT_EQ(0, os_mq_wmem(q));
+
+	/* Release the first two records. */
+	for (i = 0; i < 2; i++)
+		TEST_ASSERT_EQ(4, os_mq_read(q, buf, sizeof(buf)));
+	TEST_ASSERT_EQ(12, os_mq_wmem(q));
+
+	/* Wrap around and complete a record shorter than the reservation. */
+	p = os_mq_alloc(q, 12);
+	TEST_ASSERT_EQ(1, p != NULL);
+	os_memcpy(p, 12, "xyz#\0", 5);
+	os_mq_add(q, 5);
+	TEST_ASSERT_EQ(28, os_mq_rmem(q));
+
+	/* Read the records in the order of the write operations. */
+	for (i = 0; i < 2; i++) {
+		TEST_ASSERT_EQ(4, os_mq_read(q, buf, sizeof(buf)));
+		TEST_ASSERT_EQ(0, os_memcmp(buf, rec, sizeof(rec)));
+	}
+	TEST_ASSERT_EQ(5, os_mq_read(q, buf, sizeof(buf)));
+	TEST_ASSERT_EQ(0, os_memcmp(buf, "xyz#\0", 5));
+	TEST_ASSERT_EQ(0, os_mq_read(q, buf, sizeof(buf)));
+
+	/* Release the queue. */
+	os_mq_delete(q);
+
+	/* Verify the OS state. */
+	stat = test_os_stat(&expected);
+
+	return stat;
+}
+
 /**
  * mq_overflow() - test the overflow of the message queue.
  *
@@ -59,7 +477,7 @@ static test_elem_t mq_system[] = {
  **/
 static int mq_overflow(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2382, 2382, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10814, 10811, 0 };
 	int stat;
 	
 	/* XXX */
@@ -77,7 +495,7 @@ static int mq_overflow(void)
  **/
 static int mq_io(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2382, 2382, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10814, 10811, 0 };
 	int stat;
 	
 	/* XXX */
@@ -96,7 +514,7 @@ static int mq_io(void)
  **/
 static int mq_init_loop(void)
 {	
-	os_statistics_t expected = { 6, 4, 0, 2382, 2382, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10814, 10811, 0 };
 	void  *q;
 	long limit, size;
 	int i, stat;
@@ -135,7 +553,7 @@ static int mq_init_loop(void)
  **/
 static int mq_stop(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2382, 2382, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10837, 10834, 0 };
 	int stat;
 
 	/* Verify the OS state. */
@@ -151,7 +569,7 @@ static int mq_stop(void)
  **/
 static int mq_start(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2360, 2360, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10792, 10789, 0 };
 	int stat;
 
 	/* Verify the OS state. */
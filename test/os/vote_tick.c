@@ -199,7 +199,7 @@ static void tic_ctrl_exec(os_queue_elem_t *msg)
  **/
 static int tic_display(void)
 {
-	os_statistics_t expected = { 10, 11, 2, 2360, 2358, 2 };
+	os_statistics_t expected = { 12, 16, 0, 10792, 10786, 2 };
 	Tcl_Interp  *interp;
 	const char *result;
 	int rv, code, stat;
@@ -241,7 +241,7 @@ static int tic_display(void)
  **/
 static int tic_controller(void)
 {
-	os_statistics_t expected = { 10, 11, 2, 2353, 2350, 2 };
+	os_statistics_t expected = { 12, 16, 0, 10785, 10779, 2 };
 	os_queue_elem_t msg;
 	int stat;
 
@@ -263,7 +263,7 @@ static int tic_controller(void)
  **/
 static int tic_stop(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2360, 2360, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10792, 10789, 0 };
 	int stat;
 
 	/* Remove the controller device. */
@@ -288,7 +288,7 @@ static int tic_stop(void)
  **/
 static int tic_start(void)
 {
-	os_statistics_t expected = { 10, 11, 2, 2352, 2350, 2 };
+	os_statistics_t expected = { 12, 16, 0, 10785, 10779, 2 };
 	int stat;
 
 	/* Create the control semaphore for the main process. */
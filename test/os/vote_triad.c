@@ -674,7 +674,7 @@ static void tri_disp_cleanup(tri_ep_t *ep)
  **/
 static int tri_stop(void)
 {
-	os_statistics_t expected = { 6, 4, 0, 2346, 2346, 0 };
+	os_statistics_t expected = { 8, 5, 0, 10778, 10775, 0 };
 	struct tri_data_s *c;
 	int stat;
 	
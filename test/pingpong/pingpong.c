@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * pingpong - wakeup latency of the os_thread message queues.
+ *
+ * The idle os_threads park on the futex word of their input queue without
+ * polling; the benchmark measures the average round trip of a message between
+ * two parked threads.
+ *
+ * Copyright (C) 2022 Gerald Schueller <gerald.schueller@web.de>
+ */
+
+/*============================================================================
+  IMPORTED INCLUDE REFERENCES
+  ============================================================================*/
+#include "os.h"    /* Operating system: os_sem_create(). */
+#include <time.h>  /* Monotonic clock: clock_gettime(). */
+
+/*============================================================================
+  EXPORTED INCLUDE REFERENCES
+  ============================================================================*/
+/*============================================================================
+  LOCAL NAME CONSTANTS DEFINITIONS
+  ============================================================================*/
+/*============================================================================
+  MACROS
+  ============================================================================*/
+/*============================================================================
+  LOCAL TYPE DEFINITIONS
+  ============================================================================*/
+/**
+ * pp_msg_t - ping-pong message.
+ *
+ * @OS_QUEUE_MSG_HEAD:  generic message header.
+ * @cycle:              number of the completed round trips.
+ **/
+typedef struct {
+	OS_QUEUE_MSG_HEAD;
+	int  cycle;
+} pp_msg_t;
+
+/*============================================================================
+  LOCAL DATA
+  ============================================================================*/
+/**
+ * pp - ping-pong configuration and state.
+ *
+ * @cycles:   number of the round trips.
+ * @ping:     first thread of the round trip.
+ * @pong:     second thread of the round trip.
+ * @suspend:  control semaphore for the main process.
+**/
+static struct {
+	int    cycles;
+	void  *ping;
+	void  *pong;
+	sem_t  suspend;
+} pp;
+
+/*============================================================================
+  LOCAL FUNCTION PROTOTYPES
+  ============================================================================*/
+static void pp_usage(void);
+static void pp_pong_exec(os_queue_elem_t *m);
+
+/*============================================================================
+  LOCAL FUNCTIONS
+  ============================================================================*/
+/**
+ * pp_atoi() - convert a string to integer.
+ *
+ * @string:   pointer to the gotten string.
+ *
+ * Return:	integer.
+ **/
+static int pp_atoi(char *string)
+{
+	int i;
+
+	/* Entry condition. */
+	if (string == NULL) {
+		pp_usage();
+		exit(1);
+	}
+
+	/* Convert the string to integer in the decimal system. */
+	i = strtol(string, NULL, 10);
+
+	/* Test the integer. */
+	if (i < 0) {
+		pp_usage();
+		exit(1);
+	}
+
+	return i;
+}
+
+/**
+ * pp_usage() - provide information about the ping-pong usage.
+ *
+ * Return:	None.
+ **/
+static void pp_usage(void)
+{
+	printf("pingpong - wakeup latency of the os_thread message queues\n");
+	printf("  -h    show this usage\n");
+	printf("  -n c  number of the round trips\n");
+	printf("\nDefault settings:\n");
+	printf("  cycles:      %d\n", pp.cycles);
+}
+
+/**
+ * pp_ping_exec() - forward the message to the pong thread.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void pp_ping_exec(os_queue_elem_t *m)
+{
+	pp_msg_t *msg;
+
+	/* Decode the ping-pong message. */
+	msg = (pp_msg_t *) m;
+
+	/* Send the message to the pong thread. */
+	msg->cb = pp_pong_exec;
+	OS_SEND(pp.pong, msg, sizeof(*msg));
+}
+
+/**
+ * pp_pong_exec() - complete the round trip and start the next one.
+ *
+ * @m:  pointer to the received message.
+ *
+ * Return:	None.
+ **/
+static void pp_pong_exec(os_queue_elem_t *m)
+{
+	pp_msg_t *msg;
+
+	/* Decode the ping-pong message. */
+	msg = (pp_msg_t *) m;
+
+	/* Test the number of the round trips. */
+	msg->cycle++;
+	if (msg->cycle >= pp.cycles) {
+		/* Resume the main process. */
+		os_sem_release(&pp.suspend);
+		return;
+	}
+
+	/* Send the message to the ping thread. */
+	msg->cb = pp_ping_exec;
+	OS_SEND(pp.ping, msg, sizeof(*msg));
+}
+
+/**
+ * pp_run() - measure the round trips between two os_threads.
+ *
+ * Return:	None.
+ **/
+static void pp_run(void)
+{
+	struct timespec start, end;
+	os_thread_attr_t attr;
+	pp_msg_t msg;
+	double ns;
+
+	/* Define the scheduling attributes of the threads. */
+	os_memset(&attr, 0, sizeof(attr));
+	attr.policy = OS_THREAD_POLICY_INHERIT;
+
+	/* Create the threads of the round trip. */
+	pp.ping = os_thread_create_ext("ping", &attr, 8);
+	pp.pong = os_thread_create_ext("pong", &attr, 8);
+
+	/* Define the ping-pong message. */
+	os_memset(&msg, 0, sizeof(msg));
+	msg.cb = pp_ping_exec;
+
+	/* Start the round trips. */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	OS_SEND(pp.ping, &msg, sizeof(msg));
+
+	/* Wait for the last round trip. */
+	os_sem_wait(&pp.suspend);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* Release the threads. */
+	os_thread_destroy(pp.ping);
+	os_thread_destroy(pp.pong);
+
+	/* Print the average latency of a round trip. */
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%8.0f ns per round trip\n", ns / pp.cycles);
+}
+
+/*============================================================================
+  EXPORTED FUNCTIONS
+  ============================================================================*/
+/**
+ * main() - start function of the ping-pong benchmark.
+ *
+ * @argc:  argument counter.
+ * @argv:  list of the arguments.
+ *
+ * Return:	0 or force a software trap.
+ **/
+int main(int argc, char *argv[])
+{
+	int opt;
+
+	/* Initialize test test valuses. */
+	pp.cycles = 100000;
+
+	/* Analyze the ping-pong arguments. */
+	while ((opt = getopt(argc, argv, "hn:")) != -1) {
+		/* Analyze the current argument. */
+		switch(opt) {
+		case 'h':
+			pp_usage();
+			exit(0);
+			break;
+		case 'n':
+			pp.cycles = pp_atoi(optarg);
+			break;
+		default:
+			pp_usage();
+			exit(1);
+			break;
+		}
+	}
+
+	/* Initialize the operating system. */
+	os_init(1);
+
+	/* Switch off the thread traces. */
+	os_trace_button(0);
+
+	/* Create the control semaphore for the main process. */
+	os_sem_init(&pp.suspend, 0);
+
+	/* Measure the round trips between the parked threads. */
+	pp_run();
+
+	/* Release the control semaphore for the main process. */
+	os_sem_delete(&pp.suspend);
+
+	/* Release the OS resources. */
+	os_exit();
+
+	return (0);
+}
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# SPDX-License-Identifier: GPL-2.0
+
+# release_bench - compare the debug and the release build (RELEASE=YES) of the
+# van OS with the vote and site workloads.
+#
+# Copyright (C) 2022 Gerald Schueller <gerald.schueller@web.de>
+
+# Define the root of the VAN platform.
+GLOBALPATH=$(cd "$(dirname "$0")/../.." && pwd)
+
+# Print the elapsed time in seconds.
+TIMEFORMAT=%R
+
+# bench_vote - build and time the vote test system.
+#
+# $1:  build mode: debug or release.
+#
+# Return:        None.
+bench_vote () {
+    cd ${GLOBALPATH}/test/os
+
+    # Build the test system in the requested mode.
+    make clean > /dev/null
+    if [ $1 == release ]; then
+	make RELEASE=YES > /dev/null
+    else
+	make > /dev/null
+    fi
+
+    # Execute the test system.
+    echo -n "vote $1: "
+    time (./vote > /dev/null 2>&1)
+}
+
+# bench_site - build and time the site research programme.
+#
+# $1:  build mode: debug or release.
+# $2:  number of the C->N and N->C cycles.
+#
+# Return:        None.
+bench_site () {
+    cd ${GLOBALPATH}/test/shared_memory/site
+
+    # Build the research programme in the requested mode.
+    if [ $1 == release ]; then
+	make RELEASE=YES > /dev/null 2>&1
+    else
+	make > /dev/null 2>&1
+    fi
+
+    # Transfer the buffers with the upper limit.
+    echo -n "site $1: "
+    time (out/site -c p -d $2 -l 2048 -f x -u $2 -s 2048 -r y > /dev/null)
+}
+
+# main - start function of the build comparison.
+#
+# $1:  number of the site cycles.
+#
+# Return:        None.
+main () {
+    cycles=${1:-100000}
+
+    bench_vote debug
+    bench_vote release
+    bench_site debug $cycles
+    bench_site release $cycles
+
+    # Restore the debug builds.
+    bench_vote debug > /dev/null 2>&1
+    bench_site debug 1 > /dev/null 2>&1
+}
+
+main $1